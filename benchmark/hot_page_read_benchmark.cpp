@@ -0,0 +1,101 @@
+/**
+ * @file hot_page_read_benchmark.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief read scalability of a single hot page
+ * @version 0.1
+ * @date 2023-02-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <random>
+#include <thread>
+#include <vector>
+#include <gflags/gflags.h>
+
+#include "btree/page/versioned_bwtree_page.h"
+#include "property/schema.h"
+#include "util/time.h"
+
+DEFINE_int64(max_concurrency, 64, "threads are doubled from 1 up to this");
+DEFINE_int64(row_cnt, 1000, "");
+DEFINE_int64(read_per_thread, 1000000, "");
+DEFINE_bool(force_compaction, true, "");
+
+using namespace arcanedb;
+
+inline int64_t GetRandom(int64_t min, int64_t max) noexcept {
+  static thread_local std::random_device rd;
+  static thread_local std::mt19937 generator(rd());
+  std::uniform_int_distribution<int64_t> distribution(min, max);
+  return distribution(generator);
+}
+
+property::Schema MakeSchema() noexcept {
+  property::Column column1{
+      .column_id = 0, .name = "point_id", .type = property::ValueType::Int64};
+  property::Column column2{
+      .column_id = 1, .name = "value", .type = property::ValueType::String};
+  property::RawSchema schema{
+      .columns = {column1, column2}, .schema_id = 0, .sort_key_count = 1};
+  return property::Schema(schema);
+}
+
+void Prepare(btree::VersionedBwTreePage *page,
+             const property::Schema *schema) noexcept {
+  Options opts;
+  opts.schema = schema;
+  opts.force_compaction = FLAGS_force_compaction;
+  btree::WriteInfo info;
+  for (int64_t i = 0; i < FLAGS_row_cnt; i++) {
+    property::ValueRefVec vec;
+    vec.push_back(i);
+    vec.push_back("arcane");
+    util::BufWriter writer;
+    CHECK(property::Row::Serialize(vec, &writer, schema).ok());
+    auto str = writer.Detach();
+    CHECK(page->SetRow(property::Row(str.data()), 1, opts, &info).ok());
+  }
+}
+
+void Work(const btree::VersionedBwTreePage *page,
+          const property::Schema *schema) noexcept {
+  Options opts;
+  opts.schema = schema;
+  opts.ignore_lock = true;
+  for (int64_t i = 0; i < FLAGS_read_per_thread; i++) {
+    auto sk = property::SortKeys(
+        property::Value(GetRandom(0, FLAGS_row_cnt - 1)));
+    btree::RowView view;
+    auto s = page->GetRow(sk.as_ref(), 1, opts, &view);
+    CHECK(s.ok());
+  }
+}
+
+int main(int argc, char *argv[]) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  auto schema = MakeSchema();
+  btree::VersionedBwTreePage page("hot_page");
+  Prepare(&page, &schema);
+  for (int64_t concurrency = 1; concurrency <= FLAGS_max_concurrency;
+       concurrency *= 2) {
+    std::vector<std::thread> threads;
+    util::Timer timer;
+    for (int64_t i = 0; i < concurrency; i++) {
+      threads.emplace_back([&]() { Work(&page, &schema); });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    auto elapsed_us = timer.GetElapsed();
+    ARCANEDB_INFO("concurrency {}, elapsed {}us, qps {}", concurrency,
+                  elapsed_us,
+                  concurrency * FLAGS_read_per_thread * util::Second /
+                      std::max<int64_t>(elapsed_us, 1));
+  }
+  return 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file snapshot_ts_benchmark.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief read-only txn begin rate against concurrent read-write txns
+ * @version 0.1
+ * @date 2023-02-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <thread>
+#include <vector>
+#include <gflags/gflags.h>
+
+#include "common/config.h"
+#include "txn/snapshot_manager.h"
+#include "txn/tso.h"
+#include "util/time.h"
+
+DEFINE_int64(ro_concurrency, 4, "threads acquiring snapshot ts");
+DEFINE_int64(max_rw_concurrency, 64,
+             "committing threads are doubled from 0 up to this");
+DEFINE_int64(duration_ms, 1000, "");
+DEFINE_string(manager, "sharded", "sharded or linkbuf");
+
+using namespace arcanedb;
+
+template <typename Manager, typename Commit>
+void Run(Manager *manager, Commit commit, int64_t rw_concurrency) noexcept {
+  std::atomic<bool> stop{false};
+  std::atomic<int64_t> ro_cnt{0};
+  std::atomic<int64_t> rw_cnt{0};
+  std::vector<std::thread> threads;
+  for (int64_t i = 0; i < rw_concurrency; i++) {
+    threads.emplace_back([&]() {
+      int64_t cnt = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        commit();
+        cnt++;
+      }
+      rw_cnt.fetch_add(cnt);
+    });
+  }
+  for (int64_t i = 0; i < FLAGS_ro_concurrency; i++) {
+    threads.emplace_back([&]() {
+      int64_t cnt = 0;
+      TxnTs last_ts = 0;
+      while (!stop.load(std::memory_order_relaxed)) {
+        auto ts = manager->GetSnapshotTs();
+        CHECK(ts >= last_ts);
+        last_ts = ts;
+        cnt++;
+      }
+      ro_cnt.fetch_add(cnt);
+    });
+  }
+  util::Timer timer;
+  std::this_thread::sleep_for(std::chrono::milliseconds(FLAGS_duration_ms));
+  stop.store(true);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto elapsed_us = std::max<int64_t>(timer.GetElapsed(), 1);
+  ARCANEDB_INFO("rw concurrency {}, ro begin qps {}, rw commit qps {}",
+                rw_concurrency, ro_cnt.load() * util::Second / elapsed_us,
+                rw_cnt.load() * util::Second / elapsed_us);
+}
+
+int main(int argc, char *argv[]) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  for (int64_t rw_concurrency = 0; rw_concurrency <= FLAGS_max_rw_concurrency;
+       rw_concurrency = std::max<int64_t>(rw_concurrency * 2, 1)) {
+    txn::Tso tso;
+    if (FLAGS_manager == "sharded") {
+      txn::ShardedSnapshotManager manager(
+          common::Config::kSnapshotManagerShardNum);
+      Run(
+          &manager,
+          [&]() {
+            auto ts = tso.RequestTs();
+            manager.RegisterTs(ts);
+            manager.CommitTs(ts);
+          },
+          rw_concurrency);
+    } else {
+      txn::LinkBufSnapshotManager manager;
+      Run(
+          &manager, [&]() { manager.CommitTs(tso.RequestTs()); },
+          rw_concurrency);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file txn_commit_benchmark.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief commit throughput of short read-write txns
+ * @version 0.1
+ * @date 2023-02-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <thread>
+#include <vector>
+#include <gflags/gflags.h>
+
+#include "cache/buffer_pool.h"
+#include "property/schema.h"
+#include "txn/txn_manager_occ.h"
+#include "util/time.h"
+
+DEFINE_int64(max_concurrency, 64, "threads are doubled from 1 up to this");
+DEFINE_int64(txn_per_thread, 100000, "");
+DEFINE_int64(table_num, 64, "");
+
+using namespace arcanedb;
+
+property::Schema MakeSchema() noexcept {
+  property::Column column1{
+      .column_id = 0, .name = "point_id", .type = property::ValueType::Int64};
+  property::Column column2{
+      .column_id = 1, .name = "value", .type = property::ValueType::String};
+  property::RawSchema schema{
+      .columns = {column1, column2}, .schema_id = 0, .sort_key_count = 1};
+  return property::Schema(schema);
+}
+
+void Work(txn::TxnManagerOCC *txn_manager, const Options &opts,
+          int64_t thread_id, std::atomic<int64_t> *abort_cnt) noexcept {
+  for (int64_t i = 0; i < FLAGS_txn_per_thread; i++) {
+    // threads write disjoint rows, so that commits won't conflict.
+    auto table_key = std::to_string(i % FLAGS_table_num);
+    property::ValueRefVec vec;
+    vec.push_back(thread_id);
+    vec.push_back("arcane");
+    util::BufWriter writer;
+    CHECK(property::Row::Serialize(vec, &writer, opts.schema).ok());
+    auto str = writer.Detach();
+    auto context = txn_manager->BeginRwTxn(opts);
+    CHECK(context->SetRow(table_key, property::Row(str.data()), opts).ok());
+    if (!context->CommitOrAbort(opts).IsCommit()) {
+      abort_cnt->fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  auto schema = MakeSchema();
+  for (int64_t concurrency = 1; concurrency <= FLAGS_max_concurrency;
+       concurrency *= 2) {
+    cache::BufferPool buffer_pool(nullptr);
+    txn::TxnManagerOCC txn_manager(txn::LockManagerType::kInlined);
+    Options opts;
+    opts.schema = &schema;
+    opts.buffer_pool = &buffer_pool;
+    std::atomic<int64_t> abort_cnt{0};
+    std::vector<std::thread> threads;
+    util::Timer timer;
+    for (int64_t i = 0; i < concurrency; i++) {
+      threads.emplace_back(
+          [&, i]() { Work(&txn_manager, opts, i, &abort_cnt); });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    auto elapsed_us = std::max<int64_t>(timer.GetElapsed(), 1);
+    ARCANEDB_INFO("concurrency {}, elapsed {}us, commit qps {}, aborted {}",
+                  concurrency, elapsed_us,
+                  concurrency * FLAGS_txn_per_thread * util::Second /
+                      elapsed_us,
+                  abort_cnt.load());
+  }
+  return 0;
+}
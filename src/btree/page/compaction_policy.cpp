@@ -0,0 +1,23 @@
+/**
+ * @file compaction_policy.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "btree/page/compaction_policy.h"
+
+namespace arcanedb {
+namespace btree {
+
+const CompactionPolicy *CompactionPolicy::GetDefault() noexcept {
+  static TieredCompactionPolicy policy;
+  return &policy;
+}
+
+} // namespace btree
+} // namespace arcanedb
@@ -0,0 +1,143 @@
+/**
+ * @file compaction_policy.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include "common/config.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace arcanedb {
+namespace btree {
+
+/**
+ * @brief
+ * Statistics of delta chain, used by compaction policy.
+ */
+struct DeltaChainStat {
+  // number of delta nodes in chain.
+  size_t chain_length;
+  // extra delta nodes traversed by readers since last compaction,
+  // i.e. read amplification caused by current chain.
+  uint64_t read_cost;
+};
+
+/**
+ * @brief
+ * Per page compaction counters.
+ */
+struct CompactionStat {
+  size_t chain_length;
+  uint64_t read_cost;
+  uint64_t compaction_cnt;
+  // bytes written by compaction, used to measure write amplification.
+  uint64_t compaction_bytes;
+};
+
+/**
+ * @brief
+ * Compaction policy decides when delta chain should be compacted,
+ * and how many deltas should be merged. Compaction merges deltas from
+ * head to tail, policy is consulted before merging each delta.
+ * Policy should be stateless, so that it could be shared among pages.
+ */
+class CompactionPolicy {
+public:
+  virtual ~CompactionPolicy() noexcept = default;
+
+  /**
+   * @brief
+   * Whether delta chain should be compacted.
+   * @param stat
+   */
+  virtual bool NeedCompaction(const DeltaChainStat &stat) const noexcept = 0;
+
+  /**
+   * @brief
+   * Whether next delta should be merged.
+   * @param stat
+   * @param merged_rows rows that have been merged.
+   * @param next_rows rows of next delta.
+   */
+  virtual bool ShouldMerge(const DeltaChainStat &stat, size_t merged_rows,
+                           size_t next_rows) const noexcept = 0;
+
+  /**
+   * @brief
+   * Policy used when Options::compaction_policy is not set.
+   * @return const CompactionPolicy*
+   */
+  static const CompactionPolicy *GetDefault() noexcept;
+};
+
+/**
+ * @brief
+ * Size tiered compaction. Compaction is triggered once chain is longer than
+ * max_chain_length, and next delta is merged while it's smaller than
+ * size_ratio times of merged rows, so that deltas of similar size are merged
+ * together and each row is rewritten O(log(n)) times.
+ * Larger size_ratio trades write amplification for read amplification.
+ */
+class TieredCompactionPolicy : public CompactionPolicy {
+public:
+  explicit TieredCompactionPolicy(
+      size_t max_chain_length = common::Config::kBwTreeDeltaChainLength,
+      size_t size_ratio = common::Config::kBwTreeCompactionFactor) noexcept
+      : max_chain_length_(max_chain_length), size_ratio_(size_ratio) {}
+
+  bool NeedCompaction(const DeltaChainStat &stat) const noexcept override {
+    return stat.chain_length > max_chain_length_;
+  }
+
+  bool ShouldMerge(const DeltaChainStat &stat, size_t merged_rows,
+                   size_t next_rows) const noexcept override {
+    return next_rows == 1 || merged_rows * size_ratio_ > next_rows;
+  }
+
+private:
+  const size_t max_chain_length_;
+  const size_t size_ratio_;
+};
+
+/**
+ * @brief
+ * Read heat aware compaction. Chains that are read often are consolidated
+ * into a single delta once read cost accumulated since last compaction
+ * exceeds read_cost_threshold, otherwise base policy is used.
+ */
+class ReadHeatCompactionPolicy : public CompactionPolicy {
+public:
+  ReadHeatCompactionPolicy(
+      const CompactionPolicy *base,
+      uint64_t read_cost_threshold =
+          common::Config::kBwTreeCompactionReadCostThreshold) noexcept
+      : base_(base), read_cost_threshold_(read_cost_threshold) {}
+
+  bool NeedCompaction(const DeltaChainStat &stat) const noexcept override {
+    return IsHot_(stat) || base_->NeedCompaction(stat);
+  }
+
+  bool ShouldMerge(const DeltaChainStat &stat, size_t merged_rows,
+                   size_t next_rows) const noexcept override {
+    return IsHot_(stat) || base_->ShouldMerge(stat, merged_rows, next_rows);
+  }
+
+private:
+  bool IsHot_(const DeltaChainStat &stat) const noexcept {
+    return stat.chain_length > 1 && stat.read_cost >= read_cost_threshold_;
+  }
+
+  const CompactionPolicy *base_;
+  const uint64_t read_cost_threshold_;
+};
+
+} // namespace btree
+} // namespace arcanedb
@@ -17,9 +17,8 @@
 namespace arcanedb {
 namespace btree {
 
-Status InternalRows::GetPageId(const Options &opts,
-                               property::SortKeysRef sort_key,
-                               InternalRowView *view) const noexcept {
+std::vector<InternalRow>::const_iterator
+InternalRows::Locate_(property::SortKeysRef sort_key) const noexcept {
   auto iter =
       std::upper_bound(rows_.begin(), rows_.end(), sort_key,
                        [](property::SortKeysRef sk, const InternalRow &row) {
@@ -28,14 +27,60 @@ Status InternalRows::GetPageId(const Options &opts,
   // check due to the fact that rows_.begin() is smallest sort key
   CHECK(iter != rows_.begin());
   iter--;
+  return iter;
+}
+
+Status InternalRows::GetPageId(const Options &opts,
+                               property::SortKeysRef sort_key,
+                               InternalRowView *view) const noexcept {
+  auto iter = Locate_(sort_key);
   view->PushBackRef(std::string_view(iter->page_id));
   return Status::Ok();
 }
 
+Status
+InternalRows::GetInternalRow(const Options &opts,
+                             property::SortKeysRef sort_key,
+                             std::optional<InternalRow> *row) const noexcept {
+  row->emplace(*Locate_(sort_key));
+  return Status::Ok();
+}
+
+Status
+InternalRows::GetSiblingRows(const Options &opts,
+                             property::SortKeysRef sort_key,
+                             std::optional<InternalRow> *left,
+                             std::optional<InternalRow> *right) const noexcept {
+  if (rows_.size() < 2) {
+    return Status::NotFound();
+  }
+  auto iter = Locate_(sort_key);
+  if (std::next(iter) == rows_.end()) {
+    iter--;
+  }
+  left->emplace(*iter);
+  right->emplace(*std::next(iter));
+  return Status::Ok();
+}
+
+Status InternalRows::Merge(const Options &opts,
+                           property::SortKeysRef sort_key) noexcept {
+  auto it =
+      std::lower_bound(rows_.begin(), rows_.end(), sort_key,
+                       [](const InternalRow &row, property::SortKeysRef sk) {
+                         return row.sort_key < sk;
+                       });
+  if (it == rows_.begin() || it == rows_.end() || it->sort_key != sort_key) {
+    return Status::NotFound();
+  }
+  rows_.erase(it);
+  return Status::Ok();
+}
+
 Status
 InternalRows::Split(const Options &opts, property::SortKeysRef old_sort_key,
                     std::vector<InternalRow> new_internal_rows) noexcept {
-  if (old_sort_key.empty()) {
+  if (rows_.empty()) {
     // overwrite
     CHECK(rows_.empty());
     rows_ = std::move(new_internal_rows);
@@ -61,6 +106,41 @@ InternalRows::Split(const Options &opts, property::SortKeysRef old_sort_key,
   return Status::Ok();
 }
 
+/**
+ * @brief
+ * Format:
+ * | row count 4byte | row1 | row2 | ... | rowN |
+ * Row format:
+ * | sort key varlen | page id varlen |
+ */
+void InternalRows::Serialize(util::BufWriter *writer) const noexcept {
+  writer->WriteBytes(static_cast<uint32_t>(rows_.size()));
+  for (const auto &row : rows_) {
+    detail::SerializeString(writer, row.sort_key.as_slice());
+    detail::SerializeString(writer, row.page_id);
+  }
+}
+
+Status InternalRows::Deserialize(util::BufReader *reader) noexcept {
+  uint32_t row_cnt;
+  if (!reader->ReadBytes(&row_cnt)) {
+    return Status::DeserializationFailed();
+  }
+  rows_.clear();
+  rows_.reserve(row_cnt);
+  for (uint32_t i = 0; i < row_cnt; i++) {
+    std::string_view sort_key;
+    std::string_view page_id;
+    if (!detail::DeserializeString(reader, &sort_key) ||
+        !detail::DeserializeString(reader, &page_id)) {
+      return Status::DeserializationFailed();
+    }
+    rows_.push_back(InternalRow{.sort_key = property::SortKeys(sort_key),
+                                .page_id = PageIdType(page_id)});
+  }
+  return Status::Ok();
+}
+
 bool InternalRows::TEST_SortKeyAscending() const noexcept {
   if (rows_.size() == 1) {
     return true;
@@ -98,6 +178,64 @@ InternalPage::Split(const Options &opts, property::SortKeysRef old_sort_key,
   return s;
 }
 
+Status
+InternalPage::GetInternalRow(const Options &opts,
+                             property::SortKeysRef sort_key,
+                             std::optional<InternalRow> *row) const noexcept {
+  return data_.GetImmutablePtr()->GetInternalRow(opts, sort_key, row);
+}
+
+Status
+InternalPage::GetSiblingRows(const Options &opts,
+                             property::SortKeysRef sort_key,
+                             std::optional<InternalRow> *left,
+                             std::optional<InternalRow> *right) const noexcept {
+  return data_.GetImmutablePtr()->GetSiblingRows(opts, sort_key, left, right);
+}
+
+Status InternalPage::Merge(const Options &opts,
+                           property::SortKeysRef sort_key) noexcept {
+  Status s;
+  {
+    auto mutable_ptr = data_.GetMutablePtr();
+    s = mutable_ptr->Merge(opts, sort_key);
+  }
+  data_.Promote();
+  return s;
+}
+
+/**
+ * @brief
+ * Format:
+ * | page type 1byte | next child id 8byte | internal rows |
+ */
+std::unique_ptr<PageSnapshot> InternalPage::GetPageSnapshot() const noexcept {
+  util::BufWriter writer;
+  writer.WriteBytes(static_cast<uint8_t>(PageType::InternalPage));
+  writer.WriteBytes(next_child_id_.load(std::memory_order_relaxed));
+  data_.GetImmutablePtr()->Serialize(&writer);
+  return std::make_unique<InternalPageSnapshot>(writer.Detach());
+}
+
+Status InternalPage::Deserialize(std::string_view data) noexcept {
+  util::BufReader reader(data);
+  uint8_t page_type;
+  uint64_t next_child_id;
+  if (!reader.ReadBytes(&page_type) ||
+      page_type != static_cast<uint8_t>(PageType::InternalPage) ||
+      !reader.ReadBytes(&next_child_id)) {
+    return Status::DeserializationFailed();
+  }
+  next_child_id_.store(next_child_id, std::memory_order_relaxed);
+  Status s;
+  {
+    auto mutable_ptr = data_.GetMutablePtr();
+    s = mutable_ptr->Deserialize(&reader);
+  }
+  data_.Promote();
+  return s;
+}
+
 bool InternalPage::TEST_SortKeyAscending() noexcept {
   return data_.GetImmutablePtr()->TEST_SortKeyAscending();
 }
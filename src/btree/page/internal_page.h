@@ -11,12 +11,16 @@
 
 #pragma once
 
+#include "btree/btree_type.h"
+#include "btree/page/page_snapshot.h"
 #include "common/options.h"
 #include "common/status.h"
 #include "common/type.h"
 #include "property/sort_key/sort_key.h"
 #include "util/cow.h"
 #include "util/view.h"
+#include <atomic>
+#include <optional>
 
 namespace arcanedb {
 namespace btree {
@@ -45,9 +49,27 @@ public:
   Status Split(const Options &opts, property::SortKeysRef old_sort_key,
                std::vector<InternalRow> new_internal_rows) noexcept;
 
+  Status GetInternalRow(const Options &opts, property::SortKeysRef sort_key,
+                        std::optional<InternalRow> *row) const noexcept;
+
+  Status GetSiblingRows(const Options &opts, property::SortKeysRef sort_key,
+                        std::optional<InternalRow> *left,
+                        std::optional<InternalRow> *right) const noexcept;
+
+  Status Merge(const Options &opts, property::SortKeysRef sort_key) noexcept;
+
+  void Serialize(util::BufWriter *writer) const noexcept;
+
+  Status Deserialize(util::BufReader *reader) noexcept;
+
+  size_t GetSize() const noexcept { return rows_.size(); }
+
   bool TEST_SortKeyAscending() const noexcept;
 
 private:
+  std::vector<InternalRow>::const_iterator
+  Locate_(property::SortKeysRef sort_key) const noexcept;
+
   std::vector<InternalRow> rows_;
 };
 
@@ -69,7 +91,7 @@ public:
   /**
    * @brief
    * Inserting internal rows into internal page, corresponding to btree split
-   * operation. If old_sort_key is not empty, we will use new_internal_rows to
+   * operation. If internal page is not empty, we will use new_internal_rows to
    * replace the entry which has same sort_key with old_sort_key. otherwise, we
    * will use new_internal_rows to overwrite the entire internal page.
    * @param opts
@@ -80,10 +102,103 @@ public:
   Status Split(const Options &opts, property::SortKeysRef old_sort_key,
                std::vector<InternalRow> new_internal_rows) noexcept;
 
+  /**
+   * @brief
+   * Get the internal row which covers sort_key
+   * @param opts
+   * @param sort_key
+   * @param row
+   * @return Status
+   */
+  Status GetInternalRow(const Options &opts, property::SortKeysRef sort_key,
+                        std::optional<InternalRow> *row) const noexcept;
+
+  /**
+   * @brief
+   * Get the internal row which covers sort_key together with its right
+   * sibling. if the row is the last one, its left sibling and itself
+   * will be returned.
+   * @param opts
+   * @param sort_key
+   * @param left
+   * @param right
+   * @return Status: NotFound when there is only one row.
+   */
+  Status GetSiblingRows(const Options &opts, property::SortKeysRef sort_key,
+                        std::optional<InternalRow> *left,
+                        std::optional<InternalRow> *right) const noexcept;
+
+  /**
+   * @brief
+   * Remove the entry whose sort key is the same as sort_key, corresponding
+   * to btree merge operation. the key range of removed entry will be covered
+   * by its left sibling.
+   * @param opts
+   * @param sort_key
+   * @return Status: NotFound when entry doesn't exist or it's the first one.
+   */
+  Status Merge(const Options &opts, property::SortKeysRef sort_key) noexcept;
+
+  /**
+   * @brief
+   * Allocate page id for new child page.
+   * @param prefix
+   * @return PageIdType
+   */
+  PageIdType AllocateChildPageId(std::string_view prefix) noexcept {
+    return std::string(prefix) + "#" +
+           std::to_string(
+               next_child_id_.fetch_add(1, std::memory_order_relaxed));
+  }
+
+  /**
+   * @brief Get page snapshot which is used to flush page
+   * to persistent storage
+   * @return std::unique_ptr<PageSnapshot>
+   */
+  std::unique_ptr<PageSnapshot> GetPageSnapshot() const noexcept;
+
+  /**
+   * @brief
+   * Deserialize page from data.
+   * @param data
+   * @return Status
+   */
+  Status Deserialize(std::string_view data) noexcept;
+
+  size_t GetChildNum() const noexcept {
+    return data_.GetImmutablePtr()->GetSize();
+  }
+
+  size_t GetTotalCharge() const noexcept {
+    // rough estimation
+    return sizeof(InternalPage) +
+           data_.GetImmutablePtr()->GetSize() * sizeof(InternalRow) * 2;
+  }
+
   bool TEST_SortKeyAscending() noexcept;
 
 private:
   util::Cow<InternalRows> data_;
+  std::atomic<uint64_t> next_child_id_{};
+};
+
+class InternalPageSnapshot : public PageSnapshot {
+public:
+  explicit InternalPageSnapshot(std::string bytes) noexcept
+      : bytes_(std::move(bytes)) {}
+
+  ~InternalPageSnapshot() noexcept override {}
+
+  std::string Serialize() noexcept override { return std::move(bytes_); }
+
+  // internal page is not protected by wal.
+  log_store::LsnType GetLSN() noexcept override {
+    return log_store::kInvalidLsn;
+  }
+
+private:
+  std::string bytes_;
 };
 
 } // namespace btree
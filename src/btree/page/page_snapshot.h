@@ -1,6 +1,8 @@
 #pragma once
 
 #include "log_store/log_store.h"
+#include "util/codec/buf_reader.h"
+#include "util/codec/buf_writer.h"
 
 namespace arcanedb {
 namespace btree {
@@ -14,5 +16,29 @@ public:
   virtual ~PageSnapshot() noexcept {}
 };
 
+namespace detail {
+
+/**
+ * @brief
+ * String format in page snapshot:
+ * | length 2 byte | string varlen |
+ */
+inline void SerializeString(util::BufWriter *writer,
+                            std::string_view str) noexcept {
+  writer->WriteBytes(static_cast<uint16_t>(str.size()));
+  writer->WriteBytes(str);
+}
+
+inline bool DeserializeString(util::BufReader *reader,
+                              std::string_view *str) noexcept {
+  uint16_t length;
+  if (!reader->ReadBytes(&length)) {
+    return false;
+  }
+  return reader->ReadPiece(str, length);
+}
+
+} // namespace detail
+
 } // namespace btree
 } // namespace arcanedb
\ No newline at end of file
@@ -18,7 +18,9 @@
 #include "btree/write_info.h"
 #include "common/btree_scan_opts.h"
 #include "common/filter.h"
+#include <limits>
 #include <mutex>
+#include <optional>
 
 namespace arcanedb {
 namespace btree {
@@ -144,6 +146,19 @@ public:
     return leaf_page_->GetRow(sort_key, read_ts, opts, view);
   }
 
+  /**
+   * @brief
+   * Get write ts of the newest version of sort_key.
+   * @param sort_key
+   * @param write_ts
+   * @return Status
+   */
+  Status GetNewestTs(property::SortKeysRef sort_key,
+                     TxnTs *write_ts) const noexcept {
+    assert(leaf_page_);
+    return leaf_page_->GetNewestTs(sort_key, write_ts);
+  }
+
   /**
    * @brief
    * Set ts of the newest version with "sort_key" to "target_ts"
@@ -151,16 +166,88 @@ public:
    * @param target_ts
    * @param opts
    * @param info
+   * @return Status: PageIdNotMatch when row has been moved to right page.
    */
-  void SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
-             const Options &opts, WriteInfo *info) noexcept {
+  Status SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
+               const Options &opts, WriteInfo *info) noexcept {
     assert(leaf_page_);
-    leaf_page_->SetTs(sort_key, target_ts, opts, info);
+    auto s = leaf_page_->SetTs(sort_key, target_ts, opts, info);
+    if (!s.ok()) {
+      return s;
+    }
     if (info->is_dirty) {
       std::lock_guard<decltype(mu_)> guard(mu_);
       TryMarkDirtyInLock_();
       UpdateAppliedLSN_(info->lsn);
     }
+    return Status::Ok();
+  }
+
+  /**
+   * @brief
+   * Get page id of right sibling,
+   * used when leaf operations return PageIdNotMatch.
+   * @return PageIdType
+   */
+  PageIdType GetRightPageId() const noexcept {
+    assert(leaf_page_);
+    return leaf_page_->GetRightPageId();
+  }
+
+  bool IsMerged() const noexcept {
+    assert(leaf_page_);
+    return leaf_page_->IsMerged();
+  }
+
+  /**
+   * @brief
+   * Get head of delta chain together with the right sibling atomically.
+   * @param right_page_id
+   * @return std::shared_ptr<VersionedDeltaNode>
+   */
+  std::shared_ptr<VersionedDeltaNode>
+  GetDeltaChain(PageIdType *right_page_id) const noexcept {
+    assert(leaf_page_);
+    return leaf_page_->GetDeltaChain(right_page_id);
+  }
+
+  /**
+   * @brief
+   * Split leaf page into two halves, upper half will be moved to right_page.
+   * @param right_page
+   * @param split_key output param, the lower bound of right_page.
+   * @return Status
+   */
+  Status SplitTo(VersionedBtreePage *right_page,
+                 property::SortKeys *split_key) noexcept {
+    assert(leaf_page_);
+    assert(right_page->leaf_page_);
+    return leaf_page_->Split(right_page->leaf_page_.get(), split_key);
+  }
+
+  /**
+   * @brief
+   * Move all rows of leaf page to page.
+   * @param page
+   */
+  void MigrateTo(VersionedBtreePage *page) noexcept {
+    assert(leaf_page_);
+    assert(page->leaf_page_);
+    leaf_page_->MigrateTo(page->leaf_page_.get());
+  }
+
+  /**
+   * @brief
+   * Merge right sibling into leaf page.
+   * @param opts
+   * @param right_page
+   * @return Status
+   */
+  Status MergeFrom(const Options &opts,
+                   VersionedBtreePage *right_page) noexcept {
+    assert(leaf_page_);
+    assert(right_page->leaf_page_);
+    return leaf_page_->Merge(opts, right_page->leaf_page_.get());
   }
 
   /**
@@ -200,6 +287,160 @@ public:
                                  std::move(new_internal_rows));
   }
 
+  /**
+   * @brief
+   * Get the internal row which covers sort_key
+   * @param opts
+   * @param sort_key
+   * @param row
+   * @return Status
+   */
+  Status GetInternalRow(const Options &opts, property::SortKeysRef sort_key,
+                        std::optional<InternalRow> *row) const noexcept {
+    assert(internal_page_);
+    return internal_page_->GetInternalRow(opts, sort_key, row);
+  }
+
+  /**
+   * @brief
+   * Get the internal row which covers sort_key together with its sibling.
+   * @param opts
+   * @param sort_key
+   * @param left
+   * @param right
+   * @return Status
+   */
+  Status GetSiblingRows(const Options &opts, property::SortKeysRef sort_key,
+                        std::optional<InternalRow> *left,
+                        std::optional<InternalRow> *right) const noexcept {
+    assert(internal_page_);
+    return internal_page_->GetSiblingRows(opts, sort_key, left, right);
+  }
+
+  /**
+   * @brief
+   * Remove the internal row with sort_key, corresponding to btree merge
+   * operation.
+   * @param opts
+   * @param sort_key
+   * @return Status
+   */
+  Status Merge(const Options &opts, property::SortKeysRef sort_key) noexcept {
+    assert(internal_page_);
+    return internal_page_->Merge(opts, sort_key);
+  }
+
+  size_t GetChildNum() const noexcept {
+    assert(internal_page_);
+    return internal_page_->GetChildNum();
+  }
+
+  /**
+   * @brief
+   * Allocate page id for new child page.
+   * @return PageIdType
+   */
+  PageIdType AllocateChildPageId() noexcept {
+    assert(internal_page_);
+    return internal_page_->AllocateChildPageId(GetPageKey());
+  }
+
+  /**
+   * @brief
+   * Convert current page to internal page.
+   * leaf page is kept since concurrent readers might still reference it.
+   * @param internal_page
+   */
+  void
+  ConvertToInternalPage(std::unique_ptr<InternalPage> internal_page) noexcept {
+    internal_page_ = std::move(internal_page);
+    ModifyPageType(PageType::InternalPage);
+    std::lock_guard<decltype(mu_)> guard(mu_);
+    // rows are moved to child page along with their logs, snapshot of
+    // internal page carries no lsn, which would never catch up otherwise.
+    applied_lsn_ = flushed_lsn_;
+  }
+
+  /**
+   * @brief
+   * SMO lock is used to serialize structure modification of btree,
+   * only used by root page.
+   * @return ArcanedbLock&
+   */
+  ArcanedbLock &GetSMOLock() noexcept { return smo_mu_; }
+
+  /**
+   * @brief
+   * Mark that a background SMO(split or merge) has been scheduled,
+   * only used by root page.
+   * @return true when no SMO is in progress.
+   */
+  bool TryMarkInSMO() noexcept {
+    bool in_smo = false;
+    return in_smo_.compare_exchange_strong(in_smo, true);
+  }
+
+  void FinishSMO() noexcept { in_smo_.store(false, std::memory_order_release); }
+
+  bool IsInSMO() const noexcept {
+    return in_smo_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief
+   * SMO watermarks, only used by leaf page.
+   * Split is not scheduled until page charge reaches split watermark, and
+   * merge is not scheduled until page charge falls below merge watermark.
+   * @return size_t
+   */
+  size_t GetSplitWatermark() const noexcept {
+    return split_watermark_.load(std::memory_order_relaxed);
+  }
+
+  size_t GetMergeWatermark() const noexcept {
+    return merge_watermark_.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief
+   * Record that split or merge of this page failed at charge, so that it's
+   * not rescheduled by every write. split is retried once charge has
+   * doubled, and merge is retried once charge has halved.
+   * @param is_split
+   * @param charge
+   */
+  void UpdateSMOWatermark(bool is_split, size_t charge) noexcept {
+    if (is_split) {
+      split_watermark_.store(charge * 2, std::memory_order_relaxed);
+    } else {
+      merge_watermark_.store(charge / 2, std::memory_order_relaxed);
+    }
+  }
+
+  void ResetSMOWatermark() noexcept {
+    split_watermark_.store(0, std::memory_order_relaxed);
+    merge_watermark_.store(std::numeric_limits<size_t>::max(),
+                           std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief
+   * Flush lock serializes writes of the same page to page store, so that
+   * SMO could persist pages in order without being overwritten by stale
+   * snapshots taken by flusher.
+   * @return bthread::Mutex&
+   */
+  bthread::Mutex &GetFlushLock() noexcept { return flush_mu_; }
+
+  /**
+   * @brief
+   * Mark page dirty, used by SMO.
+   */
+  void MarkDirty() noexcept {
+    std::lock_guard<decltype(mu_)> guard(mu_);
+    TryMarkDirtyInLock_();
+  }
+
   common::LockTable &GetLockTable() noexcept {
     assert(leaf_page_);
     return leaf_page_->GetLockTable();
@@ -211,6 +452,9 @@ public:
    * @return std::unique_ptr<PageSnapshot>
    */
   std::unique_ptr<PageSnapshot> GetPageSnapshot() noexcept {
+    if (GetPageType() == PageType::InternalPage) {
+      return internal_page_->GetPageSnapshot();
+    }
     assert(leaf_page_);
     return leaf_page_->GetPageSnapshot();
   }
@@ -228,7 +472,24 @@ public:
     if (s.ok()) {
       flushed_lsn_ = std::max(lsn, flushed_lsn_);
     }
-    return NeedFlush_();
+    // page might be modified during flushing without advancing lsn,
+    // e.g. wal is disabled or SMO happens.
+    bool need_flush = !s.ok() || NeedFlush_() || dirty_in_flusher_;
+    dirty_in_flusher_ = false;
+    if (!need_flush) {
+      page_state_ = PageState::kUnDirty;
+    }
+    return need_flush;
+  }
+
+  /**
+   * @brief
+   * Logs up to flushed lsn are persisted in page store.
+   * @return log_store::LsnType
+   */
+  log_store::LsnType GetFlushedLsn() noexcept {
+    std::lock_guard<decltype(mu_)> guard(mu_);
+    return flushed_lsn_;
   }
 
   /**
@@ -238,20 +499,41 @@ public:
    * @return Status
    */
   Status Deserialize(std::string_view data) noexcept {
+    if (!data.empty() &&
+        static_cast<uint8_t>(data[0]) ==
+            static_cast<uint8_t>(PageType::InternalPage)) {
+      auto internal_page = std::make_unique<InternalPage>();
+      auto s = internal_page->Deserialize(data);
+      if (!s.ok()) {
+        return s;
+      }
+      ConvertToInternalPage(std::move(internal_page));
+      return Status::Ok();
+    }
     assert(leaf_page_);
     return leaf_page_->Deserialize(data);
   }
 
   size_t GetTotalCharge() noexcept {
     assert(leaf_page_);
+    if (GetPageType() == PageType::InternalPage) {
+      return leaf_page_->GetTotalCharge() + internal_page_->GetTotalCharge();
+    }
     return leaf_page_->GetTotalCharge();
   }
 
   void RangeFilter(const Options &opts, const Filter &filter,
-                   const BtreeScanOpts &scan_opts,
-                   RangeScanRowView *views) const noexcept {
+                   const BtreeScanOpts &scan_opts, RangeScanRowView *views,
+                   PageIdType *right_page_id = nullptr) const noexcept {
     assert(leaf_page_);
-    return leaf_page_->RangeFilter(opts, filter, scan_opts, views);
+    return leaf_page_->RangeFilter(opts, filter, scan_opts, views,
+                                   right_page_id);
+  }
+
+  Status RangeScan(TxnTs read_ts, const Options &opts, RowView *views,
+                   PageIdType *right_page_id = nullptr) const noexcept {
+    assert(leaf_page_);
+    return leaf_page_->RangeScan(read_ts, opts, views, right_page_id);
   }
 
   RowIterator GetRowIterator() const noexcept {
@@ -259,6 +541,11 @@ public:
     return leaf_page_->GetRowIterator();
   }
 
+  void CollectGarbage(const Options &opts) noexcept {
+    assert(leaf_page_);
+    leaf_page_->CollectGarbage(opts);
+  }
+
   /**
    * @brief
    * Test code below
@@ -294,6 +581,8 @@ private:
   void TryMarkDirtyInLock_() noexcept {
     if (page_state_ == PageState::kUnDirty) {
       page_state_ = PageState::kDirty;
+    } else if (page_state_ == PageState::kInFlusher) {
+      dirty_in_flusher_ = true;
     }
   }
 
@@ -310,9 +599,15 @@ private:
   std::unique_ptr<VersionedBwTreePage> leaf_page_;
   std::unique_ptr<InternalPage> internal_page_;
   std::atomic<PageType> page_type_;
+  ArcanedbLock smo_mu_;
+  std::atomic<bool> in_smo_{false};
+  std::atomic<size_t> split_watermark_{0};
+  std::atomic<size_t> merge_watermark_{std::numeric_limits<size_t>::max()};
+  bthread::Mutex flush_mu_;
 
   bthread::Mutex mu_;
   PageState page_state_{PageState::kUnDirty};              // guarded by mu_
+  bool dirty_in_flusher_{false};                           // guarded by mu_
   log_store::LsnType flushed_lsn_{log_store::kInvalidLsn}; // guarded by mu_
   log_store::LsnType applied_lsn_{log_store::kInvalidLsn}; // guarded by mu_
 };
@@ -16,9 +16,11 @@
 #include "butil/object_pool.h"
 #include "bwtree_page.h"
 #include "common/config.h"
+#include "util/bthread_util.h"
 #include "util/heap.h"
 #include "util/monitor.h"
 #include "wal/bwtree_log_writer.h"
+#include <algorithm>
 #include <cmath>
 #include <map>
 #include <optional>
@@ -26,41 +28,206 @@
 namespace arcanedb {
 namespace btree {
 
-std::shared_ptr<VersionedDeltaNode>
-VersionedBwTreePage::Compaction_(VersionedDeltaNode *current_ptr,
-                                 bool force_compaction) noexcept {
+std::shared_ptr<VersionedDeltaNode> VersionedBwTreePage::Compaction_(
+    VersionedDeltaNode *current_ptr, const CompactionPolicy *policy,
+    const DeltaChainStat &stat, bool force_compaction,
+    std::optional<TxnTs> gc_watermark) noexcept {
   // write_mu_.AssertHeld();
   auto current = current_ptr->GetPrevious();
   VersionedDeltaNodeBuilder builder;
   builder.AddDeltaNode(current_ptr);
-  // simple stragty
-  // TODO(sheep): optimize compaction stragty
-  // currently write amplification is too much.
   while (current != nullptr &&
-         (current->GetSize() == 1 ||
-          builder.GetRowSize() * common::Config::kBwTreeCompactionFactor >
-              current->GetSize() ||
-          force_compaction)) {
+         (force_compaction || policy->ShouldMerge(stat, builder.GetRowSize(),
+                                                  current->GetSize()))) {
     builder.AddDeltaNode(current.get());
     current = current->GetPrevious();
   }
+  if (gc_watermark.has_value()) {
+    builder.RemoveStaleVersions(*gc_watermark);
+    // tombstones could be removed only if there is no older delta.
+    if (current == nullptr) {
+      builder.RemoveDeletedRows(*gc_watermark);
+    }
+  }
   auto new_node = builder.GenerateDeltaNode();
   new_node->SetPrevious(current);
   return new_node;
 }
 
+bool VersionedBwTreePage::NeedCompaction_(const CompactionPolicy *policy,
+                                          bool force_compaction,
+                                          VersionedDeltaNode *current_ptr,
+                                          DeltaChainStat *stat) const noexcept {
+  if (current_ptr == nullptr) {
+    return false;
+  }
+  *stat = DeltaChainStat{
+      .chain_length = current_ptr->GetTotalLength(),
+      .read_cost = read_cost_.load(std::memory_order_relaxed)};
+  return force_compaction ? stat->chain_length > 1
+                          : policy->NeedCompaction(*stat);
+}
+
 void VersionedBwTreePage::MaybePerformCompaction_(
     const Options &opts, VersionedDeltaNode *current_ptr) noexcept {
-  // write_mu_.AssertHeld();
-  auto total_size = current_ptr->GetTotalLength();
-  if ((!opts.disable_compaction &&
-       total_size > common::Config::kBwTreeDeltaChainLength) ||
-      opts.force_compaction) {
-    auto new_ptr = Compaction_(current_ptr, opts.force_compaction);
-    UpdatePtr_(new_ptr);
+  if (opts.disable_compaction && !opts.force_compaction) {
+    return;
+  }
+  auto policy = GetCompactionPolicy_(opts);
+  DeltaChainStat stat;
+  if (!NeedCompaction_(policy, opts.force_compaction, current_ptr, &stat)) {
+    return;
+  }
+  // force compaction is used to get a consolidated page immediately.
+  if (opts.background_compaction && !opts.force_compaction) {
+    ScheduleCompaction_(policy, opts.gc_watermark);
+    return;
+  }
+  PerformCompaction_(policy, opts.force_compaction, opts.gc_watermark);
+}
+
+void VersionedBwTreePage::PerformCompaction_(
+    const CompactionPolicy *policy, bool force_compaction,
+    std::optional<TxnTs> gc_watermark) noexcept {
+  // compaction copies write ts, so it's exclusive with SetTs and smo.
+  ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
+  while (true) {
+    // deltas are only released by compaction and smo, so it's safe to
+    // access them while holding write_mu_.
+    auto head = ptr_head_.load(std::memory_order_acquire);
+    DeltaChainStat stat;
+    // delta chain might have been compacted by others.
+    if (!NeedCompaction_(policy, force_compaction, head, &stat)) {
+      return;
+    }
+    auto new_ptr =
+        Compaction_(head, policy, stat, force_compaction, gc_watermark);
+    if (!CompareAndSwapPtr_(head, new_ptr)) {
+      // newer delta has been prepended, retry.
+      continue;
+    }
+    FinishCompaction_(new_ptr.get());
+    return;
   }
 }
 
+void VersionedBwTreePage::FinishCompaction_(
+    VersionedDeltaNode *new_ptr) noexcept {
+  read_cost_.store(0, std::memory_order_relaxed);
+  compaction_cnt_.fetch_add(1, std::memory_order_relaxed);
+  compaction_bytes_.fetch_add(new_ptr->GetTotalCharge(),
+                              std::memory_order_relaxed);
+  // recalculate charge since compacted deltas are released.
+  // delta chain is bounded, so traversing it here is cheap.
+  size_t charge = sizeof(VersionedBwTreePage);
+  for (auto node = new_ptr; node != nullptr; node = node->GetPreviousPtr()) {
+    charge += node->GetTotalCharge();
+  }
+  total_charge_.store(charge, std::memory_order_relaxed);
+}
+
+void VersionedBwTreePage::CollectGarbage(const Options &opts) noexcept {
+  if (!opts.gc_watermark.has_value()) {
+    return;
+  }
+  auto watermark = *opts.gc_watermark;
+  ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
+  while (true) {
+    auto head = ptr_head_.load(std::memory_order_acquire);
+    // page that has been merged into left sibling stays frozen.
+    if (head == nullptr || IsFrozen_(head)) {
+      return;
+    }
+    if (head->GetTotalLength() == 1 && !head->HasGarbage(watermark)) {
+      return;
+    }
+    DeltaChainStat stat{
+        .chain_length = head->GetTotalLength(),
+        .read_cost = read_cost_.load(std::memory_order_relaxed)};
+    auto new_ptr = Compaction_(head, GetCompactionPolicy_(opts), stat,
+                               /*force_compaction=*/true, watermark);
+    if (!CompareAndSwapPtr_(head, new_ptr)) {
+      continue;
+    }
+    FinishCompaction_(new_ptr.get());
+    return;
+  }
+}
+
+std::shared_ptr<util::ThreadPool> GetCompactionThreadPool_() noexcept {
+  static auto thread_pool = std::make_shared<util::ThreadPool>(
+      common::Config::kBwTreeCompactionThreadNum);
+  return thread_pool;
+}
+
+void VersionedBwTreePage::ScheduleCompaction_(
+    const CompactionPolicy *policy,
+    std::optional<TxnTs> gc_watermark) noexcept {
+  if (compaction_scheduled_.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+  inflight_compaction_.fetch_add(1, std::memory_order_relaxed);
+  util::LaunchAsync(
+      [this, policy, gc_watermark]() {
+        while (true) {
+          PerformCompaction_(policy, /*force_compaction=*/false,
+                             gc_watermark);
+          compaction_scheduled_.store(false, std::memory_order_seq_cst);
+          // writers won't schedule compaction while the flag is set,
+          // so check again to avoid missing their requests.
+          bool need_compaction;
+          {
+            util::EpochGuard guard;
+            DeltaChainStat stat;
+            need_compaction = NeedCompaction_(
+                policy, /*force_compaction=*/false,
+                Untag_(ptr_head_.load(std::memory_order_acquire)), &stat);
+          }
+          if (!need_compaction ||
+              compaction_scheduled_.exchange(true, std::memory_order_acq_rel)) {
+            break;
+          }
+        }
+        // page might be released after this point.
+        inflight_compaction_.fetch_sub(1, std::memory_order_release);
+      },
+      GetCompactionThreadPool_());
+}
+
+void VersionedBwTreePage::WaitForBackgroundCompaction() const noexcept {
+  while (inflight_compaction_.load(std::memory_order_acquire) != 0) {
+    bthread_usleep(100);
+  }
+}
+
+bool VersionedBwTreePage::CompareAndSwapPtr_(
+    VersionedDeltaNode *expected,
+    const std::shared_ptr<VersionedDeltaNode> &new_node) noexcept {
+  auto node = new_node.get();
+  // pin before publishing, so that whoever replaces it could unpin it.
+  node->PinAsHead();
+  if (!ptr_head_.compare_exchange_strong(expected, node,
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+    node->UnpinAsHead();
+    return false;
+  }
+  ReleaseHead_(expected, node);
+  return true;
+}
+
+VersionedDeltaNode *VersionedBwTreePage::Freeze_() noexcept {
+  auto head = ptr_head_.load(std::memory_order_acquire);
+  DCHECK(!IsFrozen_(head));
+  while (!ptr_head_.compare_exchange_weak(
+      head,
+      reinterpret_cast<VersionedDeltaNode *>(
+          reinterpret_cast<uintptr_t>(head) | kFrozenBit),
+      std::memory_order_acq_rel, std::memory_order_acquire)) {
+  }
+  return head;
+}
+
 void AppendLogAndSetLsn_(log_store::LogStore *log_store, WriteInfo *info,
                          const wal::BwTreeLogWriter &log_writer) noexcept {
   log_store::LogStore::LogResultContainer result;
@@ -68,76 +235,267 @@ void AppendLogAndSetLsn_(log_store::LogStore *log_store, WriteInfo *info,
   info->lsn = result[0].end_lsn;
 }
 
-Status VersionedBwTreePage::SetRow(const property::Row &row, TxnTs write_ts,
-                                   const Options &opts,
-                                   WriteInfo *info) noexcept {
-  // make delta
-  auto delta = std::make_shared<VersionedDeltaNode>(row, write_ts);
-
-  // write log
-  wal::BwTreeLogWriter log_writer;
-  if (opts.log_store != nullptr) {
-    log_writer.SetRow(page_id_, opts.txn_id, write_ts, row);
+Status VersionedBwTreePage::Write_(WriteRequest *request) noexcept {
+  auto head = pending_writes_.load(std::memory_order_relaxed);
+  do {
+    request->next = head;
+  } while (!pending_writes_.compare_exchange_weak(head, request,
+                                                  std::memory_order_acq_rel,
+                                                  std::memory_order_relaxed));
+  if (head != nullptr) {
+    // wait for leader to commit current request, or hand over leadership.
+    request->done.Wait();
+    if (!request->is_leader) {
+      return request->status;
+    }
   }
 
-  ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
-  // check intent locked
-  if (opts.check_intent_locked && CheckRowLocked_(row.GetSortKeys(), opts)) {
-    return Status::TxnConflict();
+  // current request is the oldest one, requests above it are newer.
+  std::vector<WriteRequest *> batch;
+  auto batch_head = pending_writes_.load(std::memory_order_acquire);
+  for (auto current = batch_head;; current = current->next) {
+    batch.push_back(current);
+    if (current == request) {
+      break;
+    }
   }
+  CommitBatch_(batch, *request->opts);
 
-  // append log
-  if (opts.log_store != nullptr) {
-    AppendLogAndSetLsn_(opts.log_store, info, log_writer);
-    delta->SetLSN(info->lsn);
+  WriteRequest *next_leader = nullptr;
+  auto expected = batch_head;
+  if (!pending_writes_.compare_exchange_strong(expected, nullptr,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_acquire)) {
+    // new requests arrived, the oldest one will be the next leader.
+    // find it before waking up current batch, since batch_head is
+    // released afterwards.
+    next_leader = expected;
+    while (next_leader->next != batch_head) {
+      next_leader = next_leader->next;
+    }
   }
-  info->is_dirty = true;
-  total_charge_ += delta->GetTotalCharge();
+  for (auto current : batch) {
+    if (current != request) {
+      current->done.Done();
+    }
+  }
+  if (next_leader != nullptr) {
+    next_leader->is_leader = true;
+    next_leader->done.Done();
+  }
+  return request->status;
+}
 
-  // prepend delta
-  auto current_ptr = GetPtr_();
-  delta->SetPrevious(std::move(current_ptr));
-  UpdatePtr_(delta);
+void VersionedBwTreePage::CommitBatch_(const std::vector<WriteRequest *> &batch,
+                                       const Options &opts) noexcept {
+  // append log outside of critical section, log is written once
+  // validation passed, and delta is installed afterwards.
+  bool logged =
+      std::none_of(batch.begin(), batch.end(), [](WriteRequest *request) {
+        return request->opts->log_store != nullptr;
+      });
+  std::shared_ptr<VersionedDeltaNode> node;
+  while (true) {
+    if (!TryInstallBatch_(batch, logged, &node)) {
+      // wait for smo, sleep 20 microseconds
+      bthread_usleep(20);
+      continue;
+    }
+    if (logged) {
+      break;
+    }
+    AppendBatchLog_(batch);
+    logged = true;
+  }
+  // validation might fail after log is written when racing with smo.
+  CompensateBatchLog_(batch);
+  if (node == nullptr) {
+    return;
+  }
+  for (auto request : batch) {
+    if (request->status.ok()) {
+      request->info->is_dirty = true;
+    }
+  }
+  total_charge_ += node->GetTotalCharge();
 
   // perform compaction
-  MaybePerformCompaction_(opts, delta.get());
-  return Status::Ok();
+  MaybePerformCompaction_(opts, node.get());
 }
 
-Status VersionedBwTreePage::DeleteRow(property::SortKeysRef sort_key,
-                                      TxnTs write_ts, const Options &opts,
-                                      WriteInfo *info) noexcept {
-  // make delta
-  auto delta = std::make_shared<VersionedDeltaNode>(sort_key, write_ts);
+void VersionedBwTreePage::AppendBatchLog_(
+    const std::vector<WriteRequest *> &batch) noexcept {
+  // oldest first, so that lsn follows the order of installation.
+  std::vector<WriteRequest *> pending;
+  for (auto it = batch.rbegin(); it != batch.rend(); it++) {
+    auto request = *it;
+    if (request->status.ok() && request->opts->log_store != nullptr &&
+        !request->log_writer->GetLogRecords().empty()) {
+      pending.push_back(request);
+    }
+  }
+  while (!pending.empty()) {
+    auto log_store = pending.front()->opts->log_store;
+    log_store::LogStore::LogRecordContainer records;
+    std::vector<WriteRequest *> group;
+    std::vector<WriteRequest *> rest;
+    for (auto request : pending) {
+      if (request->opts->log_store != log_store) {
+        rest.push_back(request);
+        continue;
+      }
+      const auto &log_records = request->log_writer->GetLogRecords();
+      records.insert(records.end(), log_records.begin(), log_records.end());
+      group.push_back(request);
+    }
+    log_store::LogStore::LogResultContainer result;
+    log_store->AppendLogRecord(records, &result);
+    // request might have multiple records, lsn of the last one is used.
+    size_t idx = 0;
+    for (auto request : group) {
+      idx += request->log_writer->GetLogRecords().size();
+      request->info->lsn = result[idx - 1].end_lsn;
+      request->delta->SetLSN(request->info->lsn);
+      request->logged = true;
+    }
+    pending = std::move(rest);
+  }
+}
 
+void VersionedBwTreePage::CompensateBatchLog_(
+    const std::vector<WriteRequest *> &batch) noexcept {
+  for (auto request : batch) {
+    if (!request->logged || request->status.ok()) {
+      continue;
+    }
+    // abort the version written by request, the same as aborting intents.
+    wal::BwTreeLogWriter log_writer;
+    log_writer.SetTs(page_id_, request->opts->txn_id, kAbortedTxnTs,
+                     request->sort_key);
+    WriteInfo info;
+    AppendLogAndSetLsn_(request->opts->log_store, &info, log_writer);
+  }
+}
+
+bool VersionedBwTreePage::TryInstallBatch_(
+    const std::vector<WriteRequest *> &batch, bool logged,
+    std::shared_ptr<VersionedDeltaNode> *node) noexcept {
+  // requests which are rejected before logging won't be retried.
+  std::vector<WriteRequest *> accepted;
+  for (auto request : batch) {
+    if (!logged || request->status.ok()) {
+      accepted.push_back(request);
+    }
+  }
+  util::EpochGuard guard;
+  while (true) {
+    VersionedDeltaNode *head;
+    const PageLink *link;
+    bool frozen;
+    LoadHead_(&head, &link, &frozen);
+    if (unlikely(frozen)) {
+      return false;
+    }
+    // validate from oldest to newest, so that intent lock acquired by
+    // older requests in the same batch could be observed.
+    size_t accepted_cnt = 0;
+    for (auto it = accepted.rbegin(); it != accepted.rend(); it++) {
+      auto request = *it;
+      request->status = Status::Ok();
+      // check whether row has been moved to right sibling
+      if (unlikely(IsOutOfRange_(link, request->sort_key))) {
+        request->status = Status::PageIdNotMatch();
+        continue;
+      }
+      // check intent locked, older requests in the batch are checked first.
+      if (request->opts->check_intent_locked) {
+        bool locked = false;
+        bool found = false;
+        for (auto prev = it.base(); prev != accepted.end() && !found; prev++) {
+          if (!(*prev)->status.ok()) {
+            continue;
+          }
+          RowView view;
+          auto s = (*prev)->delta->GetRow(request->sort_key, kMaxTxnTs,
+                                          *request->opts, &view);
+          locked = s.IsRowLocked();
+          found = locked || s.ok() || s.IsDeleted();
+        }
+        if (locked || (!found && CheckRowLocked_(head, request->sort_key,
+                                                 *request->opts))) {
+          request->status = Status::TxnConflict();
+          continue;
+        }
+      }
+      accepted_cnt += 1;
+    }
+    if (!logged) {
+      return true;
+    }
+    if (accepted_cnt == 0) {
+      node->reset();
+      return true;
+    }
+
+    // make combined delta
+    if (accepted_cnt == 1) {
+      for (auto request : accepted) {
+        if (request->status.ok()) {
+          *node = request->delta;
+        }
+      }
+    } else {
+      VersionedDeltaNodeBuilder builder;
+      for (auto request : accepted) {
+        if (request->status.ok()) {
+          builder.AddDeltaNode(request->delta.get());
+        }
+      }
+      *node = builder.GenerateDeltaNode();
+    }
+    // prepend delta
+    (*node)->SetPrevious(Share_(head));
+    if (likely(CompareAndSwapPtr_(head, *node))) {
+      return true;
+    }
+  }
+  UNREACHABLE();
+}
+
+Status VersionedBwTreePage::SetRow(const property::Row &row, TxnTs write_ts,
+                                   const Options &opts,
+                                   WriteInfo *info) noexcept {
   // write log
   wal::BwTreeLogWriter log_writer;
   if (opts.log_store != nullptr) {
-    log_writer.DeleteRow(page_id_, opts.txn_id, write_ts, sort_key);
+    log_writer.SetRow(page_id_, opts.txn_id, write_ts, row);
   }
 
-  ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
-  // check intent locked
-  if (opts.check_intent_locked && CheckRowLocked_(sort_key, opts)) {
-    return Status::TxnConflict();
-  }
+  WriteRequest request{
+      .sort_key = row.GetSortKeys(),
+      .delta = std::make_shared<VersionedDeltaNode>(row, write_ts),
+      .log_writer = &log_writer,
+      .opts = &opts,
+      .info = info};
+  return Write_(&request);
+}
 
-  // append log
+Status VersionedBwTreePage::DeleteRow(property::SortKeysRef sort_key,
+                                      TxnTs write_ts, const Options &opts,
+                                      WriteInfo *info) noexcept {
+  // write log
+  wal::BwTreeLogWriter log_writer;
   if (opts.log_store != nullptr) {
-    AppendLogAndSetLsn_(opts.log_store, info, log_writer);
-    delta->SetLSN(info->lsn);
+    log_writer.DeleteRow(page_id_, opts.txn_id, write_ts, sort_key);
   }
-  info->is_dirty = true;
-  total_charge_ += delta->GetTotalCharge();
-
-  // prepend delta
-  auto current_ptr = GetPtr_();
-  delta->SetPrevious(std::move(current_ptr));
-  UpdatePtr_(delta);
 
-  // compaction
-  MaybePerformCompaction_(opts, delta.get());
-  return Status::Ok();
+  WriteRequest request{
+      .sort_key = sort_key,
+      .delta = std::make_shared<VersionedDeltaNode>(sort_key, write_ts),
+      .log_writer = &log_writer,
+      .opts = &opts,
+      .info = info};
+  return Write_(&request);
 }
 
 Status VersionedBwTreePage::GetRow(property::SortKeysRef sort_key,
@@ -148,6 +506,9 @@ Status VersionedBwTreePage::GetRow(property::SortKeysRef sort_key,
     if (!s.IsRetry()) {
       return s;
     }
+    if (opts.no_wait_lock) {
+      return Status::RowLocked();
+    }
     // sleep 20 microseconds
     bthread_usleep(20);
   }
@@ -157,45 +518,161 @@ Status VersionedBwTreePage::GetRow(property::SortKeysRef sort_key,
 Status VersionedBwTreePage::GetRowOnce_(property::SortKeysRef sort_key,
                                         TxnTs read_ts, const Options &opts,
                                         RowView *view) const noexcept {
-  auto shared_ptr = GetPtr_();
-  auto current_ptr = shared_ptr.get();
+  util::EpochGuard guard;
+  VersionedDeltaNode *current_ptr;
+  const PageLink *link;
+  LoadHead_(&current_ptr, &link);
+  if (unlikely(IsOutOfRange_(link, sort_key))) {
+    return Status::PageIdNotMatch();
+  }
   // traverse the delta node
+  size_t traversed = 0;
+  Status s = Status::NotFound();
+  std::optional<uint64_t> hash;
   while (current_ptr != nullptr) {
-    auto s = current_ptr->GetRow(sort_key, read_ts, opts, view);
+    // nodes skipped by filter are cheap, don't count them.
+    if (!current_ptr->MayContain(sort_key, &hash)) {
+      current_ptr = current_ptr->GetPreviousPtr();
+      continue;
+    }
+    traversed += 1;
+    s = current_ptr->GetRow(sort_key, read_ts, opts, view);
     if (s.ok()) {
-      return Status::Ok();
+      break;
     } else if (s.IsDeleted()) {
-      return Status::NotFound();
+      s = Status::NotFound();
+      break;
     } else if (s.IsRowLocked()) {
-      return Status::Retry();
+      s = Status::Retry();
+      break;
+    }
+    current_ptr = current_ptr->GetPreviousPtr();
+  }
+  // consolidated page doesn't touch the counter, so that hot readers
+  // won't contend on it.
+  if (traversed > 1) {
+    read_cost_.fetch_add(traversed - 1, std::memory_order_relaxed);
+  }
+  return s;
+}
+
+Status VersionedBwTreePage::GetNewestTs(property::SortKeysRef sort_key,
+                                        TxnTs *write_ts) const noexcept {
+  util::EpochGuard guard;
+  VersionedDeltaNode *current_ptr;
+  const PageLink *link;
+  LoadHead_(&current_ptr, &link);
+  if (unlikely(IsOutOfRange_(link, sort_key))) {
+    return Status::PageIdNotMatch();
+  }
+  std::optional<uint64_t> hash;
+  for (; current_ptr != nullptr;
+       current_ptr = current_ptr->GetPreviousPtr()) {
+    if (current_ptr->MayContain(sort_key, &hash) &&
+        current_ptr->GetNewestTs(sort_key, write_ts)) {
+      return Status::Ok();
     }
-    current_ptr = current_ptr->GetPrevious().get();
   }
   return Status::NotFound();
 }
 
-bool VersionedBwTreePage::CheckRowLocked_(property::SortKeysRef sort_key,
-                                          const Options &opts) const noexcept {
+Status
+VersionedBwTreePage::RangeScan(TxnTs read_ts, const Options &opts,
+                               RowView *views,
+                               PageIdType *right_page_id) const noexcept {
+  PageIdType tmp_page_id;
+  while (true) {
+    // rows are collected in a temporary view, so that partial result
+    // is discarded when scan is retried.
+    RowView tmp_views;
+    auto s = RangeScanOnce_(read_ts, opts, &tmp_views,
+                            right_page_id != nullptr ? right_page_id
+                                                     : &tmp_page_id);
+    if (!s.IsRetry()) {
+      for (const auto &row : tmp_views) {
+        views->PushBackRef(row);
+      }
+      for (const auto &owner : tmp_views.GetContainer()) {
+        views->AddOwnerPointer(owner);
+      }
+      return s;
+    }
+    if (opts.no_wait_lock) {
+      return Status::RowLocked();
+    }
+    // sleep 20 microseconds
+    bthread_usleep(20);
+  }
+}
+
+Status VersionedBwTreePage::RangeScanOnce_(
+    TxnTs read_ts, const Options &opts, RowView *views,
+    PageIdType *right_page_id) const noexcept {
+  auto head = GetDeltaChain(right_page_id);
+  if (head == nullptr) {
+    return Status::Ok();
+  }
+  // collect sort keys of deleted rows as well, since their old versions
+  // might be visible to read_ts.
+  std::vector<property::SortKeysRef> sort_keys;
+  property::Row row;
+  for (auto current_ptr = head.get(); current_ptr != nullptr;
+       current_ptr = current_ptr->GetPreviousPtr()) {
+    for (size_t i = 0; i < current_ptr->GetSize(); i++) {
+      current_ptr->GetRow(i, &row);
+      sort_keys.push_back(row.GetSortKeys());
+    }
+  }
+  std::sort(sort_keys.begin(), sort_keys.end());
+  sort_keys.erase(std::unique(sort_keys.begin(), sort_keys.end()),
+                  sort_keys.end());
+  views->reserve(sort_keys.size());
+  // chain is pinned by head, read each row the same way as GetRowOnce_.
+  for (const auto &sort_key : sort_keys) {
+    std::optional<uint64_t> hash;
+    for (auto current_ptr = head.get(); current_ptr != nullptr;
+         current_ptr = current_ptr->GetPreviousPtr()) {
+      if (!current_ptr->MayContain(sort_key, &hash)) {
+        continue;
+      }
+      auto s = current_ptr->GetRow(sort_key, read_ts, opts, views);
+      if (s.ok() || s.IsDeleted()) {
+        break;
+      } else if (s.IsRowLocked()) {
+        return Status::Retry();
+      }
+    }
+  }
+  return Status::Ok();
+}
+
+bool VersionedBwTreePage::CheckRowLocked_(VersionedDeltaNode *current_ptr,
+                                          property::SortKeysRef sort_key,
+                                          const Options &opts) noexcept {
   RowView view;
-  auto shared_ptr = GetPtr_();
-  auto current_ptr = shared_ptr.get();
   // read by using max ts.
   TxnTs read_ts = kMaxTxnTs;
+  std::optional<uint64_t> hash;
   // traverse the delta node
   while (current_ptr != nullptr) {
+    if (!current_ptr->MayContain(sort_key, &hash)) {
+      current_ptr = current_ptr->GetPreviousPtr();
+      continue;
+    }
     auto s = current_ptr->GetRow(sort_key, read_ts, opts, &view);
     if (s.IsRowLocked()) {
       return true;
     } else if (s.IsDeleted() || s.ok()) {
       return false;
     }
-    current_ptr = current_ptr->GetPrevious().get();
+    current_ptr = current_ptr->GetPreviousPtr();
   }
   return false;
 }
 
-void VersionedBwTreePage::SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
-                                const Options &opts, WriteInfo *info) noexcept {
+Status VersionedBwTreePage::SetTs(property::SortKeysRef sort_key,
+                                  TxnTs target_ts, const Options &opts,
+                                  WriteInfo *info) noexcept {
   // write log
   wal::BwTreeLogWriter log_writer;
   if (opts.log_store != nullptr) {
@@ -204,8 +681,12 @@ void VersionedBwTreePage::SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
 
   // acquire write lock
   ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
-  auto shared_ptr = GetPtr_();
-  auto current_ptr = shared_ptr.get();
+  if (unlikely(IsOutOfRange_(sort_key))) {
+    return Status::PageIdNotMatch();
+  }
+  // deltas won't be released while holding write_mu_, since writers only
+  // prepend new deltas.
+  auto current_ptr = Untag_(ptr_head_.load(std::memory_order_acquire));
 
   // append log
   if (opts.log_store != nullptr) {
@@ -216,17 +697,157 @@ void VersionedBwTreePage::SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
   while (current_ptr != nullptr) {
     auto s = current_ptr->SetTs(sort_key, target_ts, info->lsn);
     if (likely(s.ok())) {
-      // need to perform dummy update,
-      // so that readers afterward will see our update.
-      DummyUpdate_();
-      return;
+      // make sure readers afterward will see our update.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      return Status::Ok();
     }
     DCHECK(s.IsNotFound());
-    current_ptr = current_ptr->GetPrevious().get();
+    current_ptr = current_ptr->GetPreviousPtr();
   }
   UNREACHABLE();
 }
 
+bool VersionedBwTreePage::IsMerged() const noexcept {
+  util::EpochGuard guard;
+  auto link = link_head_.load(std::memory_order_acquire);
+  return link != nullptr && !link->merged_page_id.empty();
+}
+
+PageIdType VersionedBwTreePage::GetRightPageId() const noexcept {
+  util::EpochGuard guard;
+  auto link = link_head_.load(std::memory_order_acquire);
+  if (link == nullptr) {
+    return PageIdType();
+  }
+  return link->merged_page_id.empty() ? link->right_page_id
+                                      : link->merged_page_id;
+}
+
+std::shared_ptr<VersionedDeltaNode>
+VersionedBwTreePage::GetDeltaChain(PageIdType *right_page_id) const noexcept {
+  util::EpochGuard guard;
+  VersionedDeltaNode *head;
+  const PageLink *link;
+  LoadHead_(&head, &link);
+  *right_page_id = link != nullptr ? link->right_page_id : PageIdType();
+  return Share_(head);
+}
+
+Status VersionedBwTreePage::Split(VersionedBwTreePage *right_page,
+                                  property::SortKeys *split_key) noexcept {
+  ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
+  VersionedDeltaNodeBuilder left;
+  for (auto current_ptr = Freeze_(); current_ptr != nullptr;
+       current_ptr = current_ptr->GetPreviousPtr()) {
+    left.AddDeltaNode(current_ptr);
+  }
+  VersionedDeltaNodeBuilder right;
+  auto s = left.Split(&right, split_key);
+  if (s.ok()) {
+    InstallSplit_(&left, &right, *split_key, right_page);
+  }
+  Unfreeze_();
+  return s;
+}
+
+void VersionedBwTreePage::MigrateTo(VersionedBwTreePage *page) noexcept {
+  ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
+  VersionedDeltaNodeBuilder builder;
+  for (auto current_ptr = Freeze_(); current_ptr != nullptr;
+       current_ptr = current_ptr->GetPreviousPtr()) {
+    builder.AddDeltaNode(current_ptr);
+  }
+  // empty high key indicates that every row has been moved.
+  VersionedDeltaNodeBuilder empty;
+  InstallSplit_(&empty, &builder, property::SortKeys(std::string_view()),
+                page);
+  Unfreeze_();
+}
+
+Status VersionedBwTreePage::Merge(const Options &opts,
+                                  VersionedBwTreePage *right_page) noexcept {
+  // always lock from left to right
+  ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
+  ArcanedbLockGuard<ArcanedbLock> right_guard(right_page->write_mu_);
+  if (link_ == nullptr || link_->right_page_id != right_page->page_id_ ||
+      (right_page->link_ != nullptr &&
+       !right_page->link_->merged_page_id.empty())) {
+    return Status::PageIdNotMatch();
+  }
+  // freeze both pages, so that no delta is missed.
+  VersionedDeltaNodeBuilder builder;
+  for (auto current_ptr = Freeze_(); current_ptr != nullptr;
+       current_ptr = current_ptr->GetPreviousPtr()) {
+    builder.AddDeltaNode(current_ptr);
+  }
+  for (auto current_ptr = right_page->Freeze_(); current_ptr != nullptr;
+       current_ptr = current_ptr->GetPreviousPtr()) {
+    builder.AddDeltaNode(current_ptr);
+  }
+  if (opts.gc_watermark.has_value()) {
+    builder.RemoveDeletedRows(*opts.gc_watermark);
+  }
+  std::shared_ptr<VersionedDeltaNode> node;
+  size_t charge = sizeof(VersionedBwTreePage);
+  if (builder.GetRowSize() != 0) {
+    node = builder.GenerateDeltaNode();
+    charge += node->GetTotalCharge();
+  }
+  total_charge_.store(charge, std::memory_order_relaxed);
+  // key range is extended, so publish rows before link.
+  UpdatePtr_(std::move(node));
+  UpdateLink_(right_page->link_);
+
+  // freeze right page, rows are visible in current page already.
+  auto right_link = std::make_shared<PageLink>(
+      right_page->link_ != nullptr
+          ? *right_page->link_
+          : PageLink{.high_key = property::SortKeys(std::string_view())});
+  right_link->merged_page_id = page_id_;
+  right_page->UpdateLink_(std::move(right_link));
+  // right page is kept as a stub redirecting to current page, its rows are
+  // released once concurrent readers leave epoch.
+  right_page->UpdatePtr_(nullptr);
+  right_page->total_charge_.store(sizeof(VersionedBwTreePage),
+                                  std::memory_order_relaxed);
+  // writers blocked on right page will be redirected to current page.
+  right_page->Unfreeze_();
+  Unfreeze_();
+  return Status::Ok();
+}
+
+void VersionedBwTreePage::InstallSplit_(
+    VersionedDeltaNodeBuilder *left, VersionedDeltaNodeBuilder *right,
+    property::SortKeys split_key, VersionedBwTreePage *right_page) noexcept {
+  auto generate = [](VersionedDeltaNodeBuilder *builder,
+                     VersionedBwTreePage *page) {
+    std::shared_ptr<VersionedDeltaNode> node;
+    size_t charge = sizeof(VersionedBwTreePage);
+    if (builder->GetRowSize() != 0) {
+      node = builder->GenerateDeltaNode();
+      charge += node->GetTotalCharge();
+    }
+    page->total_charge_.store(charge, std::memory_order_relaxed);
+    return node;
+  };
+  // install right page first, so that rows could be found
+  // once the link is visible.
+  {
+    auto right_node = generate(right, right_page);
+    ArcanedbLockGuard<ArcanedbLock> guard(right_page->write_mu_);
+    right_page->Freeze_();
+    right_page->UpdatePtr_(std::move(right_node));
+    right_page->UpdateLink_(link_);
+    right_page->Unfreeze_();
+  }
+  auto left_node = generate(left, this);
+  // key range is shrunk, so publish link before rows.
+  UpdateLink_(std::make_shared<PageLink>(
+      PageLink{.high_key = std::move(split_key),
+               .right_page_id = right_page->page_id_}));
+  UpdatePtr_(std::move(left_node));
+}
+
 std::string VersionedBwTreePage::TEST_DumpPage() const noexcept {
   struct BuildEntry {
     const property::Row row;
@@ -243,7 +864,7 @@ std::string VersionedBwTreePage::TEST_DumpPage() const noexcept {
           map[row.GetSortKeys()].emplace_back(BuildEntry{
               .row = row, .is_deleted = is_deleted, .write_ts = write_ts});
         });
-    current_ptr = current_ptr->GetPrevious().get();
+    current_ptr = current_ptr->GetPreviousPtr();
   }
   std::string result = "BwTreePageDump:\n";
   for (const auto &[sk, vec] : map) {
@@ -272,7 +893,7 @@ bool VersionedBwTreePage::TEST_TsDesending() const noexcept {
           map[row.GetSortKeys()].emplace_back(BuildEntry{
               .row = row, .is_deleted = is_deleted, .write_ts = write_ts});
         });
-    current_ptr = current_ptr->GetPrevious().get();
+    current_ptr = current_ptr->GetPreviousPtr();
   }
   for (const auto &[sk, vec] : map) {
     std::optional<TxnTs> last_valid_ts{std::nullopt};
@@ -296,7 +917,10 @@ bool VersionedBwTreePage::TEST_Equal(
 /**
  * @brief
  * Format:
- * | lsn 8byte | row1 v0 | row1 v1 | ... | rowN v0 | ...
+ * | page type 1byte | lsn 8byte | link | row1 v0 | row1 v1 | ... | rowN v0 |
+ * Link format:
+ * | has link 1byte | high key varlen | right page id varlen |
+ * | merged page id varlen |
  * Row format:
  * | delete bit 1byte | write_ts 4byte | row varlen |
  */
@@ -307,7 +931,19 @@ std::unique_ptr<PageSnapshot> VersionedBwTreePage::GetPageSnapshot() noexcept {
     TxnTs write_ts;
   };
   std::map<property::SortKeysRef, std::vector<BuildEntry>> map;
-  auto shared_ptr = GetPtr_();
+  std::optional<PageLink> link;
+  std::shared_ptr<VersionedDeltaNode> shared_ptr;
+  {
+    // read ptr and link atomically
+    util::EpochGuard guard;
+    VersionedDeltaNode *head;
+    const PageLink *link_ptr;
+    LoadHead_(&head, &link_ptr);
+    shared_ptr = Share_(head);
+    if (link_ptr != nullptr) {
+      link = *link_ptr;
+    }
+  }
   auto current_ptr = shared_ptr.get();
   // traverse the delta node
   log_store::LsnType lsn{};
@@ -319,12 +955,19 @@ std::unique_ptr<PageSnapshot> VersionedBwTreePage::GetPageSnapshot() noexcept {
               .row = row, .is_deleted = is_deleted, .write_ts = write_ts});
         },
         should_lock);
-    current_ptr = current_ptr->GetPrevious().get();
+    current_ptr = current_ptr->GetPreviousPtr();
     lsn = std::max(lsn, tmp_lsn);
   }
 
   util::BufWriter writer;
+  writer.WriteBytes(static_cast<uint8_t>(PageType::LeafPage));
   writer.WriteBytes(lsn);
+  writer.WriteBytes(static_cast<uint8_t>(link.has_value()));
+  if (link.has_value()) {
+    detail::SerializeString(&writer, link->high_key.as_slice());
+    detail::SerializeString(&writer, link->right_page_id);
+    detail::SerializeString(&writer, link->merged_page_id);
+  }
   auto serialize_row = [](util::BufWriter *writer, const property::Row &row,
                           bool is_deleted, TxnTs write_ts) {
     writer->WriteBytes(static_cast<uint8_t>(is_deleted));
@@ -346,8 +989,29 @@ Status VersionedBwTreePage::Deserialize(std::string_view data) noexcept {
       map;
 
   util::BufReader reader(data);
+  uint8_t page_type;
   log_store::LsnType lsn;
-  reader.ReadBytes(&lsn);
+  uint8_t has_link;
+  if (!reader.ReadBytes(&page_type) ||
+      page_type != static_cast<uint8_t>(PageType::LeafPage) ||
+      !reader.ReadBytes(&lsn) || !reader.ReadBytes(&has_link)) {
+    return Status::DeserializationFailed();
+  }
+  std::shared_ptr<PageLink> link;
+  if (has_link != 0) {
+    std::string_view high_key;
+    std::string_view right_page_id;
+    std::string_view merged_page_id;
+    if (!detail::DeserializeString(&reader, &high_key) ||
+        !detail::DeserializeString(&reader, &right_page_id) ||
+        !detail::DeserializeString(&reader, &merged_page_id)) {
+      return Status::DeserializationFailed();
+    }
+    link = std::make_shared<PageLink>(
+        PageLink{.high_key = property::SortKeys(high_key),
+                 .right_page_id = PageIdType(right_page_id),
+                 .merged_page_id = PageIdType(merged_page_id)});
+  }
 
   auto deserialize_entry = [&]() {
     uint8_t is_deleted;
@@ -378,6 +1042,7 @@ Status VersionedBwTreePage::Deserialize(std::string_view data) noexcept {
       // newest version
       VersionedDeltaNodeBuilder::WriteRow_(rows, &writer, entry);
       versions.push_back({});
+      sk = entry.row.GetSortKeys();
     }
   }
   if (!has_version) {
@@ -387,7 +1052,14 @@ Status VersionedBwTreePage::Deserialize(std::string_view data) noexcept {
   auto delta = std::make_shared<VersionedDeltaNode>(
       writer.Detach(), version_writer.Detach(), std::move(rows),
       std::move(versions));
-  UpdatePtr_(delta);
+  delta->SetLSN(lsn);
+  total_charge_.store(sizeof(VersionedBwTreePage) + delta->GetTotalCharge(),
+                      std::memory_order_relaxed);
+  ArcanedbLockGuard<ArcanedbLock> guard(write_mu_);
+  Freeze_();
+  UpdateLink_(std::move(link));
+  UpdatePtr_(std::move(delta));
+  Unfreeze_();
   return Status::Ok();
 }
 
@@ -395,16 +1067,24 @@ bool VersionedBwTreePage::FinishFlush(const Status &s,
                                       log_store::LsnType lsn) noexcept {}
 
 struct DeltaNodeIteratorComparator {
+  // heap will pop the maximum element, reverse the order
+  // so that rows are produced in ascending order.
   bool operator()(const VersionedDeltaNode::DeltaNodeIterator &lhs,
                   const VersionedDeltaNode::DeltaNodeIterator &rhs) noexcept {
-    return lhs.GetRow().GetSortKeys() < rhs.GetRow().GetSortKeys();
+    return lhs.GetRow().GetSortKeys() > rhs.GetRow().GetSortKeys();
   }
 };
 
-void VersionedBwTreePage::RangeFilter(const Options &opts, const Filter &filter,
-                                      const BtreeScanOpts &scan_opts,
-                                      RangeScanRowView *views) const noexcept {
-  auto shared_ptr = GetPtr_();
+void VersionedBwTreePage::RangeFilter(
+    const Options &opts, const Filter &filter, const BtreeScanOpts &scan_opts,
+    RangeScanRowView *views, PageIdType *right_page_id) const noexcept {
+  PageIdType tmp_page_id;
+  auto shared_ptr =
+      GetDeltaChain(right_page_id != nullptr ? right_page_id : &tmp_page_id);
+  if (shared_ptr == nullptr) {
+    return;
+  }
+  views->AddOwnerPointer(shared_ptr);
   auto current_ptr = shared_ptr.get();
   int row_cnt = 0;
   int delta_node_cnt = 0;
@@ -418,9 +1098,12 @@ void VersionedBwTreePage::RangeFilter(const Options &opts, const Filter &filter,
     if (it.Valid()) {
       heap.push(it);
     }
-    current_ptr = current_ptr->GetPrevious().get();
+    current_ptr = current_ptr->GetPreviousPtr();
   }
   views->reserve(row_cnt);
+  if (delta_node_cnt > 1) {
+    read_cost_.fetch_add(delta_node_cnt - 1, std::memory_order_relaxed);
+  }
 
   if (delta_node_cnt == 1) {
     // fast path
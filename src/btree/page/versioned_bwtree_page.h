@@ -12,30 +12,45 @@
 #pragma once
 
 #include "btree/btree_type.h"
+#include "btree/page/compaction_policy.h"
 #include "btree/page/page_snapshot.h"
 #include "btree/page/versioned_delta_node.h"
 #include "btree/write_info.h"
-#include "butil/containers/doubly_buffered_data.h"
 #include "common/btree_scan_opts.h"
 #include "common/filter.h"
 #include "common/lock_table.h"
 #include "common/options.h"
 #include "common/status.h"
 #include "property/row/row.h"
+#include "util/epoch.h"
+#include "util/wait_group.h"
 #include <atomic>
+#include <optional>
 
 namespace arcanedb {
+
+namespace wal {
+class BwTreeLogWriter;
+} // namespace wal
+
 namespace btree {
 
 class RowIterator {
 public:
   RowIterator(std::shared_ptr<VersionedDeltaNode> delta_node) noexcept
-      : owner_(std::move(delta_node)) {
-    current_node_ = owner_.get();
-    bool deleted = current_node_->GetRow(current_idx_, &current_row_);
-    if (!deleted) {
-      return;
-    }
+      : RowIterator(std::vector<std::shared_ptr<VersionedDeltaNode>>{
+            std::move(delta_node)}) {}
+
+  /**
+   * @brief
+   * Iterate over multiple delta chains one after another,
+   * used to traverse the leaf pages of a multi-level btree.
+   * @param delta_nodes head of delta chains, could be nullptr.
+   */
+  RowIterator(
+      std::vector<std::shared_ptr<VersionedDeltaNode>> delta_nodes) noexcept
+      : owners_(std::move(delta_nodes)) {
+    current_node_ = NextOwner_();
     Next();
   }
 
@@ -46,12 +61,13 @@ public:
   void Next() noexcept {
     while (current_node_ != nullptr) {
       current_idx_ += 1;
-      if (current_idx_ == current_node_->GetSize()) {
-        current_idx_ = 0;
-        current_node_ = current_node_->GetPrevious().get();
+      if (current_idx_ >= static_cast<int>(current_node_->GetSize())) {
+        current_idx_ = -1;
+        current_node_ = current_node_->GetPreviousPtr();
         if (current_node_ == nullptr) {
-          break;
+          current_node_ = NextOwner_();
         }
+        continue;
       }
       bool deleted = current_node_->GetRow(current_idx_, &current_row_);
       if (!deleted) {
@@ -61,10 +77,35 @@ public:
   }
 
 private:
-  std::shared_ptr<VersionedDeltaNode> owner_;
+  VersionedDeltaNode *NextOwner_() noexcept {
+    while (owner_idx_ < owners_.size()) {
+      auto node = owners_[owner_idx_++].get();
+      if (node != nullptr) {
+        return node;
+      }
+    }
+    return nullptr;
+  }
+
+  std::vector<std::shared_ptr<VersionedDeltaNode>> owners_;
+  size_t owner_idx_{};
   VersionedDeltaNode *current_node_{};
   property::Row current_row_;
-  int current_idx_{};
+  int current_idx_{-1};
+};
+
+/**
+ * @brief
+ * Right link installed by split, B-link style.
+ * rows whose sort key is greater or equal than high_key
+ * have been moved to page with right_page_id.
+ */
+struct PageLink {
+  property::SortKeys high_key;
+  PageIdType right_page_id;
+  // set when page has been merged into left sibling,
+  // every row is out of range in this case.
+  PageIdType merged_page_id{};
 };
 
 class VersionedBwTreePage {
@@ -72,6 +113,14 @@ public:
   VersionedBwTreePage(const std::string_view &page_id) noexcept
       : page_id_(page_id) {}
 
+  ~VersionedBwTreePage() noexcept {
+    WaitForBackgroundCompaction();
+    auto head = Untag_(ptr_head_.load(std::memory_order_acquire));
+    if (head != nullptr) {
+      head->UnpinAsHead();
+    }
+  }
+
   std::string_view GetPageKey() const noexcept { return page_id_; }
 
   const std::string GetPageKeyRef() const noexcept { return page_id_; }
@@ -102,6 +151,18 @@ public:
   Status DeleteRow(property::SortKeysRef sort_key, TxnTs write_ts,
                    const Options &opts, WriteInfo *info) noexcept;
 
+  /**
+   * @brief
+   * Get write ts of the newest version of sort_key, tombstone and intent
+   * included.
+   * @param sort_key
+   * @param write_ts
+   * @return Status: NotFound when there is no version of sort_key.
+   * PageIdNotMatch when sort_key is out of range.
+   */
+  Status GetNewestTs(property::SortKeysRef sort_key,
+                     TxnTs *write_ts) const noexcept;
+
   /**
    * @brief
    * Get a row from page
@@ -121,9 +182,61 @@ public:
    * @param target_ts
    * @param opts
    * @param info
+   * @return Status: PageIdNotMatch when row has been moved to right page.
    */
-  void SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
-             const Options &opts, WriteInfo *info) noexcept;
+  Status SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
+               const Options &opts, WriteInfo *info) noexcept;
+
+  /**
+   * @brief
+   * Get page id to retry on when operations return PageIdNotMatch,
+   * which is the right sibling, or the page which current page
+   * has been merged into.
+   * @return PageIdType empty when there is no right sibling.
+   */
+  PageIdType GetRightPageId() const noexcept;
+
+  /**
+   * @brief
+   * Whether current page has been merged into its left sibling,
+   * rows of merged page are released.
+   */
+  bool IsMerged() const noexcept;
+
+  /**
+   * @brief
+   * Split page into two halves. rows whose sort key is greater or equal than
+   * split_key are moved to right_page, and a link pointing to right_page is
+   * installed in current page, so that concurrent operations could still
+   * find the rows by following the link.
+   * right_page should be an empty page which is not visible to others yet.
+   * @param right_page
+   * @param split_key output param
+   * @return Status: NotFound when there are not enough rows to split.
+   */
+  Status Split(VersionedBwTreePage *right_page,
+               property::SortKeys *split_key) noexcept;
+
+  /**
+   * @brief
+   * Move all rows to page, current page will be left empty and linked to page.
+   * Used when root page is converted to internal page.
+   * @param page
+   */
+  void MigrateTo(VersionedBwTreePage *page) noexcept;
+
+  /**
+   * @brief
+   * Merge right sibling into current page. right_page becomes a stub
+   * afterwards, operations on it will be redirected to current page.
+   * Rows of right_page are released once concurrent readers leave epoch,
+   * scanners reaching it should restart.
+   * Rows deleted before opts.gc_watermark are removed during merge.
+   * @param opts
+   * @param right_page
+   * @return Status: PageIdNotMatch when right_page is not the right sibling.
+   */
+  Status Merge(const Options &opts, VersionedBwTreePage *right_page) noexcept;
 
   common::LockTable &GetLockTable() noexcept { return lock_table_; }
 
@@ -156,12 +269,72 @@ public:
     return total_charge_.load(std::memory_order_relaxed);
   }
 
+  /**
+   * @brief
+   * Range scan
+   * @param opts
+   * @param filter
+   * @param scan_opts
+   * @param views
+   * @param right_page_id output param, right sibling of the scanned data.
+   * could be nullptr.
+   */
   void RangeFilter(const Options &opts, const Filter &filter,
-                   const BtreeScanOpts &scan_opts,
-                   RangeScanRowView *views) const noexcept;
+                   const BtreeScanOpts &scan_opts, RangeScanRowView *views,
+                   PageIdType *right_page_id = nullptr) const noexcept;
+
+  /**
+   * @brief
+   * Snapshot range scan, rows visible to read_ts are returned in the order
+   * of sort key. Scan waits for intents that are not owned by opts.owner_ts,
+   * the same as GetRow.
+   * @param read_ts
+   * @param opts
+   * @param views
+   * @param right_page_id output param, right sibling of the scanned data.
+   * could be nullptr.
+   * @return Status RowLocked when opts.no_wait_lock is set and a row is
+   * locked by others, nothing is returned in views then.
+   */
+  Status RangeScan(TxnTs read_ts, const Options &opts, RowView *views,
+                 PageIdType *right_page_id = nullptr) const noexcept;
 
   RowIterator GetRowIterator() const noexcept { return RowIterator(GetPtr_()); }
 
+  /**
+   * @brief
+   * Get head of delta chain together with the right sibling atomically.
+   * @param right_page_id output param
+   * @return std::shared_ptr<VersionedDeltaNode>
+   */
+  std::shared_ptr<VersionedDeltaNode>
+  GetDeltaChain(PageIdType *right_page_id) const noexcept;
+
+  /**
+   * @brief
+   * Wait until background compaction of current page is finished.
+   */
+  void WaitForBackgroundCompaction() const noexcept;
+
+  /**
+   * @brief
+   * Consolidate delta chain and remove versions that are invisible to
+   * readers whose read ts is not less than opts.gc_watermark,
+   * as well as aborted versions and tombstones.
+   * Nothing happens when opts.gc_watermark is not set.
+   * @param opts
+   */
+  void CollectGarbage(const Options &opts) noexcept;
+
+  CompactionStat GetCompactionStat() const noexcept {
+    auto ptr = GetPtr_();
+    return CompactionStat{
+        .chain_length = ptr != nullptr ? ptr->GetTotalLength() : 0,
+        .read_cost = read_cost_.load(std::memory_order_relaxed),
+        .compaction_cnt = compaction_cnt_.load(std::memory_order_relaxed),
+        .compaction_bytes = compaction_bytes_.load(std::memory_order_relaxed)};
+  }
+
   size_t TEST_GetDeltaLength() const noexcept {
     auto ptr = GetPtr_();
     return ptr->GetTotalLength();
@@ -174,64 +347,250 @@ public:
   bool TEST_Equal(const VersionedBwTreePage &rhs) const noexcept;
 
 private:
-  using DoublyBufferedData =
-      butil::DoublyBufferedData<std::shared_ptr<VersionedDeltaNode>>;
-
   std::shared_ptr<VersionedDeltaNode>
-  Compaction_(VersionedDeltaNode *current_ptr, bool force_compaction) noexcept;
+  Compaction_(VersionedDeltaNode *current_ptr, const CompactionPolicy *policy,
+              const DeltaChainStat &stat, bool force_compaction,
+              std::optional<TxnTs> gc_watermark) noexcept;
 
   void MaybePerformCompaction_(const Options &opts,
                                VersionedDeltaNode *current_ptr) noexcept;
 
+  static const CompactionPolicy *
+  GetCompactionPolicy_(const Options &opts) noexcept {
+    return opts.compaction_policy != nullptr ? opts.compaction_policy
+                                             : CompactionPolicy::GetDefault();
+  }
+
+  // require current_ptr is alive.
+  bool NeedCompaction_(const CompactionPolicy *policy, bool force_compaction,
+                       VersionedDeltaNode *current_ptr,
+                       DeltaChainStat *stat) const noexcept;
+
+  // compact current delta chain synchronously.
+  void PerformCompaction_(const CompactionPolicy *policy,
+                          bool force_compaction,
+                          std::optional<TxnTs> gc_watermark) noexcept;
+
+  // schedule compaction to background workers, at most one compaction
+  // task is scheduled for each page.
+  // the task only captures policy and watermark instead of options,
+  // so policy must outlive the page.
+  void ScheduleCompaction_(const CompactionPolicy *policy,
+                           std::optional<TxnTs> gc_watermark) noexcept;
+
+  // update statistics after compacted chain is installed.
+  void FinishCompaction_(VersionedDeltaNode *new_ptr) noexcept;
+
   Status GetRowOnce_(property::SortKeysRef sort_key, TxnTs read_ts,
                      const Options &opts, RowView *view) const noexcept;
 
-  bool CheckRowLocked_(property::SortKeysRef sort_key,
-                       const Options &opts) const noexcept;
+  Status RangeScanOnce_(TxnTs read_ts, const Options &opts, RowView *views,
+                        PageIdType *right_page_id) const noexcept;
+
+  static bool CheckRowLocked_(VersionedDeltaNode *current_ptr,
+                              property::SortKeysRef sort_key,
+                              const Options &opts) noexcept;
+
+  struct WriteRequest {
+    property::SortKeysRef sort_key;
+    // single row delta
+    std::shared_ptr<VersionedDeltaNode> delta;
+    const wal::BwTreeLogWriter *log_writer;
+    const Options *opts;
+    WriteInfo *info;
+    Status status{};
+    // set when leadership is handed over to current request.
+    bool is_leader{false};
+    // set when log records of request are appended.
+    bool logged{false};
+    WriteRequest *next{};
+    util::WaitGroup done{1};
+  };
+
+  /**
+   * @brief
+   * Group commit. Concurrent writers are pushed to pending_writes_, the first
+   * one becomes leader and commits requests on behalf of the others with one
+   * combined delta and one log append. Leadership is handed over to the
+   * oldest pending request once current batch is finished.
+   * @param request
+   * @return Status
+   */
+  Status Write_(WriteRequest *request) noexcept;
+
+  // batch is ordered from newest to oldest.
+  void CommitBatch_(const std::vector<WriteRequest *> &batch,
+                    const Options &opts) noexcept;
+
+  // append log records of accepted requests, requests are grouped by
+  // their log store, and each group is appended at once.
+  void AppendBatchLog_(const std::vector<WriteRequest *> &batch) noexcept;
+
+  // requests rejected after their logs are written won't be installed,
+  // write abort records for them so that they won't be replayed.
+  void CompensateBatchLog_(const std::vector<WriteRequest *> &batch) noexcept;
+
+  // validate requests against current head, and try to prepend combined
+  // delta by CAS. validation is redone whenever head is changed.
+  // return false when page is frozen by smo.
+  bool TryInstallBatch_(const std::vector<WriteRequest *> &batch,
+                        bool logged,
+                        std::shared_ptr<VersionedDeltaNode> *node) noexcept;
 
   std::shared_ptr<VersionedDeltaNode> GetPtr_() const noexcept {
-    // DoublyBufferedData::ScopedPtr scoped_ptr;
-    // CHECK(ptr_.Read(&scoped_ptr) == 0);
-    // return *scoped_ptr;
-    std::shared_ptr<VersionedDeltaNode> res;
-    lock_.Lock();
-    res = ptr_;
-    lock_.Unlock();
-    return res;
+    util::EpochGuard guard;
+    return Share_(Untag_(ptr_head_.load(std::memory_order_acquire)));
   }
 
-  void UpdatePtr_(std::shared_ptr<VersionedDeltaNode> new_node) noexcept {
-    // ptr_.Modify(UpdateFn_, new_node);
-    lock_.Lock();
-    ptr_ = new_node;
-    lock_.Unlock();
+  // require epoch guard.
+  // load head of delta chain and link consistently.
+  // split publishes link before delta chain, and merge publishes delta chain
+  // before link, so the pair is consistent once link is unchanged.
+  void LoadHead_(VersionedDeltaNode **head, const PageLink **link,
+                 bool *frozen = nullptr) const noexcept {
+    *link = link_head_.load(std::memory_order_acquire);
+    while (true) {
+      auto tagged_head = ptr_head_.load(std::memory_order_acquire);
+      auto current_link = link_head_.load(std::memory_order_acquire);
+      if (likely(current_link == *link)) {
+        *head = Untag_(tagged_head);
+        if (frozen != nullptr) {
+          *frozen = IsFrozen_(tagged_head);
+        }
+        return;
+      }
+      *link = current_link;
+    }
+  }
+
+  static std::shared_ptr<VersionedDeltaNode>
+  Share_(VersionedDeltaNode *node) noexcept {
+    if (node == nullptr) {
+      return nullptr;
+    }
+    return std::static_pointer_cast<VersionedDeltaNode>(
+        node->shared_from_this());
+  }
+
+  static bool IsOutOfRange_(const PageLink *link,
+                            property::SortKeysRef sort_key) noexcept {
+    return link != nullptr &&
+           (!link->merged_page_id.empty() || sort_key >= link->high_key);
+  }
+
+  // require guarded by write_mu_
+  bool IsOutOfRange_(property::SortKeysRef sort_key) const noexcept {
+    return IsOutOfRange_(link_.get(), sort_key);
+  }
+
+  // lowest bit of head pointer indicates that page is frozen by smo,
+  // writers should wait until smo is finished.
+  static constexpr uintptr_t kFrozenBit = 1;
+
+  static bool IsFrozen_(VersionedDeltaNode *tagged_ptr) noexcept {
+    return reinterpret_cast<uintptr_t>(tagged_ptr) & kFrozenBit;
+  }
+
+  static VersionedDeltaNode *Untag_(VersionedDeltaNode *tagged_ptr) noexcept {
+    return reinterpret_cast<VersionedDeltaNode *>(
+        reinterpret_cast<uintptr_t>(tagged_ptr) & ~kFrozenBit);
+  }
+
+  // require guarded by write_mu_
+  void InstallSplit_(VersionedDeltaNodeBuilder *left,
+                     VersionedDeltaNodeBuilder *right,
+                     property::SortKeys split_key,
+                     VersionedBwTreePage *right_page) noexcept;
+
+  /**
+   * @brief
+   * Replace head from expected to new_node, lock-free.
+   * @return false when head is not expected, e.g. delta is prepended
+   * concurrently or page is frozen.
+   */
+  bool CompareAndSwapPtr_(
+      VersionedDeltaNode *expected,
+      const std::shared_ptr<VersionedDeltaNode> &new_node) noexcept;
+
+  // release the reference of replaced head.
+  static void ReleaseHead_(VersionedDeltaNode *old_node,
+                           VersionedDeltaNode *new_node) noexcept {
+    if (old_node == nullptr) {
+      return;
+    }
+    auto old_ref = old_node->UnpinAsHead();
+    // old node is still referenced by new node when delta is prepended,
+    // otherwise it might be accessed by readers, so retire it.
+    if (new_node == nullptr || new_node->GetPreviousPtr() != old_node) {
+      util::EpochManager::GetInstance()->Retire(std::move(old_ref));
+    }
   }
 
-  void DummyUpdate_() const noexcept {
-    // ptr_.Modify(DummyFn_);
-    lock_.Lock();
-    lock_.Unlock();
+  /**
+   * @brief
+   * Freeze page so that writers couldn't prepend delta anymore,
+   * require guarded by write_mu_.
+   * @return VersionedDeltaNode* head of delta chain.
+   */
+  VersionedDeltaNode *Freeze_() noexcept;
+
+  // require guarded by write_mu_ and page is frozen.
+  void Unfreeze_() noexcept {
+    auto head = ptr_head_.load(std::memory_order_relaxed);
+    DCHECK(IsFrozen_(head));
+    ptr_head_.store(Untag_(head), std::memory_order_release);
   }
 
-  static bool DummyFn_(std::shared_ptr<VersionedDeltaNode> &old_node) noexcept {
-    return true;
+  // require guarded by write_mu_ and page is frozen.
+  // page stays frozen after update.
+  void UpdatePtr_(std::shared_ptr<VersionedDeltaNode> new_node) noexcept {
+    auto old_node = Untag_(ptr_head_.load(std::memory_order_relaxed));
+    DCHECK(IsFrozen_(ptr_head_.load(std::memory_order_relaxed)));
+    auto node = new_node.get();
+    if (node != nullptr) {
+      node->PinAsHead();
+    }
+    ptr_head_.store(reinterpret_cast<VersionedDeltaNode *>(
+                        reinterpret_cast<uintptr_t>(node) | kFrozenBit),
+                    std::memory_order_release);
+    ReleaseHead_(old_node, node);
   }
 
-  static bool UpdateFn_(std::shared_ptr<VersionedDeltaNode> &old_node,
-                        std::shared_ptr<VersionedDeltaNode> new_node) noexcept {
-    old_node = new_node;
-    return true;
+  // require guarded by write_mu_
+  void UpdateLink_(std::shared_ptr<const PageLink> new_link) noexcept {
+    auto old_link = std::move(link_);
+    link_ = std::move(new_link);
+    link_head_.store(link_.get(), std::memory_order_release);
+    if (old_link != nullptr) {
+      util::EpochManager::GetInstance()->Retire(std::move(old_link));
+    }
   }
 
-  // TODO(sheep) use group commit to optimize write performance
   // mutable ArcanedbLock write_mu_{"VersionedBwTreePageWriteMutex"};
+  // writers prepend delta by CAS on ptr_head_ without holding write_mu_,
+  // it's used to serialize smo, compaction and SetTs, which rewrite or
+  // modify existing deltas.
   mutable ArcanedbLock write_mu_;
-  // mutable DoublyBufferedData ptr_;
-  mutable absl::base_internal::SpinLock lock_;
-  std::shared_ptr<VersionedDeltaNode> ptr_;
+  // head of delta chain is owned by itself through PinAsHead, and link is
+  // owned by link_ which is guarded by write_mu_. readers access them
+  // through raw pointers under epoch guard without touching reference count,
+  // replaced objects are retired to epoch manager.
+  std::atomic<VersionedDeltaNode *> ptr_head_{};
+  std::shared_ptr<const PageLink> link_;
+  std::atomic<const PageLink *> link_head_{};
+  // stack of pending write requests, the bottom one is leader.
+  std::atomic<WriteRequest *> pending_writes_{};
   common::LockTable lock_table_;
   const std::string page_id_;
   std::atomic<size_t> total_charge_{sizeof(VersionedBwTreePage)};
+  // compaction counters
+  mutable std::atomic<uint64_t> read_cost_{};
+  std::atomic<uint64_t> compaction_cnt_{};
+  std::atomic<uint64_t> compaction_bytes_{};
+  // set when background compaction is scheduled.
+  std::atomic<bool> compaction_scheduled_{false};
+  // page couldn't be released until background compaction is finished.
+  std::atomic<size_t> inflight_compaction_{};
 };
 
 class VersionedBwTreePageSnapshot : public PageSnapshot {
@@ -10,6 +10,9 @@
  */
 
 #include "btree/page/versioned_delta_node.h"
+#include "util/codec/endian.h"
+#include <algorithm>
+#include <cstring>
 
 namespace arcanedb {
 namespace btree {
@@ -44,21 +47,130 @@ VersionedDeltaNode::VersionedDeltaNode(property::SortKeysRef sort_key,
   rows_.push_back(entry);
 }
 
+uint64_t
+VersionedDeltaNode::GetKeyPrefix_(std::string_view sort_key) const noexcept {
+  char buf[sizeof(uint64_t)] = {};
+  if (sort_key.size() > common_prefix_length_) {
+    sort_key.remove_prefix(common_prefix_length_);
+    memcpy(buf, sort_key.data(), std::min(sort_key.size(), sizeof(buf)));
+  }
+  return endian::read_be<uint64_t>(buf);
+}
+
+void VersionedDeltaNode::BuildKeyPrefixes_() noexcept {
+  if (rows_.size() < kKeyPrefixThreshold) {
+    return;
+  }
+  // rows are sorted, so the common prefix of the first and the last key
+  // is shared by all keys.
+  auto first = GetSortKeys_(rows_.front()).as_slice();
+  auto last = GetSortKeys_(rows_.back()).as_slice();
+  auto mismatch =
+      std::mismatch(first.begin(), first.end(), last.begin(), last.end());
+  common_prefix_length_ = std::distance(first.begin(), mismatch.first);
+  key_prefixes_.reserve(rows_.size());
+  for (const auto &entry : rows_) {
+    key_prefixes_.push_back(GetKeyPrefix_(GetSortKeys_(entry).as_slice()));
+  }
+}
+
+void VersionedDeltaNode::BuildFilter_() noexcept {
+  if (rows_.size() < 2) {
+    return;
+  }
+  filter_ = util::BloomFilter(rows_.size());
+  for (const auto &entry : rows_) {
+    filter_.Add(HashSortKey_(GetSortKeys_(entry)));
+  }
+}
+
+std::vector<VersionedDeltaNode::Entry>::const_iterator
+VersionedDeltaNode::Search_(property::SortKeysRef sort_key) const noexcept {
+  auto less = [&](const Entry &entry, const property::SortKeysRef &sort_key) {
+    return GetSortKeys_(entry) < sort_key;
+  };
+  auto first = rows_.begin();
+  auto last = rows_.end();
+  if (!key_prefixes_.empty()) {
+    auto slice = sort_key.as_slice();
+    auto common_prefix =
+        GetSortKeys_(rows_.front()).as_slice().substr(0, common_prefix_length_);
+    if (slice.substr(0, common_prefix_length_) != common_prefix) {
+      return rows_.end();
+    }
+    // only rows with the same prefix need full comparison.
+    auto range = std::equal_range(key_prefixes_.begin(), key_prefixes_.end(),
+                                  GetKeyPrefix_(slice));
+    first = rows_.begin() + (range.first - key_prefixes_.begin());
+    last = rows_.begin() + (range.second - key_prefixes_.begin());
+  }
+  auto it = std::lower_bound(first, last, sort_key, less);
+  if (it == last || GetSortKeys_(*it) != sort_key) {
+    return rows_.end();
+  }
+  return it;
+}
+
 void VersionedDeltaNodeBuilder::AddDeltaNode(
     const VersionedDeltaNode *node) noexcept {
-  node->Traverse([&](const property::Row &row, bool is_deleted,
+  auto lsn = node->Traverse([&](const property::Row &row, bool is_deleted,
                      TxnTs write_ts) {
     // skip aborted version
     if (write_ts == kAbortedTxnTs) {
       return;
     }
-    // TODO(sheep): remove old version
     map_[row.GetSortKeys()].emplace_back(
         BuildEntry{.row = row, .is_deleted = is_deleted, .write_ts = write_ts});
   });
+  lsn_ = std::max(lsn_, lsn);
   delta_cnt_ += 1;
 }
 
+Status
+VersionedDeltaNodeBuilder::Split(VersionedDeltaNodeBuilder *right,
+                                 property::SortKeys *split_key) noexcept {
+  if (map_.size() < 2) {
+    return Status::NotFound();
+  }
+  auto it = std::next(map_.begin(), map_.size() / 2);
+  *split_key = it->first.deref();
+  while (it != map_.end()) {
+    right->map_.insert(map_.extract(it++));
+  }
+  right->lsn_ = lsn_;
+  right->delta_cnt_ = delta_cnt_;
+  return Status::Ok();
+}
+
+void VersionedDeltaNodeBuilder::RemoveDeletedRows(TxnTs watermark) noexcept {
+  for (auto it = map_.begin(); it != map_.end();) {
+    const auto &newest = it->second[0];
+    if (newest.is_deleted && !IsLocked(newest.write_ts) &&
+        newest.write_ts <= watermark) {
+      it = map_.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+void VersionedDeltaNodeBuilder::RemoveStaleVersions(TxnTs watermark) noexcept {
+  for (auto &[sk, vec] : map_) {
+    // versions are ordered from newest to oldest.
+    auto it = std::find_if(vec.begin(), vec.end(), [&](const BuildEntry &e) {
+      return !IsLocked(e.write_ts) && e.write_ts <= watermark;
+    });
+    if (it == vec.end()) {
+      continue;
+    }
+    // entry is not assignable, pop from back instead of erase.
+    size_t keep = std::distance(vec.begin(), it) + 1;
+    while (vec.size() > keep) {
+      vec.pop_back();
+    }
+  }
+}
+
 std::shared_ptr<VersionedDeltaNode>
 VersionedDeltaNodeBuilder::GenerateDeltaNode() noexcept {
   // generate rows_, buffer_, versions_, version_buffer_
@@ -81,9 +193,34 @@ VersionedDeltaNodeBuilder::GenerateDeltaNode() noexcept {
   if (!has_version) {
     versions.clear();
   }
-  return std::make_shared<VersionedDeltaNode>(
+  auto node = std::make_shared<VersionedDeltaNode>(
       writer.Detach(), version_writer.Detach(), std::move(rows),
       std::move(versions));
+  node->SetLSN(lsn_);
+  return node;
+}
+
+bool VersionedDeltaNode::HasGarbage(TxnTs watermark) const noexcept {
+  for (size_t i = 0; i < rows_.size(); i++) {
+    size_t version_cnt = versions_.empty() ? 0 : versions_[i].size();
+    // entries are visited from newest to oldest.
+    for (size_t j = 0; j <= version_cnt; j++) {
+      const auto &entry = j == 0 ? rows_[i] : versions_[i][j - 1];
+      auto write_ts = entry.write_ts.load(std::memory_order_relaxed);
+      if (write_ts == kAbortedTxnTs) {
+        return true;
+      }
+      if (IsLocked(write_ts) || write_ts > watermark) {
+        continue;
+      }
+      // newest stable version shadows the older ones, and it could be
+      // removed as well if it's the newest tombstone.
+      if (j < version_cnt || (j == 0 && IsDeleted(entry.control_bit))) {
+        return true;
+      }
+    }
+  }
+  return false;
 }
 
 std::string VersionedDeltaNode::TEST_DumpChain() const noexcept {
@@ -15,9 +15,11 @@
 #include "log_store/log_store.h"
 #include "property/row/row.h"
 #include "property/sort_key/sort_key.h"
+#include "util/bloom_filter.h"
 #include <atomic>
 #include <cstddef>
 #include <memory>
+#include <optional>
 #include <string>
 
 namespace arcanedb {
@@ -42,6 +44,10 @@ class VersionedDeltaNode : public RowOwner {
 
   static constexpr size_t kDefaultVersionChainLength = 8;
 
+  // consolidated node with at least this many rows builds key prefixes
+  // for point lookup.
+  static constexpr size_t kKeyPrefixThreshold = 16;
+
   using VersionContainer =
       std::vector<absl::InlinedVector<Entry, kDefaultVersionChainLength>>;
 
@@ -56,7 +62,10 @@ public:
                      std::vector<Entry> rows,
                      VersionContainer versions) noexcept
       : buffer_(std::move(buffer)), version_buffer_(std::move(version_buffer)),
-        rows_(std::move(rows)), versions_(std::move(versions)) {}
+        rows_(std::move(rows)), versions_(std::move(versions)) {
+    BuildKeyPrefixes_();
+    BuildFilter_();
+  }
 
   struct DeltaNodeIterator {
 
@@ -92,6 +101,28 @@ public:
     return previous_;
   }
 
+  // previous node is immutable once current node is published,
+  // so it's safe to traverse through raw pointer as long as
+  // current node is alive.
+  VersionedDeltaNode *GetPreviousPtr() const noexcept {
+    return previous_.get();
+  }
+
+  /**
+   * @brief
+   * Page holds the head of delta chain through a self reference,
+   * so that head could be replaced by a single CAS on raw pointer.
+   * Only the one who installs or replaces the head should touch it.
+   */
+  void PinAsHead() noexcept {
+    head_ref_ =
+        std::static_pointer_cast<VersionedDeltaNode>(shared_from_this());
+  }
+
+  std::shared_ptr<VersionedDeltaNode> UnpinAsHead() noexcept {
+    return std::move(head_ref_);
+  }
+
   bool GetRow(int idx, property::Row *row) const noexcept {
     auto offset = GetOffset(rows_[idx].control_bit);
     *row = property::Row(buffer_.data() + offset);
@@ -155,6 +186,42 @@ public:
     return lsn;
   }
 
+  /**
+   * @brief
+   * Whether node might contain sort_key, used to skip nodes during
+   * point read. Nodes with single row don't build filter.
+   * @param sort_key
+   * @param hash hash of sort_key, computed on first use.
+   */
+  bool MayContain(property::SortKeysRef sort_key,
+                  std::optional<uint64_t> *hash) const noexcept {
+    if (filter_.empty()) {
+      return true;
+    }
+    if (!hash->has_value()) {
+      *hash = HashSortKey_(sort_key);
+    }
+    return filter_.MayContain(**hash);
+  }
+
+  /**
+   * @brief
+   * Get write ts of the newest version of sort_key in current node,
+   * tombstone and intent included.
+   * @param sort_key
+   * @param write_ts
+   * @return false when sort_key is not found.
+   */
+  bool GetNewestTs(property::SortKeysRef sort_key,
+                   TxnTs *write_ts) const noexcept {
+    auto it = Search_(sort_key);
+    if (it == rows_.end()) {
+      return false;
+    }
+    *write_ts = it->write_ts.load(std::memory_order_relaxed);
+    return true;
+  }
+
   /**
    * @brief
    * Point read
@@ -167,13 +234,7 @@ public:
   Status GetRow(property::SortKeysRef sort_key, TxnTs read_ts,
                 const Options &opts, RowView *view) const noexcept {
     // first locate sort_key
-    auto it = std::lower_bound(
-        rows_.begin(), rows_.end(), sort_key,
-        [&](const Entry &entry, const property::SortKeysRef &sort_key) {
-          auto offset = GetOffset(entry.control_bit);
-          auto row = property::Row(buffer_.data() + offset);
-          return row.GetSortKeys() < sort_key;
-        });
+    auto it = Search_(sort_key);
     if (it == rows_.end()) {
       return Status::NotFound();
     }
@@ -181,10 +242,6 @@ public:
     auto &entry = *it;
     auto offset = GetOffset(entry.control_bit);
     auto row = property::Row(buffer_.data() + offset);
-    if (row.GetSortKeys() != sort_key) {
-      // sk not match
-      return Status::NotFound();
-    }
 
     // only newest version can be locked
     // relaxed here is ok since we will acquire lock outside, which has the
@@ -267,12 +324,22 @@ public:
 
   VersionedDeltaNode() = default;
 
+  /**
+   * @brief
+   * Whether there are old versions or deleted rows that are invisible
+   * to readers whose read ts is not less than watermark.
+   * @param watermark
+   */
+  bool HasGarbage(TxnTs watermark) const noexcept;
+
   std::string TEST_DumpChain() const noexcept;
 
   size_t GetTotalCharge() noexcept {
     // TODO(sheep): take versions into account.
     return buffer_.size() + version_buffer_.size() +
-           rows_.capacity() * sizeof(Entry) + sizeof(VersionedDeltaNode);
+           rows_.capacity() * sizeof(Entry) +
+           key_prefixes_.capacity() * sizeof(uint64_t) +
+           filter_.GetCharge() + sizeof(VersionedDeltaNode);
   }
 
 private:
@@ -314,11 +381,41 @@ private:
     entry->control_bit = entry->control_bit | (1 << kStateOffset);
   }
 
+  property::SortKeysRef GetSortKeys_(const Entry &entry) const noexcept {
+    auto offset = GetOffset(entry.control_bit);
+    return property::Row(buffer_.data() + offset).GetSortKeys();
+  }
+
+  // 8 bytes of sort key after the common prefix in big endian, padded with
+  // zero. sort keys are compared bytewise, so keys with smaller prefix are
+  // smaller as well.
+  uint64_t GetKeyPrefix_(std::string_view sort_key) const noexcept;
+
+  void BuildKeyPrefixes_() noexcept;
+
+  static uint64_t HashSortKey_(property::SortKeysRef sort_key) noexcept {
+    return absl::Hash<std::string_view>()(sort_key.as_slice());
+  }
+
+  void BuildFilter_() noexcept;
+
+  // locate the row with sort_key, return rows_.end() when it's not found.
+  std::vector<Entry>::const_iterator
+  Search_(property::SortKeysRef sort_key) const noexcept;
+
   std::string buffer_{};
   std::string version_buffer_{};
   std::vector<Entry> rows_{};
+  // key prefixes of rows_, stored contiguously so that binary search
+  // won't touch buffer_ unless prefixes are equal. empty for small node.
+  std::vector<uint64_t> key_prefixes_{};
+  // length of common prefix shared by all sort keys, which is skipped
+  // when generating key prefixes, e.g. type tag of the first column.
+  uint32_t common_prefix_length_{};
+  util::BloomFilter filter_{};
   VersionContainer versions_;
   std::shared_ptr<VersionedDeltaNode> previous_{};
+  std::shared_ptr<VersionedDeltaNode> head_ref_{};
   uint32_t total_length_{};
   std::atomic<log_store::LsnType> lsn_{};
   // spin lock is used to protect the atomicity of
@@ -340,6 +437,36 @@ public:
 
   size_t GetDeltaCount() const noexcept { return delta_cnt_; }
 
+  /**
+   * @brief
+   * Split the rows collected by builder into two halves.
+   * rows whose sort key is greater or equal than split_key are moved into
+   * right builder.
+   * @param right
+   * @param split_key output param, the smallest sort key of right builder.
+   * @return Status: NotFound when there are less than two rows.
+   */
+  Status Split(VersionedDeltaNodeBuilder *right,
+               property::SortKeys *split_key) noexcept;
+
+  /**
+   * @brief
+   * Remove rows whose newest version is a committed tombstone not newer
+   * than watermark, i.e. rows that are deleted for every reader.
+   * Only safe when builder has collected the entire delta chain.
+   * @param watermark
+   */
+  void RemoveDeletedRows(TxnTs watermark) noexcept;
+
+  /**
+   * @brief
+   * Remove versions which are invisible to every reader, i.e. versions
+   * older than the newest committed version not newer than watermark.
+   * Aborted versions are skipped when collecting deltas already.
+   * @param watermark
+   */
+  void RemoveStaleVersions(TxnTs watermark) noexcept;
+
 private:
   struct BuildEntry {
     const property::Row row;
@@ -361,7 +488,8 @@ private:
   }
 
   std::map<property::SortKeysRef, std::vector<BuildEntry>> map_;
-  size_t delta_cnt_;
+  size_t delta_cnt_{};
+  log_store::LsnType lsn_{};
 };
 
 } // namespace btree
@@ -97,9 +97,9 @@ public:
    * @param opts
    * @return Status
    */
-  void SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
-             const Options &opts, WriteInfo *info) noexcept {
-    cluster_index_.SetTs(sort_key, target_ts, opts, info);
+  Status SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
+               const Options &opts, WriteInfo *info) noexcept {
+    return cluster_index_.SetTs(sort_key, target_ts, opts, info);
   }
 
   /**
@@ -116,13 +116,38 @@ public:
     cluster_index_.RangeFilter(opts, filter, scan_opts, views);
   }
 
+  /**
+   * @brief
+   * Snapshot range scan
+   * @param read_ts
+   * @param opts
+   * @param views rows visible to read_ts, ordered by sort key.
+   * @return Status
+   */
+  Status RangeScan(TxnTs read_ts, const Options &opts,
+                   RowView *views) const noexcept {
+    return cluster_index_.RangeScan(read_ts, opts, views);
+  }
+
   /**
    * @brief
    * Range scan without order
+   * @param opts
    * @return RowIterator
    */
-  RowIterator GetRowIterator() const noexcept {
-    return cluster_index_.GetRowIterator();
+  RowIterator GetRowIterator(const Options &opts) const noexcept {
+    return cluster_index_.GetRowIterator(opts);
+  }
+
+  /**
+   * @brief
+   * Remove versions that are invisible to readers whose read ts
+   * is not less than opts.gc_watermark.
+   * @param opts
+   * @return Status
+   */
+  Status CollectGarbage(const Options &opts) noexcept {
+    return cluster_index_.CollectGarbage(opts);
   }
 
   common::LockTable &GetLockTable() noexcept {
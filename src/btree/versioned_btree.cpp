@@ -11,102 +11,511 @@
 
 #include "btree/versioned_btree.h"
 #include "cache/buffer_pool.h"
+#include "common/logger.h"
 #include "common/macros.h"
+#include "util/bthread_util.h"
 
 namespace arcanedb {
 namespace btree {
 
-Status VersionedBtree::SetRow(const property::Row &row, TxnTs write_ts,
-                              const Options &opts, WriteInfo *info) noexcept {
-  auto page_type = root_page_->GetPageType();
-  Status s;
-  switch (page_type) {
-  case PageType::LeafPage: {
-    s = root_page_->SetRow(row, write_ts, opts, info);
-    if (s.ok() && info->is_dirty) {
-      opts.buffer_pool->TryInsertDirtyPage(root_page_);
-      root_page_.UpdateCharge(root_page_->GetTotalCharge());
+Status VersionedBtree::GetLeafPage_(const Options &opts,
+                                    property::SortKeysRef sort_key,
+                                    PageHolder *page) const noexcept {
+  *page = root_page_;
+  while ((*page)->GetPageType() == PageType::InternalPage) {
+    InternalRowView view;
+    auto s = (*page)->GetPageId(opts, sort_key, &view);
+    if (unlikely(!s.ok())) {
+      return s;
+    }
+    s = opts.buffer_pool->GetPage(view.at(0), page);
+    if (unlikely(!s.ok())) {
+      return s;
+    }
+  }
+  return Status::Ok();
+}
+
+template <typename Func>
+Status VersionedBtree::LeafOperation_(const Options &opts,
+                                      property::SortKeysRef sort_key,
+                                      const Func &func) const noexcept {
+  // fast path for single level btree
+  if (root_page_->GetPageType() == PageType::LeafPage) {
+    auto s = func(root_page_);
+    if (likely(!s.IsPageIdNotMatch())) {
+      return s;
     }
-    break;
   }
-  case PageType::InternalPage: {
-    NOTIMPLEMENTED();
-    break;
+  PageHolder page;
+  auto s = GetLeafPage_(opts, sort_key, &page);
+  if (unlikely(!s.ok())) {
+    return s;
   }
+  while (true) {
+    s = func(page);
+    if (likely(!s.IsPageIdNotMatch())) {
+      return s;
+    }
+    // row has been moved to right sibling by split.
+    auto right_page_id = page->GetRightPageId();
+    if (unlikely(right_page_id.empty())) {
+      // page has no link to follow, retry from root page which has been
+      // updated by SMO.
+      s = GetLeafPage_(opts, sort_key, &page);
+    } else {
+      s = opts.buffer_pool->GetPage(right_page_id, &page);
+    }
+    if (unlikely(!s.ok())) {
+      return s;
+    }
   }
-  return s;
+  UNREACHABLE();
+}
+
+void VersionedBtree::UpdateDirtyPage_(const Options &opts,
+                                      const PageHolder &page) const noexcept {
+  opts.buffer_pool->TryInsertDirtyPage(page);
+  page.UpdateCharge(page->GetTotalCharge());
+}
+
+void VersionedBtree::MaybeTriggerSplit_(
+    const Options &opts, const PageHolder &page,
+    property::SortKeysRef sort_key) noexcept {
+  if (likely(opts.page_split_threshold == 0 || opts.buffer_pool == nullptr)) {
+    return;
+  }
+  auto charge = page->GetTotalCharge();
+  if (likely(charge < opts.page_split_threshold ||
+             charge < page->GetSplitWatermark())) {
+    return;
+  }
+  ScheduleSMO_(opts, page, sort_key, /*is_split=*/true);
+}
+
+void VersionedBtree::MaybeTriggerMerge_(
+    const Options &opts, const PageHolder &page,
+    property::SortKeysRef sort_key) noexcept {
+  // root leaf page has no sibling to merge with
+  if (likely(opts.page_merge_threshold == 0 || opts.buffer_pool == nullptr ||
+             page.Get() == root_page_.Get())) {
+    return;
+  }
+  auto charge = page->GetTotalCharge();
+  if (likely(charge >= opts.page_merge_threshold ||
+             charge >= page->GetMergeWatermark())) {
+    return;
+  }
+  ScheduleSMO_(opts, page, sort_key, /*is_split=*/false);
+}
+
+void VersionedBtree::ScheduleSMO_(const Options &opts, const PageHolder &page,
+                                  property::SortKeysRef sort_key,
+                                  bool is_split) noexcept {
+  // SMO is serialized by smo lock of root page,
+  // so there is no need to schedule more than one SMO.
+  if (!root_page_->TryMarkInSMO()) {
+    return;
+  }
+  // caller's options might refer to schema or log store which doesn't
+  // outlive the SMO, so only owned state is captured. pages are released
+  // before buffer pool is notified, which waits for SMOs on destruction.
+  Options smo_opts;
+  smo_opts.buffer_pool = opts.buffer_pool;
+  smo_opts.page_split_threshold = opts.page_split_threshold;
+  smo_opts.page_merge_threshold = opts.page_merge_threshold;
+  smo_opts.max_leaf_page_num = opts.max_leaf_page_num;
+  smo_opts.gc_watermark = opts.gc_watermark;
+  smo_opts.buffer_pool->BeginSMO();
+  util::LaunchAsync([root_page = root_page_, page = page, smo_opts,
+                     sort_key = sort_key.deref(), is_split]() mutable {
+    {
+      VersionedBtree btree(root_page);
+      auto s = is_split ? btree.SplitLeafPage(smo_opts, sort_key.as_ref())
+                        : btree.MergeLeafPage(smo_opts, sort_key.as_ref());
+      // NotFound indicates that page could not be split or merged,
+      // don't retry until its charge has changed enough.
+      if (s.IsNotFound()) {
+        page->UpdateSMOWatermark(is_split, page->GetTotalCharge());
+      } else if (unlikely(!s.ok())) {
+        ARCANEDB_WARN("Failed to {} page of btree {}, status: {}",
+                      is_split ? "split" : "merge", btree.GetRootPageKey(),
+                      s.ToString());
+      }
+    }
+    root_page->FinishSMO();
+    page = PageHolder();
+    root_page = PageHolder();
+    smo_opts.buffer_pool->FinishSMO();
+  });
+}
+
+Status VersionedBtree::SetRow(const property::Row &row, TxnTs write_ts,
+                              const Options &opts, WriteInfo *info) noexcept {
+  return LeafOperation_(
+      opts, row.GetSortKeys(), [&](const PageHolder &page) {
+        auto s = page->SetRow(row, write_ts, opts, info);
+        if (s.ok() && info->is_dirty) {
+          UpdateDirtyPage_(opts, page);
+          MaybeTriggerSplit_(opts, page, row.GetSortKeys());
+        }
+        return s;
+      });
 }
 
 Status VersionedBtree::DeleteRow(property::SortKeysRef sort_key, TxnTs write_ts,
                                  const Options &opts,
                                  WriteInfo *info) noexcept {
-  auto page_type = root_page_->GetPageType();
-  Status s;
-  switch (page_type) {
-  case PageType::LeafPage: {
-    s = root_page_->DeleteRow(sort_key, write_ts, opts, info);
+  return LeafOperation_(opts, sort_key, [&](const PageHolder &page) {
+    auto s = page->DeleteRow(sort_key, write_ts, opts, info);
+    if (s.ok() && info->is_dirty) {
+      UpdateDirtyPage_(opts, page);
+      MaybeTriggerMerge_(opts, page, sort_key);
+    }
+    return s;
+  });
+}
+
+Status VersionedBtree::SetTs(property::SortKeysRef sort_key,
+                             TxnTs target_ts, const Options &opts,
+                             WriteInfo *info) noexcept {
+  return LeafOperation_(opts, sort_key, [&](const PageHolder &page) {
+    auto s = page->SetTs(sort_key, target_ts, opts, info);
     if (s.ok() && info->is_dirty) {
-      opts.buffer_pool->TryInsertDirtyPage(root_page_);
-      root_page_.UpdateCharge(root_page_->GetTotalCharge());
+      opts.buffer_pool->TryInsertDirtyPage(page);
+    }
+    return s;
+  });
+}
+
+Status VersionedBtree::GetRow(property::SortKeysRef sort_key, TxnTs read_ts,
+                              const Options &opts,
+                              RowView *view) const noexcept {
+  return LeafOperation_(opts, sort_key, [&](const PageHolder &page) {
+    return page->GetRow(sort_key, read_ts, opts, view);
+  });
+}
+
+Status VersionedBtree::GetNewestTs(property::SortKeysRef sort_key,
+                                   const Options &opts,
+                                   TxnTs *write_ts) const noexcept {
+  return LeafOperation_(opts, sort_key, [&](const PageHolder &page) {
+    return page->GetNewestTs(sort_key, write_ts);
+  });
+}
+
+template <typename Func>
+Status VersionedBtree::ForEachLeafPage_(const Options &opts,
+                                        const Func &func) const noexcept {
+  PageIdType right_page_id;
+  if (root_page_->GetPageType() == PageType::LeafPage) {
+    auto s = func(root_page_, &right_page_id);
+    if (unlikely(!s.ok()) || likely(right_page_id.empty())) {
+      return s;
+    }
+  }
+  PageHolder page;
+  auto s = right_page_id.empty()
+               ? GetLeafPage_(opts, property::SortKeysRef(), &page)
+               : opts.buffer_pool->GetPage(right_page_id, &page);
+  // traverse leaf pages through right link
+  while (s.ok()) {
+    s = func(page, &right_page_id);
+    if (unlikely(!s.ok())) {
+      return s;
+    }
+    // page is reached through a stale right link, and its rows might
+    // have been released already.
+    if (unlikely(page->IsMerged())) {
+      return Status::Retry();
+    }
+    if (right_page_id.empty()) {
+      return Status::Ok();
+    }
+    s = opts.buffer_pool->GetPage(right_page_id, &page);
+  }
+  return s;
+}
+
+void VersionedBtree::RangeFilter(const Options &opts, const Filter &filter,
+                                 const BtreeScanOpts &scan_opts,
+                                 RangeScanRowView *views) const noexcept {
+  while (true) {
+    // rows are collected in a temporary view, so that partial result
+    // is discarded when scan is restarted.
+    RangeScanRowView tmp_views;
+    auto s = ForEachLeafPage_(
+        opts, [&](const PageHolder &page, PageIdType *right_page_id) {
+          page->RangeFilter(opts, filter, scan_opts, &tmp_views,
+                            right_page_id);
+          return Status::Ok();
+        });
+    if (unlikely(s.IsRetry())) {
+      continue;
+    }
+    if (unlikely(!s.ok())) {
+      ARCANEDB_ERROR("Failed to scan btree {}, status: {}", GetRootPageKey(),
+                     s.ToString());
+    }
+    for (const auto &row : tmp_views) {
+      views->PushBackRef(row);
+    }
+    for (const auto &owner : tmp_views.GetContainer()) {
+      views->AddOwnerPointer(owner);
+    }
+    return;
+  }
+}
+
+Status VersionedBtree::RangeScan(TxnTs read_ts, const Options &opts,
+                                 RowView *views) const noexcept {
+  while (true) {
+    // rows are collected in a temporary view, so that partial result
+    // is discarded when scan is restarted.
+    RowView tmp_views;
+    auto s = ForEachLeafPage_(
+        opts, [&](const PageHolder &page, PageIdType *right_page_id) {
+          return page->RangeScan(read_ts, opts, &tmp_views, right_page_id);
+        });
+    if (unlikely(s.IsRetry())) {
+      continue;
+    }
+    if (unlikely(!s.ok())) {
+      if (!s.IsRowLocked()) {
+        ARCANEDB_ERROR("Failed to scan btree {}, status: {}",
+                       GetRootPageKey(), s.ToString());
+      }
+      return s;
+    }
+    for (const auto &row : tmp_views) {
+      views->PushBackRef(row);
+    }
+    for (const auto &owner : tmp_views.GetContainer()) {
+      views->AddOwnerPointer(owner);
+    }
+    return Status::Ok();
+  }
+}
+
+RowIterator VersionedBtree::GetRowIterator(const Options &opts) const noexcept {
+  std::vector<std::shared_ptr<VersionedDeltaNode>> delta_chains;
+  while (true) {
+    auto s = ForEachLeafPage_(
+        opts, [&](const PageHolder &page, PageIdType *right_page_id) {
+          delta_chains.push_back(page->GetDeltaChain(right_page_id));
+          return Status::Ok();
+        });
+    if (likely(!s.IsRetry())) {
+      if (unlikely(!s.ok())) {
+        ARCANEDB_ERROR("Failed to scan btree {}, status: {}",
+                       GetRootPageKey(), s.ToString());
+      }
+      return RowIterator(std::move(delta_chains));
     }
-    break;
+    delta_chains.clear();
   }
-  case PageType::InternalPage: {
-    NOTIMPLEMENTED();
-    break;
+}
+
+Status VersionedBtree::CollectGarbage(const Options &opts) noexcept {
+  PageIdType right_page_id;
+  if (root_page_->GetPageType() == PageType::LeafPage) {
+    root_page_->CollectGarbage(opts);
+    // follow the right link instead of GetRightPageId, since page
+    // that has been merged is linked back to its left sibling.
+    root_page_->GetDeltaChain(&right_page_id);
+    if (likely(right_page_id.empty())) {
+      return Status::Ok();
+    }
   }
+  PageHolder page;
+  auto s = right_page_id.empty()
+               ? GetLeafPage_(opts, property::SortKeysRef(), &page)
+               : opts.buffer_pool->GetPage(right_page_id, &page);
+  while (s.ok()) {
+    page->CollectGarbage(opts);
+    page->GetDeltaChain(&right_page_id);
+    if (right_page_id.empty()) {
+      return Status::Ok();
+    }
+    s = opts.buffer_pool->GetPage(right_page_id, &page);
   }
   return s;
 }
 
-void VersionedBtree::SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
-                           const Options &opts, WriteInfo *info) noexcept {
-  auto page_type = root_page_->GetPageType();
-  switch (page_type) {
-  case PageType::LeafPage: {
-    root_page_->SetTs(sort_key, target_ts, opts, info);
-    if (info->is_dirty) {
-      opts.buffer_pool->TryInsertDirtyPage(root_page_);
+Status VersionedBtree::PersistPages_(
+    const Options &opts,
+    std::initializer_list<const PageHolder *> pages) noexcept {
+  for (const auto *page : pages) {
+    auto s = opts.buffer_pool->WritePage(*page);
+    if (unlikely(!s.ok())) {
+      return s;
     }
-    break;
   }
-  case PageType::InternalPage: {
-    NOTIMPLEMENTED();
-    break;
+  return Status::Ok();
+}
+
+Status VersionedBtree::ConvertRootPage_(const Options &opts) noexcept {
+  auto internal_page = std::make_unique<InternalPage>();
+  auto page_id = internal_page->AllocateChildPageId(GetRootPageKey());
+  PageHolder child_page;
+  auto s = opts.buffer_pool->GetPage(page_id, &child_page);
+  if (unlikely(!s.ok())) {
+    return s;
   }
+  {
+    // flusher is blocked until pages are persisted in order.
+    std::lock_guard<bthread::Mutex> root_guard(root_page_->GetFlushLock());
+    std::lock_guard<bthread::Mutex> child_guard(child_page->GetFlushLock());
+    // move rows first, concurrent operations on root page
+    // will follow the link to child page.
+    root_page_->MigrateTo(child_page.Get());
+    std::vector<InternalRow> rows;
+    // empty sort key is the smallest one.
+    rows.push_back(
+        InternalRow{.sort_key = property::SortKeys(std::string_view()),
+                    .page_id = page_id});
+    s = internal_page->Split(opts, property::SortKeysRef(), std::move(rows));
+    if (unlikely(!s.ok())) {
+      return s;
+    }
+    root_page_->ConvertToInternalPage(std::move(internal_page));
+    // child page must hold every row before root page refers to it.
+    s = PersistPages_(opts, {&child_page, &root_page_});
   }
+
+  // pages are flushed again by flusher if they failed to be persisted.
+  child_page->MarkDirty();
+  UpdateDirtyPage_(opts, child_page);
+  root_page_->MarkDirty();
+  UpdateDirtyPage_(opts, root_page_);
+  return s;
 }
 
-Status VersionedBtree::GetRow(property::SortKeysRef sort_key, TxnTs read_ts,
-                              const Options &opts,
-                              RowView *view) const noexcept {
-  auto page_type = root_page_->GetPageType();
-  Status s;
-  switch (page_type) {
-  case PageType::LeafPage: {
-    s = root_page_->GetRow(sort_key, read_ts, opts, view);
-    break;
+Status VersionedBtree::SplitLeafPage(const Options &opts,
+                                     property::SortKeysRef sort_key) noexcept {
+  ArcanedbLockGuard<ArcanedbLock> guard(root_page_->GetSMOLock());
+  if (root_page_->GetPageType() == PageType::LeafPage) {
+    auto s = ConvertRootPage_(opts);
+    if (unlikely(!s.ok())) {
+      return s;
+    }
+  }
+  // all leaf pages are children of root page.
+  // TODO(sheep): split internal page.
+  if (root_page_->GetChildNum() >= opts.max_leaf_page_num) {
+    return Status::NotFound();
+  }
+  // SMO is serialized by smo lock, so internal page is up to date.
+  std::optional<InternalRow> row;
+  auto s = root_page_->GetInternalRow(opts, sort_key, &row);
+  if (unlikely(!s.ok())) {
+    return s;
+  }
+  PageHolder left_page;
+  s = opts.buffer_pool->GetPage(row->page_id, &left_page);
+  if (unlikely(!s.ok())) {
+    return s;
   }
-  case PageType::InternalPage: {
-    s = GetRowMultilevel_(sort_key, read_ts, opts, view);
-    break;
+  auto right_page_id = root_page_->AllocateChildPageId();
+  PageHolder right_page;
+  s = opts.buffer_pool->GetPage(right_page_id, &right_page);
+  if (unlikely(!s.ok())) {
+    return s;
   }
-  default:
-    UNREACHABLE();
+
+  {
+    std::lock_guard<bthread::Mutex> root_guard(root_page_->GetFlushLock());
+    std::lock_guard<bthread::Mutex> left_guard(left_page->GetFlushLock());
+    std::lock_guard<bthread::Mutex> right_guard(right_page->GetFlushLock());
+    property::SortKeys split_key{std::string_view()};
+    s = left_page->SplitTo(right_page.Get(), &split_key);
+    if (!s.ok()) {
+      return s;
+    }
+    std::vector<InternalRow> rows;
+    rows.push_back(*row);
+    rows.push_back(InternalRow{.sort_key = std::move(split_key),
+                               .page_id = std::move(right_page_id)});
+    s = root_page_->Split(opts, row->sort_key.as_ref(), std::move(rows));
+    if (unlikely(!s.ok())) {
+      return s;
+    }
+    // rows moved out of left page are reachable through its right link
+    // until root page refers to right page.
+    s = PersistPages_(opts, {&left_page, &right_page, &root_page_});
   }
+  left_page->ResetSMOWatermark();
+
+  left_page->MarkDirty();
+  UpdateDirtyPage_(opts, left_page);
+  right_page->MarkDirty();
+  UpdateDirtyPage_(opts, right_page);
+  root_page_->MarkDirty();
+  UpdateDirtyPage_(opts, root_page_);
   return s;
 }
 
-Status VersionedBtree::GetRowMultilevel_(property::SortKeysRef sort_key,
-                                         TxnTs read_ts, const Options &opts,
-                                         RowView *view) const noexcept {
-  InternalRowView internal_view;
-  auto s = root_page_->GetPageId(opts, sort_key, &internal_view);
+Status VersionedBtree::MergeLeafPage(const Options &opts,
+                                     property::SortKeysRef sort_key) noexcept {
+  ArcanedbLockGuard<ArcanedbLock> guard(root_page_->GetSMOLock());
+  if (root_page_->GetPageType() == PageType::LeafPage) {
+    return Status::NotFound();
+  }
+  std::optional<InternalRow> left_row;
+  std::optional<InternalRow> right_row;
+  auto s = root_page_->GetSiblingRows(opts, sort_key, &left_row, &right_row);
+  if (!s.ok()) {
+    return s;
+  }
+  PageHolder left_page;
+  s = opts.buffer_pool->GetPage(left_row->page_id, &left_page);
+  if (unlikely(!s.ok())) {
+    return s;
+  }
+  PageHolder right_page;
+  s = opts.buffer_pool->GetPage(right_row->page_id, &right_page);
   if (unlikely(!s.ok())) {
     return s;
   }
-  NOTIMPLEMENTED();
+  // avoid merging pages which will be split again soon.
+  if (opts.page_split_threshold != 0 &&
+      left_page->GetTotalCharge() + right_page->GetTotalCharge() >=
+          opts.page_split_threshold) {
+    return Status::NotFound();
+  }
+
+  {
+    std::lock_guard<bthread::Mutex> root_guard(root_page_->GetFlushLock());
+    std::lock_guard<bthread::Mutex> left_guard(left_page->GetFlushLock());
+    std::lock_guard<bthread::Mutex> right_guard(right_page->GetFlushLock());
+    // merge rows first, concurrent operations on right page
+    // will be redirected to left page.
+    s = left_page->MergeFrom(opts, right_page.Get());
+    if (unlikely(!s.ok())) {
+      return s;
+    }
+    s = root_page_->Merge(opts, right_row->sort_key.as_ref());
+    if (unlikely(!s.ok())) {
+      return s;
+    }
+    // separator is removed first, so that persisted right page is never
+    // reachable together with merged left page. right page is persisted
+    // as a stub at last, rows in it are covered by left page already.
+    s = PersistPages_(opts, {&root_page_, &left_page, &right_page});
+  }
+  left_page->ResetSMOWatermark();
+  // TODO(sheep): remove right stub from page store and buffer pool once
+  // no one could route to it.
+
+  left_page->MarkDirty();
+  UpdateDirtyPage_(opts, left_page);
+  // shrink charge of right stub in buffer pool.
+  right_page->MarkDirty();
+  UpdateDirtyPage_(opts, right_page);
+  root_page_->MarkDirty();
+  UpdateDirtyPage_(opts, root_page_);
+  return s;
 }
 
 } // namespace btree
-} // namespace arcanedb
\ No newline at end of file
+} // namespace arcanedb
@@ -16,6 +16,7 @@
 #include "cache/buffer_pool.h"
 #include "common/btree_scan_opts.h"
 #include "common/filter.h"
+#include <initializer_list>
 
 namespace arcanedb {
 namespace btree {
@@ -66,6 +67,18 @@ public:
   Status GetRow(property::SortKeysRef sort_key, TxnTs read_ts,
                 const Options &opts, RowView *view) const noexcept;
 
+  /**
+   * @brief
+   * Get write ts of the newest version of sort_key, tombstone and intent
+   * included.
+   * @param sort_key
+   * @param opts
+   * @param write_ts
+   * @return Status: NotFound when there is no version of sort_key.
+   */
+  Status GetNewestTs(property::SortKeysRef sort_key, const Options &opts,
+                     TxnTs *write_ts) const noexcept;
+
   /**
    * @brief
    * Set ts of the newest version with "sort_key" to "target_ts"
@@ -73,9 +86,10 @@ public:
    * @param target_ts
    * @param opts
    * @param info
+   * @return Status
    */
-  void SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
-             const Options &opts, WriteInfo *info) noexcept;
+  Status SetTs(property::SortKeysRef sort_key, TxnTs target_ts,
+               const Options &opts, WriteInfo *info) noexcept;
 
   /**
    * @brief
@@ -87,34 +101,175 @@ public:
    */
   void RangeFilter(const Options &opts, const Filter &filter,
                    const BtreeScanOpts &scan_opts,
-                   RangeScanRowView *views) const noexcept {
-    root_page_->RangeFilter(opts, filter, scan_opts, views);
-  }
+                   RangeScanRowView *views) const noexcept;
+
+  /**
+   * @brief
+   * Snapshot range scan over all leaf pages.
+   * @param read_ts
+   * @param opts
+   * @param views rows visible to read_ts, ordered by sort key.
+   * @return Status RowLocked when opts.no_wait_lock is set and a row is
+   * locked by others.
+   */
+  Status RangeScan(TxnTs read_ts, const Options &opts,
+                   RowView *views) const noexcept;
 
   /**
    * @brief
    * Range scan without order
    * @return RowIterator
    */
-  RowIterator GetRowIterator() const noexcept {
-    return root_page_->GetRowIterator();
-  }
+  RowIterator GetRowIterator(const Options &opts) const noexcept;
+
+  /**
+   * @brief
+   * Remove versions that are invisible to readers whose read ts
+   * is not less than opts.gc_watermark from all leaf pages.
+   * @param opts
+   * @return Status
+   */
+  Status CollectGarbage(const Options &opts) noexcept;
 
   std::string_view GetRootPageKey() const noexcept {
     return root_page_->GetPageKey();
   }
 
-  // TODO(sheep): support SMO interface
+  /**
+   * @brief
+   * SMO interface.
+   * Split the leaf page which contains sort_key into two pages,
+   * root page will be converted to internal page if necessary.
+   * Internal page is never split, so btree has at most two levels and
+   * at most opts.max_leaf_page_num leaf pages.
+   * Modified pages are persisted in order before return, so that btree in
+   * page store is consistent at any time.
+   * @param opts
+   * @param sort_key
+   * @return Status: NotFound when there are not enough rows to split,
+   * or btree has reached opts.max_leaf_page_num leaf pages.
+   */
+  Status SplitLeafPage(const Options &opts,
+                       property::SortKeysRef sort_key) noexcept;
+
+  /**
+   * @brief
+   * SMO interface.
+   * Merge the leaf page which contains sort_key with its sibling,
+   * and remove the separator from root page.
+   * Rows deleted before opts.gc_watermark are removed during merge.
+   * Modified pages are persisted in order before return.
+   * @param opts
+   * @param sort_key
+   * @return Status: NotFound when there is no sibling to merge with,
+   * or merged page would exceed opts.page_split_threshold.
+   */
+  Status MergeLeafPage(const Options &opts,
+                       property::SortKeysRef sort_key) noexcept;
 
   common::LockTable &GetLockTable() noexcept {
     return root_page_->GetLockTable();
   }
 
 private:
-  Status GetRowMultilevel_(property::SortKeysRef sort_key, TxnTs read_ts,
-                           const Options &opts, RowView *view) const noexcept;
+  using PageHolder = cache::BufferPool::PageHolder;
+
+  /**
+   * @brief
+   * Find the leaf page which contains sort_key, starting from root page.
+   * @param opts
+   * @param sort_key
+   * @param page
+   * @return Status
+   */
+  Status GetLeafPage_(const Options &opts, property::SortKeysRef sort_key,
+                      PageHolder *page) const noexcept;
+
+  /**
+   * @brief
+   * Perform operation on the leaf page which contains sort_key.
+   * Follow the right link when the row has been moved by concurrent split,
+   * and retry from root page when the page has no link to follow.
+   * @tparam Func Status(const PageHolder &)
+   */
+  template <typename Func>
+  Status LeafOperation_(const Options &opts, property::SortKeysRef sort_key,
+                        const Func &func) const noexcept;
+
+  /**
+   * @brief
+   * Apply func on leaf pages from left to right.
+   * @tparam Func Status(const PageHolder &, PageIdType *right_page_id)
+   * @return Status: Retry when a merged page is reached, scan should be
+   * restarted then.
+   */
+  template <typename Func>
+  Status ForEachLeafPage_(const Options &opts,
+                          const Func &func) const noexcept;
+
+  /**
+   * @brief
+   * Move all rows in root page to a new leaf page,
+   * then convert root page to internal page.
+   * requires smo lock.
+   * @param opts
+   * @return Status
+   */
+  Status ConvertRootPage_(const Options &opts) noexcept;
+
+  void UpdateDirtyPage_(const Options &opts,
+                        const PageHolder &page) const noexcept;
+
+  /**
+   * @brief
+   * Write pages modified by SMO to page store one by one. Pages are
+   * ordered so that persisted btree is consistent after each write, rows
+   * missing from persisted pages are recovered by log replay.
+   * requires flush locks of pages.
+   * @param opts
+   * @param pages
+   * @return Status
+   */
+  Status
+  PersistPages_(const Options &opts,
+                std::initializer_list<const PageHolder *> pages) noexcept;
+
+  /**
+   * @brief
+   * Split leaf page in background when its charge exceeds both
+   * opts.page_split_threshold and its split watermark.
+   * @param opts
+   * @param page leaf page which contains sort_key
+   * @param sort_key
+   */
+  void MaybeTriggerSplit_(const Options &opts, const PageHolder &page,
+                          property::SortKeysRef sort_key) noexcept;
+
+  /**
+   * @brief
+   * Merge leaf page in background when its charge falls below both
+   * opts.page_merge_threshold and its merge watermark.
+   * @param opts
+   * @param page leaf page which contains sort_key
+   * @param sort_key
+   */
+  void MaybeTriggerMerge_(const Options &opts, const PageHolder &page,
+                          property::SortKeysRef sort_key) noexcept;
+
+  /**
+   * @brief
+   * Perform split or merge in background.
+   * At most one background SMO is scheduled for each btree.
+   * SMO watermark of page is updated when it could not be split or merged.
+   * @param opts
+   * @param page leaf page which contains sort_key
+   * @param sort_key
+   * @param is_split
+   */
+  void ScheduleSMO_(const Options &opts, const PageHolder &page,
+                    property::SortKeysRef sort_key, bool is_split) noexcept;
 
-  cache::BufferPool::PageHolder root_page_;
+  PageHolder root_page_;
 };
 
 } // namespace btree
@@ -10,6 +10,7 @@
  */
 
 #include "cache/buffer_pool.h"
+#include "bthread/bthread.h"
 #include "cache/flusher.h"
 #include <cassert>
 
@@ -29,6 +30,10 @@ BufferPool::BufferPool(
 }
 
 BufferPool::~BufferPool() noexcept {
+  // SMO inserts dirty pages into flusher as well.
+  while (inflight_smo_.load(std::memory_order_acquire) != 0) {
+    bthread_usleep(100);
+  }
   if (flusher_) {
     flusher_->Stop();
   }
@@ -78,11 +83,31 @@ void BufferPool::TryInsertDirtyPage(const PageHolder &page_holder) noexcept {
   }
 }
 
+Status BufferPool::WritePage(const PageHolder &page_holder) noexcept {
+  if (!page_store_) {
+    return Status::Ok();
+  }
+  // page is still flushed by flusher afterwards, so flushed lsn is not
+  // updated here.
+  auto binary = page_holder->GetPageSnapshot()->Serialize();
+  page_store::WriteOptions opts;
+  return page_store_->UpdateReplacement(page_holder->GetPageKeyRef(), opts,
+                                        binary);
+}
+
 void BufferPool::ForceFlushAllPages() noexcept {
   if (flusher_) {
     flusher_->ForceFlushAllPages();
   }
 }
 
+log_store::LsnType BufferPool::GetMinFlushedLsn() noexcept {
+  if (flusher_) {
+    return flusher_->GetMinFlushedLsn();
+  }
+  // pages are never persisted.
+  return log_store::kInvalidLsn;
+}
+
 } // namespace cache
 } // namespace arcanedb
\ No newline at end of file
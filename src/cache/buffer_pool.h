@@ -47,6 +47,10 @@ public:
       return handle_holder_.TValue<btree::VersionedBtreePage>();
     }
 
+    btree::VersionedBtreePage *Get() const noexcept {
+      return handle_holder_.TValue<btree::VersionedBtreePage>();
+    }
+
     explicit PageHolder(Cache::HandleHolder handle_holder) noexcept
         : handle_holder_(std::move(handle_holder)) {}
 
@@ -56,7 +60,9 @@ public:
     PageHolder(PageHolder &&) = default;
     PageHolder &operator=(PageHolder &&) = default;
 
-    void UpdateCharge(size_t charge) { handle_holder_.UpdateCharge(charge); }
+    void UpdateCharge(size_t charge) const {
+      handle_holder_.UpdateCharge(charge);
+    }
 
   private:
     Cache::HandleHolder handle_holder_{};
@@ -80,6 +86,36 @@ public:
 
   void ForceFlushAllPages() noexcept;
 
+  /**
+   * @brief
+   * Write page to page store synchronously, used by SMO to persist pages
+   * in order. requires flush lock of page.
+   * @param page_holder
+   * @return Status
+   */
+  Status WritePage(const PageHolder &page_holder) noexcept;
+
+  /**
+   * @brief
+   * Logs before returned lsn could be truncated, since all pages modified
+   * by them have been flushed.
+   * @return log_store::LsnType
+   */
+  log_store::LsnType GetMinFlushedLsn() noexcept;
+
+  /**
+   * @brief
+   * Background SMO refers to buffer pool and holds pages of it, so buffer
+   * pool waits for in-flight SMOs on destruction.
+   */
+  void BeginSMO() noexcept {
+    inflight_smo_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void FinishSMO() noexcept {
+    inflight_smo_.fetch_sub(1, std::memory_order_release);
+  }
+
 private:
   static void PageDeleter(const std::string_view &key, void *value) noexcept {
     delete static_cast<btree::VersionedBtreePage *>(value);
@@ -89,6 +125,7 @@ private:
   std::shared_ptr<page_store::PageStore> page_store_{};
   std::shared_ptr<Flusher> flusher_{};
   util::SingleFlight<Cache::HandleHolder, std::string_view> load_group_;
+  std::atomic<size_t> inflight_smo_{0};
 };
 
 } // namespace cache
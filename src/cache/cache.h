@@ -84,7 +84,7 @@ public:
       return static_cast<T *>(value_);
     }
 
-    inline void UpdateCharge(size_t charge) noexcept {
+    inline void UpdateCharge(size_t charge) const noexcept {
       cache_->UpdateCharge(handle_, charge);
     }
 
@@ -66,19 +66,28 @@ void FlusherShard::LoopWork_() noexcept {
     BufferPool::PageHolder page_holder;
     if (PopDirtyPage(&page_holder)) {
       FlushPage(&page_holder);
+      std::lock_guard<decltype(mu_)> guard(mu_);
+      flushing_lsn_ = log_store::kMaxLsn;
     }
   }
 }
 
 void FlusherShard::FlushPage(BufferPool::PageHolder *page_holder) noexcept {
-  auto snapshot = (*page_holder)->GetPageSnapshot();
-  auto lsn = snapshot->GetLSN();
-  auto binary = snapshot->Serialize();
-  // TODO(yangshijiao): wait for log to be persisted according to WAL protocol.
-  page_store::WriteOptions opts;
-  auto s = page_store_->UpdateReplacement((*page_holder)->GetPageKeyRef(), opts,
-                                          binary);
-  bool need_flush = (*page_holder)->FinishFlush(s, lsn);
+  bool need_flush;
+  {
+    // SMO persists pages under flush lock, snapshot taken before it must
+    // not overwrite the newer one.
+    std::lock_guard<bthread::Mutex> guard((*page_holder)->GetFlushLock());
+    auto snapshot = (*page_holder)->GetPageSnapshot();
+    auto lsn = snapshot->GetLSN();
+    auto binary = snapshot->Serialize();
+    // TODO(yangshijiao): wait for log to be persisted according to WAL
+    // protocol.
+    page_store::WriteOptions opts;
+    auto s = page_store_->UpdateReplacement((*page_holder)->GetPageKeyRef(),
+                                            opts, binary);
+    need_flush = (*page_holder)->FinishFlush(s, lsn);
+  }
   if (need_flush) {
     InsertDirtyPage(std::move(*page_holder));
   }
@@ -94,6 +103,7 @@ bool FlusherShard::PopDirtyPage(BufferPool::PageHolder *page_holder) noexcept {
   }
   *page_holder = std::move(deque_.front());
   deque_.pop_front();
+  flushing_lsn_ = (*page_holder)->GetFlushedLsn();
   return true;
 }
 
@@ -112,10 +122,17 @@ void Flusher::ForceFlushAllPages() noexcept {
 
 void FlusherShard::ForceFlushAllPages() noexcept {
   auto stop_succeed = Stop();
-  std::unique_lock<decltype(mu_)> lock(mu_);
-  while (!deque_.empty()) {
-    auto page_holder = std::move(deque_.front());
-    deque_.pop_front();
+  while (true) {
+    BufferPool::PageHolder page_holder;
+    {
+      std::lock_guard<decltype(mu_)> guard(mu_);
+      if (deque_.empty()) {
+        break;
+      }
+      page_holder = std::move(deque_.front());
+      deque_.pop_front();
+    }
+    // page dirtied during flush is inserted back, mu_ must not be held.
     FlushPage(&page_holder);
   }
   if (stop_succeed) {
@@ -123,5 +140,22 @@ void FlusherShard::ForceFlushAllPages() noexcept {
   }
 }
 
+log_store::LsnType Flusher::GetMinFlushedLsn() noexcept {
+  auto lsn = log_store::kMaxLsn;
+  for (int i = 0; i < shards_.size(); i++) {
+    lsn = std::min(lsn, shards_[i]->GetMinFlushedLsn());
+  }
+  return lsn;
+}
+
+log_store::LsnType FlusherShard::GetMinFlushedLsn() noexcept {
+  std::lock_guard<decltype(mu_)> guard(mu_);
+  auto lsn = flushing_lsn_;
+  for (const auto &page_holder : deque_) {
+    lsn = std::min(lsn, page_holder->GetFlushedLsn());
+  }
+  return lsn;
+}
+
 } // namespace cache
 } // namespace arcanedb
\ No newline at end of file
@@ -33,6 +33,8 @@ public:
 
   void ForceFlushAllPages() noexcept;
 
+  log_store::LsnType GetMinFlushedLsn() noexcept;
+
 private:
   void LoopWork_() noexcept;
 
@@ -41,6 +43,8 @@ private:
   void FlushPage(BufferPool::PageHolder *page_holder) noexcept;
 
   std::deque<BufferPool::PageHolder> deque_;
+  // flushed lsn of the page being flushed by LoopWork_.
+  log_store::LsnType flushing_lsn_{log_store::kMaxLsn}; // guarded by mu_
   bthread::ConditionVariable cv_;
   bthread::Mutex mu_;
 
@@ -68,6 +72,16 @@ public:
 
   void ForceFlushAllPages() noexcept;
 
+  /**
+   * @brief
+   * Minimum flushed lsn among dirty pages, logs before it are not needed
+   * by recovery.
+   * TODO(sheep): logs written by in-flight txns are not applied to pages
+   * yet, caller should bound the result by the lsn of oldest active txn.
+   * @return log_store::LsnType kMaxLsn when there is no dirty page.
+   */
+  log_store::LsnType GetMinFlushedLsn() noexcept;
+
 private:
   std::vector<std::unique_ptr<FlusherShard>> shards_;
 };
@@ -24,9 +24,32 @@ public:
   static constexpr size_t kLogSegmentDefaultNum = 32;
   static constexpr size_t kLogSegmentDefaultSize = 4 << 20;
   static constexpr size_t kLogStoreFlushInterval = 50 * util::MicroSec;
+  // flush interval is doubled up to this when nobody waits for the logs.
+  static constexpr size_t kLogStoreMaxFlushInterval = 1 * util::MillSec;
+  // open segment is sealed immediately once pending bytes or number of
+  // waiters reaches the threshold.
+  static constexpr size_t kLogStoreFlushBytesThreshold = 256 << 10;
+  static constexpr size_t kLogStoreFlushWaiterThreshold = 16;
+  // max number of sealed segments written by one io.
+  static constexpr size_t kLogStoreMaxIoBatch = 8;
+  // log file is rotated once it's larger than this.
+  static constexpr size_t kLogFileDefaultSize = 64 << 20;
 
   static constexpr size_t kBwTreeDeltaChainLength = 16;
   static constexpr size_t kBwTreeCompactionFactor = 2;
+  // chain is consolidated by read heat aware compaction policy once readers
+  // have traversed this many extra deltas since last compaction.
+  static constexpr size_t kBwTreeCompactionReadCostThreshold = 1024;
+  // number of background workers that consolidate delta chains.
+  static constexpr size_t kBwTreeCompactionThreadNum = 4;
+  // leaf page will be split in background once its charge exceeds
+  // this threshold.
+  static constexpr size_t kBwTreePageSplitThreshold = 1 << 20;
+  // underfull leaf page will be merged into its sibling in background.
+  static constexpr size_t kBwTreePageMergeThreshold = 64 << 10;
+  // btree has at most two levels since internal page is never split,
+  // so leaf pages stop splitting once root page has this many children.
+  static constexpr size_t kBtreeMaxLeafPageNum = 4096;
 
   // 8 bit indicates 256 shard
   static constexpr size_t kCacheShardNumBits = 8;
@@ -39,6 +62,22 @@ public:
 
   static constexpr size_t kLockTableShardNum = 64;
 
+  // occ txns wait on begin when there are more active txns than slots.
+  static constexpr size_t kReadTsTrackerSlotNum = 1024;
+
+  // read ts of rw txns is allocated from per worker leases.
+  static constexpr size_t kTsoLeaseShardNum = 64;
+  static constexpr size_t kTsoLeaseSize = 32;
+
+  // block size of arena which holds the read/write set of a txn.
+  static constexpr size_t kArenaBlockSize = 4 << 10;
+
+  // interval of background sweeper which removes stale versions.
+  static constexpr int64_t kVersionSweepInterval = 100 * util::MillSec;
+
+  // occ txn manager refreshes gc watermark once every this many commits.
+  static constexpr size_t kGcWatermarkRefreshInterval = 64;
+
   // txn ts is 4 byte
   // 4 mb link buf
   static constexpr size_t kLinkBufSnapshotManagerSize = 1 << 20;
@@ -11,77 +11,161 @@
 
 #include "common/lock_table.h"
 #include "common/config.h"
+#include "util/monitor.h"
+#include "util/time.h"
 
 namespace arcanedb {
 namespace common {
 
-// TODO(sheep): organize the code to avoid duplication
+Status LockTable::Lock(std::string_view sort_key, TxnId txn_id,
+                       LockType type) noexcept {
+  return Lock_(sort_key, LockRequest{.txn_id = txn_id, .type = type});
+}
+
+Status LockTable::LockFor(std::string_view sort_key, TxnId txn_id,
+                          int64_t timeout_us, LockType type) noexcept {
+  return Lock_(sort_key, LockRequest{.txn_id = txn_id,
+                                     .type = type,
+                                     .timeout_us = timeout_us});
+}
+
+Status LockTable::LockWaitDie(std::string_view sort_key, TxnId txn_id,
+                              TxnTs txn_ts, LockType type) noexcept {
+  return Lock_(sort_key, LockRequest{.txn_id = txn_id,
+                                     .type = type,
+                                     .txn_ts = txn_ts,
+                                     .wait_die = true});
+}
 
-Status LockTable::Lock(std::string_view sort_key, TxnId txn_id) noexcept {
+Status LockTable::Lock_(std::string_view sort_key,
+                        const LockRequest &request) noexcept {
   std::unique_lock<bthread::Mutex> guard(mu_);
-  // try emplace the lock
-  auto [it, lock_succeed] =
-      map_.emplace(std::string(sort_key), std::make_unique<LockEntry>(txn_id));
-  if (lock_succeed) {
+  auto it = map_.find(sort_key);
+  if (it == map_.end()) {
+    auto entry = std::make_unique<LockEntry>();
+    entry->type = request.type;
+    entry->holders.push_back(Holder{request.txn_id, request.txn_ts});
+    map_.emplace(std::string(sort_key), std::move(entry));
     return Status::Ok();
   }
-  LockEntry *lock_entry = it->second.get();
-  // duplicated lock should be handled outside.
-  CHECK(lock_entry->txn_id != txn_id);
-  // add waiter count
-  lock_entry->AddWaiter();
-  // if failed, wait on the cv
-  while (lock_entry->is_locked) {
-    lock_entry->cv.wait(guard);
+  LockEntry *entry = it->second.get();
+  Waiter waiter{request.txn_id, request.type, request.txn_ts, false};
+  if (entry->FindHolder(request.txn_id) != nullptr) {
+    if (entry->type == LockType::WLock || request.type == LockType::RLock) {
+      // already held in a compatible mode.
+      return Status::Ok();
+    }
+    waiter.is_upgrade = true;
+    if (entry->holders.size() == 1) {
+      entry->type = LockType::WLock;
+      return Status::Ok();
+    }
+    // two upgraders would wait for each other forever.
+    for (const auto &other : entry->waiters) {
+      if (other.is_upgrade) {
+        return Status::Abort();
+      }
+    }
+  } else if (entry->waiters.empty() && CanGrant_(*entry, waiter)) {
+    // compatible with holders, and no one is waiting ahead.
+    Grant_(entry, waiter);
+    return Status::Ok();
   }
-  // remove waiter
-  lock_entry->DecWaiter();
-  // suspicious wakeup might reverse the priority.
-  lock_entry->txn_id = txn_id;
-  lock_entry->is_locked = true;
-  return Status::Ok();
+  // upgrader holds the lock already, other waiters couldn't be granted
+  // before it anyway, so it's queued at front.
+  auto waiter_it = waiter.is_upgrade
+                       ? entry->waiters.insert(entry->waiters.begin(), waiter)
+                       : entry->waiters.insert(entry->waiters.end(), waiter);
+  util::Timer timer;
+  Status s;
+  while (true) {
+    if (waiter_it == entry->waiters.begin() && CanGrant_(*entry, *waiter_it)) {
+      Grant_(entry, *waiter_it);
+      s = Status::Ok();
+      break;
+    }
+    // holders might be changed after wakeup, check the priority again.
+    if (request.wait_die && ShouldDie_(*entry, waiter_it)) {
+      s = Status::Abort();
+      break;
+    }
+    if (request.timeout_us < 0) {
+      entry->cv.wait(guard);
+      continue;
+    }
+    auto remain_us = request.timeout_us - timer.GetElapsed();
+    if (remain_us <= 0) {
+      s = Status::Timeout();
+      break;
+    }
+    entry->cv.wait_for(guard, remain_us);
+  }
+  util::Monitor::GetInstance()->RecordLockWaitLatency(timer.GetElapsed());
+  entry->waiters.erase(waiter_it);
+  // waiters behind might be granted now, e.g. shared waiters behind the
+  // granted one, or the ones behind a dead waiter.
+  entry->cv.notify_all();
+  return s;
 }
 
-Status LockTable::LockFor(std::string_view sort_key, TxnId txn_id,
-                          int64_t timeout_us) noexcept {
-  std::unique_lock<bthread::Mutex> guard(mu_);
-  // try emplace the lock
-  auto [it, lock_succeed] =
-      map_.emplace(std::string(sort_key), std::make_unique<LockEntry>(txn_id));
-  if (lock_succeed) {
-    return Status::Ok();
+bool LockTable::CanGrant_(const LockEntry &entry,
+                          const Waiter &waiter) noexcept {
+  if (waiter.is_upgrade) {
+    // upgrader itself is the only holder.
+    return entry.holders.size() == 1;
   }
-  LockEntry *lock_entry = it->second.get();
-  // duplicated lock should be handled outside.
-  CHECK(lock_entry->txn_id != txn_id);
-  // add waiter count
-  lock_entry->AddWaiter();
-  // if failed, wait on the cv
-  // don't handle suspicious wakeup since it will increase code complexity
-  bool timeout = lock_entry->cv.wait_for(guard, timeout_us) == ETIMEDOUT;
-  // remove waiter
-  lock_entry->DecWaiter();
-  // suspicious wakeup might reverse the priority.
-  if (!timeout && !lock_entry->is_locked) {
-    lock_entry->txn_id = txn_id;
-    lock_entry->is_locked = true;
-    return Status::Ok();
+  if (entry.holders.empty()) {
+    return true;
+  }
+  return waiter.type == LockType::RLock && entry.type == LockType::RLock;
+}
+
+bool LockTable::ShouldDie_(const LockEntry &entry,
+                           std::list<Waiter>::const_iterator waiter) noexcept {
+  bool exclusive = waiter->type == LockType::WLock;
+  if (exclusive || entry.type == LockType::WLock) {
+    for (const auto &holder : entry.holders) {
+      if (holder.txn_id != waiter->txn_id &&
+          waiter->txn_ts > holder.txn_ts) {
+        return true;
+      }
+    }
+  }
+  for (auto it = entry.waiters.begin(); it != waiter; ++it) {
+    if ((exclusive || it->type == LockType::WLock) &&
+        waiter->txn_ts > it->txn_ts) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void LockTable::Grant_(LockEntry *entry, const Waiter &waiter) noexcept {
+  if (waiter.is_upgrade) {
+    entry->type = LockType::WLock;
+    return;
+  }
+  if (entry->holders.empty()) {
+    entry->type = waiter.type;
   }
-  return Status::Timeout();
+  entry->holders.push_back(Holder{waiter.txn_id, waiter.txn_ts});
 }
 
 Status LockTable::Unlock(std::string_view sort_key, TxnId txn_id) noexcept {
   std::unique_lock<bthread::Mutex> guard(mu_);
   auto it = map_.find(sort_key);
   CHECK(it != map_.end());
-  CHECK(it->second->txn_id == txn_id);
+  auto entry = it->second.get();
+  auto holder = entry->FindHolder(txn_id);
+  CHECK(holder != nullptr);
   // unlock
-  it->second->is_locked = false;
-  if (it->second->ShouldGC()) {
+  entry->holders.erase(entry->holders.begin() +
+                       (holder - entry->holders.data()));
+  if (entry->ShouldGC()) {
     // no concurrent waiter, erase the lock entry
     map_.erase(it);
   } else {
-    it->second->cv.notify_one();
+    entry->cv.notify_all();
   }
   return Status::Ok();
 }
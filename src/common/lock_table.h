@@ -12,6 +12,7 @@
 #pragma once
 
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/inlined_vector.h"
 #include "bthread/condition_variable.h"
 #include "bthread/mutex.h"
 #include "common/config.h"
@@ -20,6 +21,7 @@
 #include "property/sort_key/sort_key.h"
 #include "txn/txn_type.h"
 #include <limits>
+#include <list>
 
 namespace arcanedb {
 namespace common {
@@ -33,16 +35,23 @@ class LockTable {
 public:
   LockTable() = default;
 
-  // TODO(sheep): implement RwLock.
-
   /**
    * @brief
-   *
+   * Lock requests are granted in FIFO order, so that writers won't be
+   * starved by readers. Shared lock could be upgraded to exclusive lock
+   * by the same txn, upgrade is granted before other waiters.
+   * Requesting a mode that is already covered by the held one succeeds
+   * immediately.
+   * Unlock should be called once for each key no matter how many times
+   * it's locked.
    * @param sort_key
    * @param txn_id
-   * @return Status always be ok
+   * @param type
+   * @return Status Abort when there is another pending upgrade on the key,
+   * which would deadlock, otherwise Ok.
    */
-  Status Lock(std::string_view sort_key, TxnId txn_id) noexcept;
+  Status Lock(std::string_view sort_key, TxnId txn_id,
+              LockType type = LockType::WLock) noexcept;
 
   /**
    * @brief
@@ -50,10 +59,28 @@ public:
    * @param sort_key
    * @param txn_id
    * @param timeout_us
+   * @param type
    * @return Status
    */
-  Status LockFor(std::string_view sort_key, TxnId txn_id,
-                 int64_t timeout_us) noexcept;
+  Status LockFor(std::string_view sort_key, TxnId txn_id, int64_t timeout_us,
+                 LockType type = LockType::WLock) noexcept;
+
+  /**
+   * @brief
+   * Wait-die deadlock prevention. txn_ts is the priority of txn,
+   * smaller ts indicates older txn. Older txn waits for younger holder,
+   * while younger txn dies immediately, so that waits-for graph is always
+   * acyclic and deadlock never happens.
+   * Txn queued ahead of the request is treated as holder as well, since
+   * requests are granted in order.
+   * @param sort_key
+   * @param txn_id
+   * @param txn_ts must be unique among active txns.
+   * @param type
+   * @return Status Ok when lock is acquired, Abort when txn should die.
+   */
+  Status LockWaitDie(std::string_view sort_key, TxnId txn_id, TxnTs txn_ts,
+                     LockType type = LockType::WLock) noexcept;
 
   /**
    * @brief
@@ -65,29 +92,68 @@ public:
   Status Unlock(std::string_view sort_key, TxnId txn_id) noexcept;
 
 private:
+  struct LockRequest {
+    TxnId txn_id;
+    LockType type;
+    // priority of requester, request without priority is treated
+    // as youngest.
+    TxnTs txn_ts{kMaxTxnTs};
+    bool wait_die{false};
+    // negative indicates waiting forever.
+    int64_t timeout_us{-1};
+  };
+
+  struct Holder {
+    TxnId txn_id;
+    TxnTs txn_ts;
+  };
+
+  struct Waiter {
+    TxnId txn_id;
+    LockType type;
+    TxnTs txn_ts;
+    bool is_upgrade;
+  };
+
   struct LockEntry {
-    TxnId txn_id{};
+    // mode of current holders.
+    LockType type{LockType::RLock};
+    absl::InlinedVector<Holder, 1> holders{};
+    // waiters are granted from front to back.
+    std::list<Waiter> waiters{};
     bthread::ConditionVariable cv{};
-    uint8_t ref_cnt{0};
-    bool is_locked{true};
 
-    LockEntry(TxnId id) : txn_id(id) {}
+    bool ShouldGC() const noexcept {
+      return holders.empty() && waiters.empty();
+    }
 
-    void AddWaiter() noexcept {
-      CHECK(ref_cnt < std::numeric_limits<uint8_t>::max());
-      ref_cnt += 1;
+    Holder *FindHolder(TxnId txn_id) noexcept {
+      for (auto &holder : holders) {
+        if (holder.txn_id == txn_id) {
+          return &holder;
+        }
+      }
+      return nullptr;
     }
+  };
 
-    void DecWaiter() noexcept { ref_cnt -= 1; }
+  Status Lock_(std::string_view sort_key, const LockRequest &request) noexcept;
 
-    bool ShouldGC() const noexcept { return ref_cnt == 0; }
-  };
+  // whether waiter could be granted now.
+  static bool CanGrant_(const LockEntry &entry,
+                        const Waiter &waiter) noexcept;
+
+  // wait-die check, waiter dies if it's younger than any holder
+  // or waiter ahead of it that it conflicts with.
+  static bool ShouldDie_(const LockEntry &entry,
+                         std::list<Waiter>::const_iterator waiter) noexcept;
+
+  static void Grant_(LockEntry *entry, const Waiter &waiter) noexcept;
 
   using ContainerType =
       absl::flat_hash_map<std::string, std::unique_ptr<LockEntry>>;
 
   ContainerType map_; // guarded by mu_;
-  // TODO(sheep): monitor the wait latency
   bthread::Mutex mu_;
 };
 
@@ -95,17 +161,23 @@ class ShardedLockTable {
 public:
   explicit ShardedLockTable(size_t shard_num) noexcept : shards_(shard_num) {}
 
-  Status Lock(std::string_view sort_key, TxnId txn_id) noexcept {
-    return GetShard_(sort_key)->Lock(sort_key, txn_id);
+  Status Lock(std::string_view sort_key, TxnId txn_id,
+              LockType type = LockType::WLock) noexcept {
+    return GetShard_(sort_key)->Lock(sort_key, txn_id, type);
   }
 
   Status Unlock(std::string_view sort_key, TxnId txn_id) noexcept {
     return GetShard_(sort_key)->Unlock(sort_key, txn_id);
   }
 
-  Status LockFor(std::string_view sort_key, TxnId txn_id,
-                 int64_t timeout_us) noexcept {
-    return GetShard_(sort_key)->LockFor(sort_key, txn_id, timeout_us);
+  Status LockFor(std::string_view sort_key, TxnId txn_id, int64_t timeout_us,
+                 LockType type = LockType::WLock) noexcept {
+    return GetShard_(sort_key)->LockFor(sort_key, txn_id, timeout_us, type);
+  }
+
+  Status LockWaitDie(std::string_view sort_key, TxnId txn_id, TxnTs txn_ts,
+                     LockType type = LockType::WLock) noexcept {
+    return GetShard_(sort_key)->LockWaitDie(sort_key, txn_id, txn_ts, type);
   }
 
 private:
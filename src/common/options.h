@@ -11,10 +11,14 @@
 
 #pragma once
 
+#include "common/config.h"
 #include "common/type.h"
 #include <optional>
 
 namespace arcanedb {
+namespace btree {
+class CompactionPolicy;
+}
 namespace cache {
 class BufferPool;
 }
@@ -40,8 +44,35 @@ struct Options {
   bool disable_compaction{false};
   bool ignore_lock{false};
   bool force_compaction{false};
+  // consolidate delta chain in background workers instead of writer.
+  // ignored when force_compaction is set.
+  bool background_compaction{true};
   bool check_intent_locked{false};
+  // return RowLocked instead of waiting for rows locked by intents of
+  // other txns, used by validation which would deadlock otherwise.
+  bool no_wait_lock{false};
+  // 2PL read takes exclusive lock instead of shared one, for keys that txn
+  // will write later. upgrading shared lock might abort when another txn
+  // is upgrading as well, while writes are applied in place without undo.
+  bool read_for_update{false};
+  // nullptr indicates default compaction policy is used.
+  // policy is used by background compaction, so it must outlive pages.
+  const btree::CompactionPolicy *compaction_policy{};
   bool sync_commit{false};
+  // occ txn validates its read set on repeat reads and before writing
+  // intents, so that doomed txns abort without paying for intents and logs.
+  bool occ_early_validation{false};
+  // threshold of page charge to trigger leaf page split.
+  // 0 indicates split is disabled.
+  size_t page_split_threshold{common::Config::kBwTreePageSplitThreshold};
+  // threshold of page charge to trigger leaf page merge.
+  // 0 indicates merge is disabled.
+  size_t page_merge_threshold{common::Config::kBwTreePageMergeThreshold};
+  // leaf page is not split once btree has this many leaf pages.
+  size_t max_leaf_page_num{common::Config::kBtreeMaxLeafPageNum};
+  // every active reader has read ts no less than gc_watermark,
+  // so versions overwritten before it could be garbage collected.
+  std::optional<TxnTs> gc_watermark{};
 };
 
 } // namespace arcanedb
\ No newline at end of file
@@ -13,9 +13,11 @@
 #include "cache/buffer_pool.h"
 #include "log_store/posix_log_store/posix_log_store.h"
 #include "page_store/kv_page_store/kv_page_store.h"
+#include "txn/occ_recovery.h"
 #include "txn/txn_manager_occ.h"
 #include <memory>
 #include <string>
+#include <thread>
 
 namespace arcanedb {
 namespace graph {
@@ -94,17 +96,10 @@ Status WeightedGraphDB::Open(const std::string &db_name,
                              const WeightedGraphOptions &opts) noexcept {
   auto res = std::make_unique<WeightedGraphDB>();
   if (opts.enable_wal) {
-    log_store::Options log_opts;
+    log_store::Options log_opts = opts.log_options;
     log_opts.should_sync_file = opts.sync_log;
-    int log_partition_num;
-    if (opts.only_single_edge_txn) {
-      log_partition_num = common::Config::kLogPartitionNum;
-      res->only_single_edge_txn_ = true;
-    } else {
-      log_partition_num = 1;
-      res->only_single_edge_txn_ = false;
-    }
-    for (int i = 0; i < log_partition_num; i++) {
+    res->only_single_edge_txn_ = opts.only_single_edge_txn;
+    for (int i = 0; i < common::Config::kLogPartitionNum; i++) {
       auto s = log_store::PosixLogStore::Open(db_name + "_log_partition" +
                                                   std::to_string(i),
                                               log_opts, &res->log_stores_[i]);
@@ -125,12 +120,47 @@ Status WeightedGraphDB::Open(const std::string &db_name,
   }
 
   res->buffer_pool_ = std::make_unique<cache::BufferPool>(page_store);
-  res->txn_manager_ =
+  auto txn_manager =
       std::make_unique<txn::TxnManagerOCC>(opts.lock_manager_type);
+  if (opts.enable_wal) {
+    auto s = res->Recover_(txn_manager.get());
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  if (opts.enable_version_sweeper) {
+    Options sweeper_opts;
+    sweeper_opts.schema = &kWeightedGraphSchema;
+    sweeper_opts.buffer_pool = res->buffer_pool_.get();
+    res->version_sweeper_ =
+        std::make_unique<txn::VersionSweeper>(txn_manager.get(), sweeper_opts);
+    res->version_sweeper_->Start();
+  }
+  res->txn_manager_ = std::move(txn_manager);
   *db = std::move(res);
   return Status::Ok();
 }
 
+Status WeightedGraphDB::Recover_(txn::TxnManagerOCC *txn_manager) noexcept {
+  // partitions are replayed together, since rows might be written through
+  // multiple partitions.
+  std::vector<std::unique_ptr<log_store::LogReader>> log_readers;
+  std::vector<log_store::LogReader *> readers;
+  for (const auto &log_store : log_stores_) {
+    std::unique_ptr<log_store::LogReader> log_reader;
+    auto s = log_store->GetLogReader(&log_reader);
+    if (!s.ok()) {
+      return s;
+    }
+    readers.push_back(log_reader.get());
+    log_readers.push_back(std::move(log_reader));
+  }
+  txn::OccRecovery recovery(buffer_pool_.get(), std::move(readers));
+  recovery.Recover();
+  txn_manager->RecoverTs(recovery.GetMaxCommitTs());
+  return Status::Ok();
+}
+
 Status WeightedGraphDB::Destroy(const std::string &db_name) noexcept {
   page_store::KvPageStore::Destory(db_name + "_page");
   for (int i = 0; i < common::Config::kLogPartitionNum; i++) {
@@ -153,14 +183,21 @@ Status WeightedGraphDB::Transaction::InsertVertex(VertexId vertex_id,
   }
   auto buffer = writer.Detach();
   property::Row row(buffer.data());
-  s = txn_context_->SetRow(VertexEncoding(vertex_id), row, opts_);
+  auto sub_table_key = VertexEncoding(vertex_id);
+  s = txn_context_->SetRow(sub_table_key, row, opts_);
+  if (s.ok()) {
+    written_sub_tables_.push_back(std::move(sub_table_key));
+  }
   return s;
 }
 
 Status WeightedGraphDB::Transaction::DeleteVertex(VertexId vertex_id) noexcept {
   property::SortKeys sk(vertex_id);
-  auto s =
-      txn_context_->DeleteRow(VertexEncoding(vertex_id), sk.as_ref(), opts_);
+  auto sub_table_key = VertexEncoding(vertex_id);
+  auto s = txn_context_->DeleteRow(sub_table_key, sk.as_ref(), opts_);
+  if (s.ok()) {
+    written_sub_tables_.push_back(std::move(sub_table_key));
+  }
   return s;
 }
 
@@ -176,14 +213,22 @@ Status WeightedGraphDB::Transaction::InsertEdge(VertexId src, VertexId dst,
   }
   auto buffer = writer.Detach();
   property::Row row(buffer.data());
-  s = txn_context_->SetRow(EdgeEncoding(src), row, opts_);
+  auto sub_table_key = EdgeEncoding(src);
+  s = txn_context_->SetRow(sub_table_key, row, opts_);
+  if (s.ok()) {
+    written_sub_tables_.push_back(std::move(sub_table_key));
+  }
   return s;
 }
 
 Status WeightedGraphDB::Transaction::DeleteEdge(VertexId src,
                                                 VertexId dst) noexcept {
   property::SortKeys sk(dst);
-  auto s = txn_context_->DeleteRow(EdgeEncoding(src), sk.as_ref(), opts_);
+  auto sub_table_key = EdgeEncoding(src);
+  auto s = txn_context_->DeleteRow(sub_table_key, sk.as_ref(), opts_);
+  if (s.ok()) {
+    written_sub_tables_.push_back(std::move(sub_table_key));
+  }
   return s;
 }
 
@@ -225,7 +270,15 @@ Status WeightedGraphDB::Transaction::GetEdge(VertexId src, VertexId dst,
 }
 
 Status WeightedGraphDB::Transaction::Commit() noexcept {
-  return txn_context_->CommitOrAbort(opts_);
+  auto s = txn_context_->CommitOrAbort(opts_);
+  if (s.IsCommit() && version_sweeper_ != nullptr) {
+    // versions overwritten by this txn are collected once no reader could
+    // see them, sub table is dropped by sweeper afterwards.
+    for (const auto &sub_table_key : written_sub_tables_) {
+      version_sweeper_->AddSubTable(sub_table_key, GetWriteTs());
+    }
+  }
+  return s;
 }
 
 std::unique_ptr<WeightedGraphDB::Transaction>
@@ -246,12 +299,19 @@ WeightedGraphDB::BeginRwTxn(const Options &opts,
   txn->opts_ = opts;
   txn->opts_.buffer_pool = buffer_pool_.get();
   txn->txn_context_ = txn_manager_->BeginRwTxn(opts);
+  txn->version_sweeper_ = version_sweeper_.get();
+  size_t partition;
   if (only_single_edge_txn_) {
-    txn->opts_.log_store =
-        log_stores_[partition_hint % common::Config::kLogPartitionNum].get();
+    partition = partition_hint % common::Config::kLogPartitionNum;
   } else {
-    txn->opts_.log_store = log_stores_[0].get();
+    // all records of a txn are written to one partition, group commit of
+    // pages appends records to the log store of each request, so a txn is
+    // complete once its commit record is found. rows written by multiple
+    // partitions are ordered by commit ts during recovery.
+    partition = std::hash<std::thread::id>()(std::this_thread::get_id()) %
+                common::Config::kLogPartitionNum;
   }
+  txn->opts_.log_store = log_stores_[partition].get();
   return txn;
 }
 
@@ -13,18 +13,32 @@
 
 #include "cache/buffer_pool.h"
 #include "log_store/log_store.h"
+#include "log_store/options.h"
 #include "txn/txn_context.h"
 #include "txn/txn_manager.h"
+#include "txn/version_sweeper.h"
 
 namespace arcanedb {
+namespace txn {
+class TxnManagerOCC;
+}
+
 namespace graph {
 
 struct WeightedGraphOptions {
   bool enable_wal{false};
   bool enable_flush{false};
   bool sync_log{true};
+  // options of each log partition, should_sync_file is set by sync_log.
+  log_store::Options log_options{};
+  // single edge txns are logged to partition of partition_hint, so that
+  // each log partition could be replayed on its own. otherwise txns are
+  // spread across partitions, and partitions must be recovered together,
+  // see OccRecovery.
   bool only_single_edge_txn{true};
   txn::LockManagerType lock_manager_type{txn::LockManagerType::kCentralized};
+  // sweep stale versions of written vertices and edges in background.
+  bool enable_version_sweeper{true};
 };
 
 /**
@@ -150,6 +164,9 @@ public:
 
     std::unique_ptr<txn::TxnContext> txn_context_;
     Options opts_;
+    // sub tables written by txn are registered to sweeper on commit.
+    txn::VersionSweeper *version_sweeper_{};
+    std::vector<std::string> written_sub_tables_;
   };
 
   static std::string VertexEncoding(VertexId vertex) noexcept {
@@ -166,12 +183,31 @@ public:
   std::unique_ptr<Transaction> BeginRwTxn(const Options &opts,
                                           VertexId partition_hint = 0) noexcept;
 
+  cache::BufferPool *TEST_GetBufferPool() noexcept {
+    return buffer_pool_.get();
+  }
+
+  txn::VersionSweeper *TEST_GetVersionSweeper() noexcept {
+    return version_sweeper_.get();
+  }
+
 private:
+  /**
+   * @brief
+   * Replay log partitions into buffer pool, and make sure txns begin
+   * afterwards acquire greater ts.
+   * @param txn_manager
+   * @return Status
+   */
+  Status Recover_(txn::TxnManagerOCC *txn_manager) noexcept;
+
   std::unique_ptr<txn::TxnManager> txn_manager_;
   std::unique_ptr<cache::BufferPool> buffer_pool_;
   std::array<std::shared_ptr<log_store::LogStore>,
              common::Config::kLogPartitionNum>
       log_stores_;
+  // stopped before txn manager and buffer pool are destroyed.
+  std::unique_ptr<txn::VersionSweeper> version_sweeper_;
   bool only_single_edge_txn_;
 };
 
@@ -27,6 +27,7 @@ namespace log_store {
 using LsnType = uint64_t;
 
 static constexpr LsnType kInvalidLsn = 0;
+static constexpr LsnType kMaxLsn = std::numeric_limits<LsnType>::max();
 
 struct LsnRange {
   LsnType start_lsn;
@@ -40,7 +41,6 @@ public:
   virtual ~LogReader() noexcept {};
 };
 
-// TODO: impl checkpoint & truncate logs
 class LogStore {
 public:
   static constexpr size_t kDefaultLogNum = 1;
@@ -72,6 +72,15 @@ public:
    */
   virtual void WaitForPersist(LsnType lsn) noexcept = 0;
 
+  /**
+   * @brief
+   * Release space of log records before lsn, they won't be read by
+   * log reader anymore. Truncation is performed in unit of log file,
+   * so records before lsn might still be kept.
+   * @param lsn records with end lsn not larger than it are not needed.
+   */
+  virtual void Truncate(LsnType lsn) noexcept = 0;
+
   /**
    * @brief
    * Force background start to flush wal
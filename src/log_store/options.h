@@ -16,10 +16,26 @@
 namespace arcanedb {
 namespace log_store {
 
+enum class CompressionType : uint8_t {
+  kNoCompression = 0,
+  kSnappyCompression = 1,
+};
+
 struct Options {
   size_t segment_num{common::Config::kLogSegmentDefaultNum};
   size_t segment_size{common::Config::kLogSegmentDefaultSize};
   bool should_sync_file{true};
+  // sealed segments are written by single writev and synced together.
+  size_t max_io_batch{common::Config::kLogStoreMaxIoBatch};
+  size_t log_file_size{common::Config::kLogFileDefaultSize};
+  // group commit controller.
+  size_t min_flush_interval{common::Config::kLogStoreFlushInterval};
+  size_t max_flush_interval{common::Config::kLogStoreMaxFlushInterval};
+  size_t flush_bytes_threshold{common::Config::kLogStoreFlushBytesThreshold};
+  size_t flush_waiter_threshold{common::Config::kLogStoreFlushWaiterThreshold};
+  // sealed segments are compressed before written, trading cpu for
+  // log device bandwidth.
+  CompressionType compression{CompressionType::kNoCompression};
 };
 
 } // namespace log_store
@@ -0,0 +1,114 @@
+/**
+ * @file log_block.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-03-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include "butil/third_party/snappy/snappy.h"
+#include "log_store/options.h"
+#include "util/codec/buf_reader.h"
+#include "util/codec/buf_writer.h"
+#include <string>
+#include <string_view>
+
+namespace arcanedb {
+namespace log_store {
+
+/**
+ * @brief
+ * When compression is enabled, each sealed segment is written as a block.
+ * Format:
+ * | type 1byte | raw size 4byte | stored size 4byte | payload varlen |
+ * type indicates how payload is compressed, log records inside the block
+ * are in the same format as uncompressed log.
+ */
+class LogBlock {
+public:
+  static constexpr size_t kHeaderSize = 9;
+
+  /**
+   * @brief
+   * Encode segment data into block. Data is stored uncompressed when
+   * compression doesn't pay off.
+   * @param raw segment data
+   * @param type
+   * @param header output block header, kHeaderSize bytes.
+   * @param buffer holds compressed data.
+   * @return std::string_view payload, points to either raw or buffer.
+   */
+  static std::string_view Encode(std::string_view raw, CompressionType type,
+                                 char *header, std::string *buffer) noexcept {
+    std::string_view payload = raw;
+    if (type == CompressionType::kSnappyCompression) {
+      butil::snappy::Compress(raw.data(), raw.size(), buffer);
+      // keep the compressed one only when it saves 1/8 of bytes.
+      if (buffer->size() < raw.size() - raw.size() / 8) {
+        payload = *buffer;
+      } else {
+        type = CompressionType::kNoCompression;
+      }
+    }
+    util::NonOwnershipBufWriter writer(header, kHeaderSize);
+    writer.WriteBytes(static_cast<uint8_t>(type));
+    writer.WriteBytes(static_cast<uint32_t>(raw.size()));
+    writer.WriteBytes(static_cast<uint32_t>(payload.size()));
+    return payload;
+  }
+
+  static bool DecodeHeader(std::string_view header, CompressionType *type,
+                           uint32_t *raw_size,
+                           uint32_t *stored_size) noexcept {
+    util::BufReader reader(header);
+    uint8_t type_value;
+    if (!reader.ReadBytes(&type_value) || !reader.ReadBytes(raw_size) ||
+        !reader.ReadBytes(stored_size)) {
+      return false;
+    }
+    *type = static_cast<CompressionType>(type_value);
+    return true;
+  }
+
+  /**
+   * @brief
+   * Decode payload back to segment data.
+   * @param type
+   * @param payload
+   * @param raw_size
+   * @param raw
+   * @return false when payload is corrupted.
+   */
+  static bool Decode(CompressionType type, std::string_view payload,
+                     uint32_t raw_size, std::string *raw) noexcept {
+    switch (type) {
+    case CompressionType::kNoCompression: {
+      if (payload.size() != raw_size) {
+        return false;
+      }
+      raw->assign(payload.data(), payload.size());
+      return true;
+    }
+    case CompressionType::kSnappyCompression: {
+      size_t length;
+      if (!butil::snappy::GetUncompressedLength(payload.data(),
+                                                payload.size(), &length) ||
+          length != raw_size) {
+        return false;
+      }
+      raw->resize(raw_size);
+      return butil::snappy::RawUncompress(payload.data(), payload.size(),
+                                          raw->data());
+    }
+    }
+    return false;
+  }
+};
+
+} // namespace log_store
+} // namespace arcanedb
@@ -11,8 +11,10 @@
 
 #pragma once
 
+#include "butil/crc32c.h"
 #include "log_store/log_store.h"
 #include "util/codec/buf_writer.h"
+#include <cstring>
 #include <limits>
 #include <string>
 
@@ -22,7 +24,9 @@ namespace log_store {
 /**
  * @brief
  * Format:
- * | lsn 8byte | data len 2byte | data varlen |
+ * | lsn 8byte | data len 2byte | crc 4byte | data varlen |
+ * crc is the masked crc32c of lsn, data len and data, so that torn or
+ * corrupted record could be detected by recovery.
  */
 class LogRecord {
 public:
@@ -32,12 +36,33 @@ public:
     writer->WriteBytes(static_cast<uint64_t>(lsn_));
     CHECK(data_.size() < std::numeric_limits<uint16_t>::max());
     writer->WriteBytes(static_cast<uint16_t>(data_.size()));
+    writer->WriteBytes(
+        ComputeCrc(lsn_, static_cast<uint16_t>(data_.size()), data_));
     writer->WriteBytes(data_);
   }
 
   size_t GetSerializeSize() noexcept { return kHeaderSize + data_.size(); }
 
-  static constexpr size_t kHeaderSize = 10;
+  /**
+   * @brief
+   * Compute checksum of log record, crc32c is hardware accelerated
+   * when sse4.2 is available.
+   * @param lsn
+   * @param data_size
+   * @param data
+   * @return uint32_t masked crc
+   */
+  static uint32_t ComputeCrc(uint64_t lsn, uint16_t data_size,
+                             std::string_view data) noexcept {
+    char buf[sizeof(lsn) + sizeof(data_size)];
+    memcpy(buf, &lsn, sizeof(lsn));
+    memcpy(buf + sizeof(lsn), &data_size, sizeof(data_size));
+    auto crc = butil::crc32c::Value(buf, sizeof(buf));
+    crc = butil::crc32c::Extend(crc, data.data(), data.size());
+    return butil::crc32c::Mask(crc);
+  }
+
+  static constexpr size_t kHeaderSize = 14;
 
 private:
   LsnType lsn_;
@@ -49,7 +49,6 @@ public:
     size_ = size;
     buffer_.resize(size);
     index_ = index;
-    valid_size_ = 0;
   }
 
   /**
@@ -128,8 +127,6 @@ public:
    * this function should get called by IO thread.
    */
   void FreeSegment() noexcept {
-    // reset buffer
-    valid_size_ = 0;
     // set state to kfree
     CHECK(CasState_(LogSegmentState::kIo, LogSegmentState::kFree));
   }
@@ -183,7 +180,6 @@ public:
         waiter_.NotifyAll();
       }
     }
-    valid_size_ = new_lsn;
     return new_lsn + start_lsn_;
   }
 
@@ -212,8 +208,21 @@ public:
     return IsIo_(control_bits_.load(std::memory_order_acquire));
   }
 
+  /**
+   * @brief
+   * Bytes reserved by writers, only meaningful when segment is open.
+   * @return size_t
+   */
+  size_t GetReservedSize() const noexcept {
+    return GetLsn_(control_bits_.load(std::memory_order_acquire));
+  }
+
   std::string_view GetIoData() noexcept {
-    return std::string_view(buffer_.data(), valid_size_);
+    // lsn in control bits is stable once segment is sealed, and it's
+    // visible to io thread as soon as state becomes kIo.
+    return std::string_view(
+        buffer_.data(),
+        GetLsn_(control_bits_.load(std::memory_order_acquire)));
   }
 
   /**
@@ -316,7 +325,6 @@ private:
   size_t size_{};
   LsnType start_lsn_{};
   std::string buffer_;
-  size_t valid_size_{};
   /**
    * @brief
    * Control bits format:
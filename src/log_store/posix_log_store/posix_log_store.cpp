@@ -21,8 +21,12 @@
 #include "util/codec/buf_writer.h"
 #include "util/monitor.h"
 #include "util/time.h"
+#include <algorithm>
 #include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <cstring>
+#include <fcntl.h>
 #include <memory>
 #include <ratio>
 #include <string>
@@ -36,6 +40,19 @@ Status PosixLogStore::Open(const std::string &name, const Options &options,
   store->env_ = leveldb::Env::Default();
   store->name_ = name;
   store->should_sync_file_ = options.should_sync_file;
+  store->max_io_batch_ = std::max<size_t>(
+      1, std::min<size_t>(options.max_io_batch, options.segment_num));
+  store->min_flush_interval_ = std::max<size_t>(1, options.min_flush_interval);
+  store->max_flush_interval_ =
+      std::max(store->min_flush_interval_, options.max_flush_interval);
+  store->flush_interval_ = store->min_flush_interval_;
+  store->flush_bytes_threshold_ = options.flush_bytes_threshold;
+  store->flush_waiter_threshold_ = options.flush_waiter_threshold;
+  store->compression_ = options.compression;
+  if (store->compression_ != CompressionType::kNoCompression) {
+    store->compress_buffers_.resize(store->max_io_batch_);
+    store->block_headers_.resize(store->max_io_batch_);
+  }
   // create directory
   auto s = store->env_->CreateDir(name);
   if (!s.ok()) {
@@ -43,11 +60,18 @@ Status PosixLogStore::Open(const std::string &name, const Options &options,
     return Status::Err();
   }
 
+  // existing log is kept for recovery, new records follow it.
+  store->max_log_file_size_ = options.log_file_size;
+  LsnType next_lsn = 0;
+  auto status = store->RecoverLogFiles_(&next_lsn);
+  if (!status.ok()) {
+    return status;
+  }
+
   // create log file
-  s = store->env_->NewWritableFile(MakeLogFileName_(name), &store->log_file_);
-  if (!s.ok()) {
-    ARCANEDB_WARN("Failed to create writable file, error: {}", s.ToString());
-    return Status::Err();
+  status = store->OpenLogFile_(next_lsn);
+  if (!status.ok()) {
+    return status;
   }
 
   // initialize log segment
@@ -60,11 +84,11 @@ Status PosixLogStore::Open(const std::string &name, const Options &options,
   // initialize butex
   store->butex_persistent_lsn_ = reinterpret_cast<std::atomic<int32_t> *>(
       bthread::butex_create_checked<int32_t>());
-  *store->butex_persistent_lsn_ = 0;
-  store->persistent_lsn_ = 0;
+  *store->butex_persistent_lsn_ = static_cast<int32_t>(next_lsn);
+  store->persistent_lsn_ = next_lsn;
 
   // set first log segment as open
-  store->GetCurrentLogSegment_()->OpenLogSegment(0);
+  store->GetCurrentLogSegment_()->OpenLogSegment(next_lsn);
 
   // generate mfence here.
   std::atomic_thread_fence(std::memory_order_seq_cst);
@@ -84,7 +108,7 @@ Status PosixLogStore::Destory(const std::string &store_name) noexcept {
     return Status::Ok();
   }
   for (const auto &name : filenames) {
-    if (name != "LOG") {
+    if (name != "LOG" && !IsLogFile_(name)) {
       continue;
     }
     s = env->DeleteFile(store_name + '/' + name);
@@ -140,6 +164,12 @@ void PosixLogStore::AppendLogRecord(const LogRecordContainer &log_records,
             LsnRange{.start_lsn = start_lsn, .end_lsn = current_lsn});
       }
 
+      // wake io thread when this batch crosses the bytes threshold.
+      if (raw_lsn < flush_bytes_threshold_ &&
+          raw_lsn + total_size >= flush_bytes_threshold_) {
+        segment->waiter_.NotifyAll();
+      }
+
       // util::Monitor::GetInstance()->RecordSerializeLogLatency(
       //     serialize_log_timer.GetElapsed());
       // util::Monitor::GetInstance()->RecordLogStoreRetryCntLatency(cnt);
@@ -171,65 +201,282 @@ void ControlGuard::OnExit_() noexcept { segment_->OnWriterExit(); }
 
 void PosixLogStore::ThreadJob_() noexcept {
   size_t current_io_segment = 0;
+  std::vector<LogSegment *> batch;
+  batch.reserve(max_io_batch_);
   while (!stopped_.load(std::memory_order_relaxed)) {
     auto *log_segment = GetLogSegment_(current_io_segment);
     if (log_segment->IsIo()) {
       util::Timer timer;
-      auto start_lsn = log_segment->start_lsn_;
-      auto data = log_segment->GetIoData();
-      if (data.empty()) {
-        ARCANEDB_WARN("Unhealthy data size. segment idx: {}",
-                      log_segment->GetIndex());
-      }
-
-      util::Timer write_page_cache_timer;
-      auto s = log_file_->Append(leveldb::Slice(data.data(), data.size()));
-      util::Monitor::GetInstance()->RecordWritePageCacheLatency(
-          write_page_cache_timer.GetElapsed());
-
-      if (!s.ok()) {
-        FATAL("io failed, status: {}", s.ToString());
+      // segments sealed while last io is in progress are written together,
+      // so that the cost of sync is amortized.
+      CollectIoBatch_(current_io_segment, &batch);
+      auto start_lsn = batch.front()->start_lsn_;
+      size_t data_size = 0;
+      for (auto *segment : batch) {
+        data_size += segment->GetIoData().size();
       }
 
-      util::Timer fsync_timer;
-      if (should_sync_file_) {
-        s = log_file_->Sync();
-      }
-      util::Monitor::GetInstance()->RecordFsyncLatency(
-          fsync_timer.GetElapsed());
+      FlushIoBatch_(batch);
+      util::Monitor::GetInstance()->RecordLogFlushBytesLatency(data_size);
 
-      if (!s.ok()) {
-        FATAL("sync failed, status: {}", s.ToString());
+      for (auto *segment : batch) {
+        segment->FreeSegment();
       }
-      log_segment->FreeSegment();
       // increment index
-      current_io_segment = (current_io_segment + 1) % segment_num_;
+      current_io_segment = (current_io_segment + batch.size()) % segment_num_;
 
-      // update persistent lsn
-      auto next_lsn = GetLogSegment_(current_io_segment)->start_lsn_;
+      // update persistent lsn. next segment might not be opened yet when
+      // all segments are written in one batch, so don't read lsn from it.
+      auto next_lsn = start_lsn + data_size;
       persistent_lsn_.store(next_lsn, std::memory_order_relaxed);
       // update butex
       butex_persistent_lsn_->store(next_lsn);
       // wait up all waiter
       bthread::butex_wake_all(butex_persistent_lsn_);
 
-      if (next_lsn - start_lsn != data.size()) {
-        ARCANEDB_WARN("Logical error might happens. {} {}",
-                      next_lsn - start_lsn, data.size());
+      // rotate log file at segment boundary, so that a record never spans
+      // two files.
+      log_file_size_ += data_size;
+      if (log_file_size_ >= max_log_file_size_) {
+        auto s = OpenLogFile_(next_lsn);
+        if (!s.ok()) {
+          FATAL("Failed to rotate log file, status: {}", s.ToString());
+        }
       }
       util::Monitor::GetInstance()->RecordIoLatencyLatency(timer.GetElapsed());
       continue;
     }
+    // logs accumulated during last io might be enough to seal.
+    if (ShouldSeal_(log_segment, false)) {
+      SealAndOpen(log_segment);
+      continue;
+    }
     // otherwise, we wait
-    log_segment->waiter_.Wait(common::Config::kLogStoreFlushInterval);
+    log_segment->waiter_.Wait(flush_interval_);
     // recheck state
-    if (!log_segment->IsIo()) {
+    if (!log_segment->IsIo() && ShouldSeal_(log_segment, true)) {
       util::Monitor::GetInstance()->RecordSealByIoThreadLatency(1);
       SealAndOpen(log_segment);
     }
   }
 }
 
+bool PosixLogStore::ShouldSeal_(LogSegment *segment, bool waited) noexcept {
+  // segment might be sealed but still has writers, or not opened yet.
+  // both are waken up by segment itself.
+  if (!segment->IsOpen()) {
+    return false;
+  }
+  auto pending = segment->GetReservedSize();
+  auto waiters = persist_waiters_.load(std::memory_order_relaxed);
+  if (pending == 0) {
+    // nothing to seal, we are idle.
+    flush_interval_ = std::min(flush_interval_ * 2, max_flush_interval_);
+    return false;
+  }
+  if (pending >= flush_bytes_threshold_ || waiters >= flush_waiter_threshold_) {
+    // high load, seal as soon as possible to get larger throughput.
+    flush_interval_ = min_flush_interval_;
+    return true;
+  }
+  if (!waited) {
+    // give others a chance to join this group.
+    return false;
+  }
+  if (waiters > 0 || flush_interval_ >= max_flush_interval_) {
+    // someone is waiting, or logs have been delayed too long.
+    flush_interval_ = min_flush_interval_;
+    return true;
+  }
+  // nobody cares about these logs yet, keep accumulating.
+  flush_interval_ = std::min(flush_interval_ * 2, max_flush_interval_);
+  return false;
+}
+
+void PosixLogStore::CollectIoBatch_(size_t start_index,
+                                    std::vector<LogSegment *> *batch) noexcept {
+  batch->clear();
+  for (size_t i = 0; i < max_io_batch_; i++) {
+    auto *segment = GetLogSegment_((start_index + i) % segment_num_);
+    if (!segment->IsIo()) {
+      break;
+    }
+    if (segment->GetIoData().empty()) {
+      ARCANEDB_WARN("Unhealthy data size. segment idx: {}",
+                    segment->GetIndex());
+    }
+    batch->push_back(segment);
+  }
+}
+
+void PosixLogStore::FlushIoBatch_(
+    const std::vector<LogSegment *> &batch) noexcept {
+  std::vector<iovec> iovs;
+  iovs.reserve(batch.size() * 2);
+  for (size_t i = 0; i < batch.size(); i++) {
+    auto data = batch[i]->GetIoData();
+    if (data.empty()) {
+      continue;
+    }
+    if (compression_ != CompressionType::kNoCompression) {
+      auto header = block_headers_[i].data();
+      data = LogBlock::Encode(data, compression_, header,
+                              &compress_buffers_[i]);
+      iovs.push_back(
+          iovec{.iov_base = header, .iov_len = LogBlock::kHeaderSize});
+    }
+    iovs.push_back(iovec{.iov_base = const_cast<char *>(data.data()),
+                         .iov_len = data.size()});
+  }
+
+  util::Timer write_page_cache_timer;
+  size_t iov_idx = 0;
+  while (iov_idx < iovs.size()) {
+    auto written = ::writev(log_fd_, &iovs[iov_idx],
+                            static_cast<int>(iovs.size() - iov_idx));
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      FATAL("io failed, error: {}", strerror(errno));
+    }
+    // handle short write.
+    auto remain = static_cast<size_t>(written);
+    while (iov_idx < iovs.size() && remain >= iovs[iov_idx].iov_len) {
+      remain -= iovs[iov_idx].iov_len;
+      iov_idx += 1;
+    }
+    if (remain > 0) {
+      iovs[iov_idx].iov_base = static_cast<char *>(iovs[iov_idx].iov_base) +
+                               remain;
+      iovs[iov_idx].iov_len -= remain;
+    }
+  }
+  util::Monitor::GetInstance()->RecordWritePageCacheLatency(
+      write_page_cache_timer.GetElapsed());
+
+  util::Timer fsync_timer;
+  // log file is append only, fdatasync is enough to persist the data and
+  // file size.
+  if (should_sync_file_ && ::fdatasync(log_fd_) != 0) {
+    FATAL("sync failed, error: {}", strerror(errno));
+  }
+  util::Monitor::GetInstance()->RecordFsyncLatency(fsync_timer.GetElapsed());
+}
+
+Status PosixLogStore::RecoverLogFiles_(LsnType *next_lsn) noexcept {
+  std::vector<std::string> filenames;
+  auto s = env_->GetChildren(name_, &filenames);
+  if (!s.ok()) {
+    ARCANEDB_WARN("Failed to list dir, error: {}", s.ToString());
+    return Status::Err();
+  }
+  std::vector<LsnType> start_lsns;
+  for (const auto &filename : filenames) {
+    if (IsLogFile_(filename)) {
+      start_lsns.push_back(std::stoull(filename.substr(4)));
+    }
+  }
+  *next_lsn = 0;
+  if (start_lsns.empty()) {
+    return Status::Ok();
+  }
+  std::sort(start_lsns.begin(), start_lsns.end());
+
+  PosixLogReader reader;
+  reader.env_ = env_;
+  reader.compressed_ = compression_ != CompressionType::kNoCompression;
+  for (auto start_lsn : start_lsns) {
+    reader.filenames_.push_back(MakeLogFileName_(name_, start_lsn));
+  }
+  if (reader.OpenNextFile_()) {
+    reader.PeekNext_();
+  }
+  std::string bytes;
+  while (reader.HasNext()) {
+    reader.GetNextLogRecord(&bytes);
+  }
+  if (reader.io_error_) {
+    ARCANEDB_WARN("Failed to read log {}", name_);
+    return Status::Err();
+  }
+
+  // log file is synced before the next one is created, so only the tail
+  // of the last file could be torn by crash. otherwise log is corrupted,
+  // and it's kept as it is.
+  auto last_idx = start_lsns.size() - 1;
+  if (reader.corrupted_) {
+    bool torn = false;
+    s = reader.next_file_idx_ - 1 == last_idx ? reader.IsTornTail_(&torn)
+                                              : leveldb::Status::OK();
+    if (!s.ok()) {
+      ARCANEDB_WARN("Failed to read log {}, status: {}", name_,
+                    s.ToString());
+      return Status::Err();
+    }
+    if (!torn) {
+      ARCANEDB_WARN("Log {} is corrupted in file {}", name_,
+                    reader.filenames_[reader.next_file_idx_ - 1]);
+      return Status::Err();
+    }
+  }
+  size_t valid_offset = 0;
+  if (reader.valid_lsn_ != kMaxLsn && reader.valid_file_idx_ == last_idx) {
+    valid_offset = reader.valid_offset_;
+  }
+  *next_lsn = valid_offset > 0 ? reader.valid_lsn_ : start_lsns.back();
+  // last file without intact record is recreated by OpenLogFile_.
+  if (valid_offset == 0) {
+    s = env_->DeleteFile(reader.filenames_[last_idx]);
+    if (!s.ok()) {
+      ARCANEDB_WARN("Failed to remove file, status: {}", s.ToString());
+      return Status::Err();
+    }
+    start_lsns.pop_back();
+  } else if (reader.corrupted_ &&
+             ::truncate(reader.filenames_[last_idx].c_str(),
+                        static_cast<off_t>(valid_offset)) != 0) {
+    ARCANEDB_WARN("Failed to truncate file, error: {}", strerror(errno));
+    return Status::Err();
+  }
+  std::lock_guard<bthread::Mutex> guard(files_mu_);
+  log_files_.assign(start_lsns.begin(), start_lsns.end());
+  return Status::Ok();
+}
+
+Status PosixLogStore::OpenLogFile_(LsnType start_lsn) noexcept {
+  auto fd = ::open(MakeLogFileName_(name_, start_lsn).c_str(),
+                   O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    ARCANEDB_WARN("Failed to create writable file, error: {}",
+                  strerror(errno));
+    return Status::Err();
+  }
+  // previous file has been synced by io thread.
+  if (log_fd_ >= 0) {
+    ::close(log_fd_);
+  }
+  log_fd_ = fd;
+  log_file_size_ = 0;
+  std::lock_guard<bthread::Mutex> guard(files_mu_);
+  log_files_.push_back(start_lsn);
+  return Status::Ok();
+}
+
+void PosixLogStore::Truncate(LsnType lsn) noexcept {
+  std::lock_guard<bthread::Mutex> guard(files_mu_);
+  // file could be removed once next file starts before lsn.
+  // file being written is never removed.
+  while (log_files_.size() > 1 && log_files_[1] <= lsn) {
+    auto s = env_->DeleteFile(MakeLogFileName_(name_, log_files_.front()));
+    if (!s.ok()) {
+      ARCANEDB_WARN("Failed to remove file, status: {}", s.ToString());
+      return;
+    }
+    log_files_.pop_front();
+  }
+}
+
 bool PosixLogStore::SealAndOpen(LogSegment *log_segment) noexcept {
   // try to seal the segment.
   auto lsn = log_segment->TrySealLogSegment();
@@ -241,27 +488,132 @@ bool PosixLogStore::SealAndOpen(LogSegment *log_segment) noexcept {
   return true;
 }
 
-void PosixLogReader::PeekNext_() noexcept {
-  auto s = file_->Read(LogRecord::kHeaderSize, &header_slice_,
-                       header_buffer_.data());
+bool PosixLogReader::OpenNextFile_() noexcept {
+  if (next_file_idx_ >= filenames_.size()) {
+    return false;
+  }
+  delete file_;
+  file_ = nullptr;
+  block_.clear();
+  block_offset_ = 0;
+  file_offset_ = 0;
+  auto s = env_->NewSequentialFile(filenames_[next_file_idx_++], &file_);
   if (!s.ok()) {
-    ARCANEDB_WARN("Failed to read file, status: {}", s.ToString());
-    has_next_ = false;
-    return;
+    ARCANEDB_WARN("Failed to open file, status: {}", s.ToString());
+    io_error_ = true;
+    return false;
+  }
+  return true;
+}
+
+leveldb::Status PosixLogReader::IsTornTail_(bool *torn) noexcept {
+  *torn = false;
+  std::string buffer(4096, 0);
+  leveldb::Slice slice;
+  do {
+    auto s = file_->Read(buffer.size(), &slice, buffer.data());
+    if (!s.ok()) {
+      return s;
+    }
+    if (std::any_of(slice.data(), slice.data() + slice.size(),
+                    [](char c) { return c != 0; })) {
+      return leveldb::Status::OK();
+    }
+  } while (!slice.empty());
+  *torn = true;
+  return leveldb::Status::OK();
+}
+
+leveldb::Status PosixLogReader::Read_(size_t n, leveldb::Slice *result,
+                                      char *scratch) noexcept {
+  if (!compressed_) {
+    auto s = file_->Read(n, result, scratch);
+    file_offset_ += result->size();
+    return s;
+  }
+  if (block_offset_ == block_.size()) {
+    auto s = LoadBlock_();
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  // log records never span blocks.
+  n = std::min(n, block_.size() - block_offset_);
+  *result = leveldb::Slice(block_.data() + block_offset_, n);
+  block_offset_ += n;
+  return leveldb::Status::OK();
+}
+
+leveldb::Status PosixLogReader::LoadBlock_() noexcept {
+  block_.clear();
+  block_offset_ = 0;
+  char header[LogBlock::kHeaderSize];
+  leveldb::Slice header_slice;
+  auto s = file_->Read(LogBlock::kHeaderSize, &header_slice, header);
+  if (!s.ok() || header_slice.empty()) {
+    return s;
+  }
+  file_offset_ += header_slice.size();
+  CompressionType type;
+  uint32_t raw_size;
+  uint32_t stored_size;
+  if (!LogBlock::DecodeHeader(
+          std::string_view(header_slice.data(), header_slice.size()), &type,
+          &raw_size, &stored_size)) {
+    return leveldb::Status::Corruption("torn log block header");
+  }
+  if (stored_size > stored_buffer_.size()) {
+    stored_buffer_.resize(stored_size);
+  }
+  leveldb::Slice payload;
+  s = file_->Read(stored_size, &payload, stored_buffer_.data());
+  if (!s.ok()) {
+    return s;
+  }
+  file_offset_ += payload.size();
+  if (payload.size() < stored_size) {
+    return leveldb::Status::Corruption("torn log block");
   }
+  if (!LogBlock::Decode(type,
+                        std::string_view(payload.data(), payload.size()),
+                        raw_size, &block_)) {
+    block_.clear();
+    return leveldb::Status::Corruption("corrupted log block");
+  }
+  return leveldb::Status::OK();
+}
+
+void PosixLogReader::PeekNext_() noexcept {
+  leveldb::Status s;
+  do {
+    if (file_ == nullptr) {
+      has_next_ = false;
+      return;
+    }
+    s = Read_(LogRecord::kHeaderSize, &header_slice_, header_buffer_.data());
+    if (!s.ok()) {
+      ARCANEDB_WARN("Failed to read file, status: {}", s.ToString());
+      StopOnError_(s);
+      return;
+    }
+    // reach the end of current file, continue with next one.
+  } while (header_slice_.empty() && OpenNextFile_());
   if (header_slice_.size() < LogRecord::kHeaderSize) {
+    if (!header_slice_.empty()) {
+      ARCANEDB_WARN("Torn log record header detected, size: {}",
+                    header_slice_.size());
+      corrupted_ = true;
+    }
     has_next_ = false;
     return;
   }
   // parse header
   auto reader = util::BufReader(
       std::string_view(header_slice_.data(), header_slice_.size()));
-  if (!reader.ReadBytes(&current_lsn_)) {
-    has_next_ = false;
-    return;
-  }
   // there is no empty log.
-  if (!reader.ReadBytes(&data_size_) || data_size_ == 0) {
+  if (!reader.ReadBytes(&current_lsn_) || !reader.ReadBytes(&data_size_) ||
+      data_size_ == 0 || !reader.ReadBytes(&crc_)) {
+    corrupted_ = true;
     has_next_ = false;
     return;
   }
@@ -269,17 +621,41 @@ void PosixLogReader::PeekNext_() noexcept {
     data_buffer_.resize(data_size_);
   }
   // parse data
-  s = file_->Read(data_size_, &data_slice_, data_buffer_.data());
+  s = Read_(data_size_, &data_slice_, data_buffer_.data());
   if (!s.ok()) {
     ARCANEDB_WARN("Failed to read file, status: {}", s.ToString());
-    has_next_ = false;
+    StopOnError_(s);
     return;
   }
   if (data_slice_.size() < data_size_) {
+    ARCANEDB_WARN("Torn log record detected, lsn: {}", current_lsn_);
+    corrupted_ = true;
+    has_next_ = false;
+    return;
+  }
+  // recovery stops at the first torn or corrupted record.
+  auto data = std::string_view(data_slice_.data(), data_slice_.size());
+  if (LogRecord::ComputeCrc(current_lsn_, data_size_, data) != crc_) {
+    ARCANEDB_WARN("Log record checksum mismatch, lsn: {}", current_lsn_);
+    corrupted_ = true;
     has_next_ = false;
     return;
   }
+  if (next_lsn_ != kMaxLsn && current_lsn_ != next_lsn_) {
+    ARCANEDB_WARN("Log record is not continuous, expect lsn: {}, got: {}",
+                  next_lsn_, current_lsn_);
+    corrupted_ = true;
+    has_next_ = false;
+    return;
+  }
+  next_lsn_ = current_lsn_ + LogRecord::kHeaderSize + data_size_;
   has_next_ = true;
+  // block is intact once all of its records are.
+  if (!compressed_ || block_offset_ == block_.size()) {
+    valid_file_idx_ = next_file_idx_ - 1;
+    valid_offset_ = file_offset_;
+    valid_lsn_ = next_lsn_;
+  }
 }
 
 bool PosixLogReader::HasNext() noexcept { return has_next_; }
@@ -297,9 +673,15 @@ LsnType PosixLogReader::GetNextLogRecord(std::string *bytes) noexcept {
 Status
 PosixLogStore::GetLogReader(std::unique_ptr<LogReader> *log_reader) noexcept {
   auto reader = std::make_unique<PosixLogReader>();
-  auto s = env_->NewSequentialFile(MakeLogFileName_(name_), &reader->file_);
-  if (!s.ok()) {
-    ARCANEDB_WARN("Failed to open file, status: {}", s.ToString());
+  reader->env_ = env_;
+  reader->compressed_ = compression_ != CompressionType::kNoCompression;
+  {
+    std::lock_guard<bthread::Mutex> guard(files_mu_);
+    for (auto start_lsn : log_files_) {
+      reader->filenames_.push_back(MakeLogFileName_(name_, start_lsn));
+    }
+  }
+  if (!reader->OpenNextFile_()) {
     return Status::Err();
   }
   reader->PeekNext_();
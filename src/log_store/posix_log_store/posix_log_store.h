@@ -12,15 +12,22 @@
 #pragma once
 
 #include "bthread/butex.h"
+#include "bthread/mutex.h"
 #include "log_store/log_store.h"
+#include "log_store/posix_log_store/log_block.h"
 #include "log_store/posix_log_store/log_record.h"
 #include "log_store/posix_log_store/log_segment.h"
 #include "util/backoff.h"
 #include "util/simple_waiter.h"
 #include "util/thread_pool.h"
 #include "util/time.h"
+#include <array>
 #include <atomic>
+#include <deque>
 #include <leveldb/env.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <vector>
 
 // TODO(sheep): might still contains bugs
 
@@ -39,18 +46,86 @@ private:
   friend class PosixLogStore;
   void PeekNext_() noexcept;
 
+  /**
+   * @brief
+   * Switch to next log file.
+   * @return false when there is no more log file.
+   */
+  bool OpenNextFile_() noexcept;
+
+  /**
+   * @brief
+   * Read log bytes, blocks are decompressed transparently when log is
+   * compressed.
+   * @param n
+   * @param result
+   * @param scratch
+   * @return leveldb::Status Corruption when block is torn or corrupted.
+   */
+  leveldb::Status Read_(size_t n, leveldb::Slice *result,
+                        char *scratch) noexcept;
+
+  /**
+   * @brief
+   * Load next block of current file.
+   * @return leveldb::Status block_ is empty when reaching end of file.
+   */
+  leveldb::Status LoadBlock_() noexcept;
+
+  void StopOnError_(const leveldb::Status &s) noexcept {
+    // torn or corrupted blocks are reported as corruption.
+    if (s.IsCorruption()) {
+      corrupted_ = true;
+    } else {
+      io_error_ = true;
+    }
+    has_next_ = false;
+  }
+
+  /**
+   * @brief
+   * Whether bytes following the corrupted record are all zero, which
+   * indicates the record is torn by crash instead of being corrupted.
+   * Remaining bytes of current file are consumed.
+   * @param torn
+   * @return leveldb::Status
+   */
+  leveldb::Status IsTornTail_(bool *torn) noexcept;
+
   leveldb::Env *env_;
   leveldb::SequentialFile *file_{nullptr};
+  // log files to read, in lsn order.
+  std::vector<std::string> filenames_;
+  size_t next_file_idx_{0};
   bool has_next_{false};
   // header buffer
-  std::string header_buffer_{LogRecord::kHeaderSize};
+  std::string header_buffer_ = std::string(LogRecord::kHeaderSize, 0);
   leveldb::Slice header_slice_;
   // data parsed from header
   size_t current_lsn_{kInvalidLsn};
   uint16_t data_size_{0};
+  uint32_t crc_{0};
+  // lsn of next record, records should be continuous.
+  LsnType next_lsn_{kMaxLsn};
   // data buffer
   std::string data_buffer_;
   leveldb::Slice data_slice_;
+  // whether log is written in compressed blocks.
+  bool compressed_{false};
+  // decompressed block, log records are read from it.
+  std::string block_;
+  size_t block_offset_{0};
+  std::string stored_buffer_;
+  // bytes consumed from current file.
+  size_t file_offset_{0};
+  // end of the last intact record, or block when compressed. log is
+  // appended from here when store is reopened.
+  size_t valid_file_idx_{0};
+  size_t valid_offset_{0};
+  LsnType valid_lsn_{kMaxLsn};
+  // why reading stops before the end of log.
+  bool io_error_{false};
+  bool corrupted_{false};
 };
 
 /**
@@ -69,7 +144,9 @@ public:
     if (background_thread_ != nullptr) {
       background_thread_->join();
     }
-    delete log_file_;
+    if (log_fd_ >= 0) {
+      ::close(log_fd_);
+    }
     bthread::butex_destroy(butex_persistent_lsn_);
   }
 
@@ -83,14 +160,27 @@ public:
   void WaitForPersist(LsnType lsn) noexcept override {
     int32_t current_lsn =
         butex_persistent_lsn_->load(std::memory_order_relaxed);
+    if (current_lsn >= lsn) {
+      return;
+    }
+    auto waiters = persist_waiters_.fetch_add(1, std::memory_order_relaxed);
+    // first waiter wakes io thread which might be backed off, and
+    // crowded waiters trigger sealing immediately. wakeup is latched so
+    // it's not lost when io thread is about to wait.
+    if (waiters == 0 || waiters + 1 == flush_waiter_threshold_) {
+      GetCurrentLogSegment_()->waiter_.NotifyAll();
+    }
     while (current_lsn < lsn) {
       bthread::butex_wait(butex_persistent_lsn_, current_lsn, nullptr);
       current_lsn = butex_persistent_lsn_->load(std::memory_order_relaxed);
     }
+    persist_waiters_.fetch_sub(1, std::memory_order_relaxed);
   }
 
   Status GetLogReader(std::unique_ptr<LogReader> *log_reader) noexcept override;
 
+  void Truncate(LsnType lsn) noexcept override;
+
 private:
   void StartBackgroundThread_() noexcept {
     background_thread_ =
@@ -99,6 +189,36 @@ private:
 
   void ThreadJob_() noexcept;
 
+  /**
+   * @brief
+   * Group commit controller, decides whether io thread should seal the
+   * open segment. Segment is sealed immediately when pending bytes or
+   * waiters reach the threshold. Otherwise, it's sealed after flush
+   * interval if someone is waiting. When nobody waits, flush interval is
+   * backed off exponentially so that tiny batches are not synced.
+   * @param segment open segment
+   * @param waited whether io thread has waited for flush interval.
+   * @return true when segment should be sealed.
+   */
+  bool ShouldSeal_(LogSegment *segment, bool waited) noexcept;
+
+  /**
+   * @brief
+   * Collect consecutive segments in io state starting from start_index.
+   * @param start_index
+   * @param batch output segments, in lsn order.
+   */
+  void CollectIoBatch_(size_t start_index,
+                       std::vector<LogSegment *> *batch) noexcept;
+
+  /**
+   * @brief
+   * Write segments to log file directly from segment buffers, and sync
+   * them at once.
+   * @param batch
+   */
+  void FlushIoBatch_(const std::vector<LogSegment *> &batch) noexcept;
+
   LogSegment *GetCurrentLogSegment_() noexcept {
     return &segments_[current_log_segment_.load(std::memory_order_relaxed)];
   }
@@ -107,10 +227,40 @@ private:
     return &segments_[index];
   }
 
-  static std::string MakeLogFileName_(const std::string name) noexcept {
-    return name + "/LOG";
+  /**
+   * @brief
+   * Log file is named by lsn of its first record.
+   * @param name
+   * @param start_lsn
+   * @return std::string
+   */
+  static std::string MakeLogFileName_(const std::string &name,
+                                      LsnType start_lsn) noexcept {
+    return name + "/LOG_" + std::to_string(start_lsn);
+  }
+
+  static bool IsLogFile_(const std::string &filename) noexcept {
+    return filename.rfind("LOG_", 0) == 0;
   }
 
+  /**
+   * @brief
+   * Find the end of existing log, torn tail of the last file is cut off
+   * so that new records are appended right after the last intact one.
+   * @param next_lsn lsn of next record.
+   * @return Status: Err when log couldn't be read, or is corrupted before
+   * the tail. Nothing is removed in this case.
+   */
+  Status RecoverLogFiles_(LsnType *next_lsn) noexcept;
+
+  /**
+   * @brief
+   * Create a new log file and switch the writes to it.
+   * @param start_lsn
+   * @return Status
+   */
+  Status OpenLogFile_(LsnType start_lsn) noexcept;
+
   /**
    * @brief
    * Open a new log segment, spin when there is no freed segments.
@@ -145,7 +295,9 @@ private:
   bool SealAndOpen(LogSegment *log_segment) noexcept;
 
   leveldb::Env *env_{nullptr};
-  leveldb::WritableFile *log_file_{nullptr};
+  // log file is written by raw fd, so that segment buffers are handed to
+  // kernel without being copied into user space buffer.
+  int log_fd_{-1};
   std::unique_ptr<LogSegment[]> segments_{nullptr};
   size_t segment_num_{};
   std::atomic_size_t current_log_segment_{0};
@@ -154,6 +306,25 @@ private:
   std::atomic_bool stopped_{false};
   std::atomic<LsnType> persistent_lsn_{0};
   bool should_sync_file_{true};
+  size_t max_io_batch_{};
+  // group commit controller, flush interval is accessed by io thread only.
+  size_t flush_interval_{};
+  size_t min_flush_interval_{};
+  size_t max_flush_interval_{};
+  size_t flush_bytes_threshold_{};
+  int64_t flush_waiter_threshold_{};
+  CompressionType compression_{CompressionType::kNoCompression};
+  // buffers used by io thread to compress segments.
+  std::vector<std::string> compress_buffers_;
+  std::vector<std::array<char, LogBlock::kHeaderSize>> block_headers_;
+  std::atomic<int64_t> persist_waiters_{0};
+  // written by io thread only.
+  size_t log_file_size_{};
+  size_t max_log_file_size_{};
+  // start lsn of log files, in ascending order. the last one is being
+  // written by io thread.
+  std::deque<LsnType> log_files_; // guarded by files_mu_
+  bthread::Mutex files_mu_;
   std::atomic<int32_t> *butex_persistent_lsn_{};
 };
 
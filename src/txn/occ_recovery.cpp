@@ -11,18 +11,30 @@
 
 #include "txn/occ_recovery.h"
 #include "btree/page/versioned_btree_page.h"
+#include "btree/versioned_btree.h"
 #include "cache/buffer_pool.h"
 #include "wal/bwtree_log_reader.h"
 #include "wal/log_type.h"
 #include "wal/occ_log_reader.h"
+#include <algorithm>
+#include <queue>
 
 namespace arcanedb {
 namespace txn {
 
 void OccRecovery::Recover() noexcept {
-  while (log_reader_->HasNext()) {
+  if (log_readers_.size() == 1) {
+    RecoverSequential_(log_readers_[0]);
+    return;
+  }
+  RecoverPartitions_();
+}
+
+void OccRecovery::RecoverSequential_(
+    log_store::LogReader *log_reader) noexcept {
+  while (log_reader->HasNext()) {
     std::string log_record;
-    log_reader_->GetNextLogRecord(&log_record);
+    log_reader->GetNextLogRecord(&log_record);
     std::string_view log_data = log_record;
     auto type = wal::ParseLogRecord(&log_data);
     switch (type) {
@@ -66,6 +78,123 @@ void OccRecovery::Recover() noexcept {
   // note that abort phase could be optimized by using
 }
 
+void OccRecovery::RecoverPartitions_() noexcept {
+  // txns writing the same row are serialized by locks, the later one
+  // acquires commit ts after the commit record of the former one is
+  // appended, so it's greater than every commit ts ahead of that record
+  // in any partition. Merging partitions by the commit ts of their next
+  // commit record replays versions of every row in order, while only
+  // records of txns in flight are buffered.
+  std::vector<Partition> partitions(log_readers_.size());
+  auto greater = [&](size_t lhs, size_t rhs) {
+    return partitions[lhs].commit_ts > partitions[rhs].commit_ts;
+  };
+  std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(
+      greater);
+  for (size_t i = 0; i < partitions.size(); i++) {
+    partitions[i].log_reader = log_readers_[i];
+    if (NextCommittedTxn_(&partitions[i])) {
+      heap.push(i);
+    }
+  }
+  size_t replayed = 0;
+  while (!heap.empty()) {
+    auto idx = heap.top();
+    heap.pop();
+    auto &partition = partitions[idx];
+    auto it = partition.txn_records.find(partition.committed_txn_id);
+    ReplayTxn_(it->second, partition.commit_ts);
+    partition.txn_records.erase(it);
+    max_commit_ts_ = std::max(max_commit_ts_, partition.commit_ts);
+    replayed += 1;
+    if (NextCommittedTxn_(&partition)) {
+      heap.push(idx);
+    }
+  }
+  // txns without commit record are either aborted or failed to commit
+  // before crash, their intents are dropped, and those persisted in pages
+  // are aborted.
+  size_t dropped = 0;
+  for (const auto &partition : partitions) {
+    for (const auto &[txn_id, records] : partition.txn_records) {
+      ReplayTxn_(records, kAbortedTxnTs);
+    }
+    dropped += partition.txn_records.size();
+  }
+  ARCANEDB_INFO("Recover done. replayed txn: {}, dropped txn: {}", replayed,
+                dropped);
+}
+
+bool OccRecovery::NextCommittedTxn_(Partition *partition) noexcept {
+  auto log_reader = partition->log_reader;
+  auto &txn_records = partition->txn_records;
+  while (log_reader->HasNext()) {
+    std::string log_record;
+    log_reader->GetNextLogRecord(&log_record);
+    std::string_view log_data = log_record;
+    auto type = wal::ParseLogRecord(&log_data);
+    switch (type) {
+    case wal::LogType::kBwtreeSetRow: {
+      auto txn_id = wal::DeserializeSetRowLog(log_data).txn_id;
+      txn_records[txn_id].intents.push_back(std::move(log_record));
+      break;
+    }
+    case wal::LogType::kBwtreeDeleteRow: {
+      auto txn_id = wal::DeserializeDeleteRowLog(log_data).txn_id;
+      txn_records[txn_id].intents.push_back(std::move(log_record));
+      break;
+    }
+    case wal::LogType::kOccCommit: {
+      auto log = wal::DeserializeCommitLog(log_data);
+      txn_records[log.txn_id].commit_ts = log.commit_ts;
+      partition->committed_txn_id = log.txn_id;
+      partition->commit_ts = log.commit_ts;
+      return true;
+    }
+    case wal::LogType::kOccAbort: {
+      txn_records.erase(wal::DeserializeAbortLog(log_data).txn_id);
+      break;
+    }
+    case wal::LogType::kBwtreeSetTs: {
+      // intents are replayed with commit ts directly, only the abort
+      // records written for intents that are not installed matter.
+      auto log = wal::DeserializeSetTsLog(log_data);
+      if (log.commit_ts == kAbortedTxnTs) {
+        auto it = txn_records.find(log.txn_id);
+        if (it != txn_records.end()) {
+          DropIntent_(log, &it->second);
+        }
+      }
+      break;
+    }
+    case wal::LogType::kOccBegin: {
+      // intents are replayed with commit ts directly.
+      break;
+    }
+    default:
+      UNREACHABLE();
+    }
+  }
+  return false;
+}
+
+void OccRecovery::DropIntent_(const wal::SetTsLog &log,
+                              TxnRecords *records) noexcept {
+  // the latest intent on the row is aborted.
+  for (auto it = records->intents.rbegin(); it != records->intents.rend();
+       it++) {
+    std::string_view log_data = *it;
+    auto type = wal::ParseLogRecord(&log_data);
+    auto sort_key = type == wal::LogType::kBwtreeSetRow
+                        ? wal::DeserializeSetRowLog(log_data).row.GetSortKeys()
+                        : wal::DeserializeDeleteRowLog(log_data).sort_key;
+    if (sort_key == log.sort_key) {
+      records->intents.erase(std::next(it).base());
+      return;
+    }
+  }
+}
+
 cache::BufferPool::PageHolder
 GetPage_(cache::BufferPool *buffer_pool,
          const std::string_view &page_id) noexcept {
@@ -75,15 +204,77 @@ GetPage_(cache::BufferPool *buffer_pool,
   return page;
 }
 
-// TODO(sheep): recovery should carry the lsn.
+Options MakeReplayOptions_(cache::BufferPool *buffer_pool) noexcept {
+  Options opts;
+  opts.buffer_pool = buffer_pool;
+  // btree is opened from the page where log was written, which is not
+  // necessarily the root page, so SMO must not be triggered by replay.
+  opts.page_split_threshold = 0;
+  opts.page_merge_threshold = 0;
+  return opts;
+}
+
+// page loaded from page store might contain the version already, e.g.
+// page is flushed or persisted by SMO. versions are replayed in commit
+// ts order, so the version is replayed iff the newest version of the row
+// is written by this txn or a later one. intent persisted before the
+// txn is resolved is resolved in place.
+bool IsReplayed_(btree::VersionedBtree &btree,
+                 property::SortKeysRef sort_key, TxnTs locked_ts,
+                 TxnTs target_ts, const Options &opts) noexcept {
+  TxnTs write_ts;
+  auto s = btree.GetNewestTs(sort_key, opts, &write_ts);
+  if (!s.ok()) {
+    return false;
+  }
+  if (write_ts == locked_ts) {
+    btree::WriteInfo info;
+    s = btree.SetTs(sort_key, target_ts, opts, &info);
+    CHECK(s.ok());
+    return true;
+  }
+  return !IsLocked(write_ts) && write_ts >= target_ts;
+}
+
+void OccRecovery::ReplayTxn_(const TxnRecords &records,
+                             TxnTs target_ts) noexcept {
+  auto opts = MakeReplayOptions_(buffer_pool_);
+  for (const auto &log_record : records.intents) {
+    std::string_view log_data = log_record;
+    auto type = wal::ParseLogRecord(&log_data);
+    btree::WriteInfo info;
+    if (type == wal::LogType::kBwtreeSetRow) {
+      auto log = wal::DeserializeSetRowLog(log_data);
+      btree::VersionedBtree btree(GetPage_(buffer_pool_, log.page_id));
+      if (IsReplayed_(btree, log.row.GetSortKeys(), log.write_ts, target_ts,
+                      opts) ||
+          target_ts == kAbortedTxnTs) {
+        continue;
+      }
+      auto s = btree.SetRow(log.row, target_ts, opts, &info);
+      CHECK(s.ok());
+    } else {
+      auto log = wal::DeserializeDeleteRowLog(log_data);
+      btree::VersionedBtree btree(GetPage_(buffer_pool_, log.page_id));
+      if (IsReplayed_(btree, log.sort_key, log.write_ts, target_ts, opts) ||
+          target_ts == kAbortedTxnTs) {
+        continue;
+      }
+      auto s = btree.DeleteRow(log.sort_key, target_ts, opts, &info);
+      CHECK(s.ok());
+    }
+  }
+}
+
 void OccRecovery::BwTreeSetRow_(const std::string_view &data) noexcept {
   auto log = wal::DeserializeSetRowLog(data);
 
-  auto page = GetPage_(buffer_pool_, log.page_id);
+  // page might have been split, route through btree.
+  btree::VersionedBtree btree(GetPage_(buffer_pool_, log.page_id));
 
-  Options opts;
+  auto opts = MakeReplayOptions_(buffer_pool_);
   btree::WriteInfo info;
-  auto s = page->SetRow(log.row, log.write_ts, opts, &info);
+  auto s = btree.SetRow(log.row, log.write_ts, opts, &info);
   CHECK(s.ok());
 
   AddPrepare_(log.txn_id);
@@ -92,11 +283,11 @@ void OccRecovery::BwTreeSetRow_(const std::string_view &data) noexcept {
 void OccRecovery::BwTreeDeleteRow_(const std::string_view &data) noexcept {
   auto log = wal::DeserializeDeleteRowLog(data);
 
-  auto page = GetPage_(buffer_pool_, log.page_id);
+  btree::VersionedBtree btree(GetPage_(buffer_pool_, log.page_id));
 
-  Options opts;
+  auto opts = MakeReplayOptions_(buffer_pool_);
   btree::WriteInfo info;
-  auto s = page->DeleteRow(log.sort_key, log.write_ts, opts, &info);
+  auto s = btree.DeleteRow(log.sort_key, log.write_ts, opts, &info);
   CHECK(s.ok());
 
   AddPrepare_(log.txn_id);
@@ -105,11 +296,12 @@ void OccRecovery::BwTreeDeleteRow_(const std::string_view &data) noexcept {
 void OccRecovery::BwTreeSetTs_(const std::string_view &data) noexcept {
   auto log = wal::DeserializeSetTsLog(data);
 
-  auto page = GetPage_(buffer_pool_, log.page_id);
+  btree::VersionedBtree btree(GetPage_(buffer_pool_, log.page_id));
 
-  Options opts;
+  auto opts = MakeReplayOptions_(buffer_pool_);
   btree::WriteInfo info;
-  page->SetTs(log.sort_key, log.commit_ts, opts, &info);
+  auto s = btree.SetTs(log.sort_key, log.commit_ts, opts, &info);
+  CHECK(s.ok());
 
   AddCommit_(log.txn_id);
 }
@@ -129,6 +321,7 @@ void OccRecovery::OccAbort_(const std::string_view &data) noexcept {
 
 void OccRecovery::OccCommit_(const std::string_view &data) noexcept {
   auto log = wal::DeserializeCommitLog(data);
+  max_commit_ts_ = std::max(max_commit_ts_, log.commit_ts);
   auto it = txn_map_.find(log.txn_id);
   CHECK(it != txn_map_.end());
 }
@@ -13,6 +13,11 @@
 
 #include "cache/buffer_pool.h"
 #include "log_store/log_store.h"
+#include "wal/bwtree_log_reader.h"
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace arcanedb {
 namespace txn {
@@ -21,11 +26,71 @@ class OccRecovery {
 public:
   OccRecovery(cache::BufferPool *buffer_pool,
               log_store::LogReader *log_reader) noexcept
-      : buffer_pool_(buffer_pool), log_reader_(log_reader) {}
+      : buffer_pool_(buffer_pool), log_readers_{log_reader} {}
+
+  /**
+   * @brief
+   * Recover from multiple log partitions. All records of a txn are written
+   * to the log store of the txn, but writes on the same row might be spread
+   * across partitions, so commit ts is used as global order to merge them.
+   * @param buffer_pool
+   * @param log_readers
+   */
+  OccRecovery(cache::BufferPool *buffer_pool,
+              std::vector<log_store::LogReader *> log_readers) noexcept
+      : buffer_pool_(buffer_pool), log_readers_(std::move(log_readers)) {}
 
   void Recover() noexcept;
 
+  /**
+   * @brief
+   * Get the maximum commit ts found in log, txns started after recovery
+   * must acquire greater ts.
+   * @return TxnTs kAbortedTxnTs when no txn is committed.
+   */
+  TxnTs GetMaxCommitTs() const noexcept { return max_commit_ts_; }
+
 private:
+  // replay log records in the order of log.
+  void RecoverSequential_(log_store::LogReader *log_reader) noexcept;
+
+  // replay committed txns from all partitions in the order of commit ts.
+  void RecoverPartitions_() noexcept;
+
+  struct TxnRecords {
+    // set row and delete row records of the txn.
+    std::vector<std::string> intents;
+    std::optional<TxnTs> commit_ts;
+  };
+
+  struct Partition {
+    log_store::LogReader *log_reader;
+    // records of txns whose commit or abort record is not read yet.
+    std::unordered_map<TxnId, TxnRecords> txn_records;
+    // txn of the last commit record read from partition.
+    TxnId committed_txn_id;
+    TxnTs commit_ts;
+  };
+
+  /**
+   * @brief
+   * Read partition until next commit record.
+   * @param partition
+   * @return false when partition is exhausted.
+   */
+  bool NextCommittedTxn_(Partition *partition) noexcept;
+
+  /**
+   * @brief
+   * Resolve intents of txn to target_ts. versions already in pages are
+   * skipped, and the aborted txn only resolves intents persisted in pages.
+   */
+  void ReplayTxn_(const TxnRecords &records, TxnTs target_ts) noexcept;
+
+  // drop the intent aborted by log, i.e. the intent rejected by page
+  // after it's logged.
+  void DropIntent_(const wal::SetTsLog &log, TxnRecords *records) noexcept;
+
   void BwTreeSetRow_(const std::string_view &data) noexcept;
   void BwTreeDeleteRow_(const std::string_view &data) noexcept;
   void BwTreeSetTs_(const std::string_view &data) noexcept;
@@ -37,9 +102,10 @@ private:
   void AddCommit_(TxnId txn_id) noexcept;
 
   cache::BufferPool *buffer_pool_{};
-  log_store::LogReader *log_reader_{};
+  std::vector<log_store::LogReader *> log_readers_;
 
   std::unordered_map<TxnId, uint32_t> txn_map_;
+  TxnTs max_commit_ts_{kAbortedTxnTs};
 };
 
 } // namespace txn
@@ -0,0 +1,135 @@
+/**
+ * @file read_ts_tracker.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include "absl/hash/hash.h"
+#include "bthread/bthread.h"
+#include "common/type.h"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+
+namespace arcanedb {
+namespace txn {
+
+/**
+ * @brief
+ * Track read ts of active txns, which is used to calculate gc watermark.
+ * Each active txn publishes its read ts in a slot, so that beginning
+ * a txn costs a single CAS instead of a lock.
+ * Txn should acquire its read ts inside Register, and whoever calculates
+ * watermark should acquire the bound before calling GetMinReadTs,
+ * so that txns registered concurrently will get a read ts that is
+ * not less than the bound.
+ */
+class ReadTsTracker {
+  static constexpr TxnTs kFreeSlot = std::numeric_limits<TxnTs>::max();
+  // slot is reserved while txn is acquiring its read ts.
+  static constexpr TxnTs kRegistering = kFreeSlot - 1;
+
+  struct alignas(64) Slot {
+    std::atomic<TxnTs> ts{kFreeSlot};
+  };
+
+public:
+  /**
+   * @brief
+   * @param slot_num txns will wait for a free slot when there are more
+   * active txns than slots.
+   */
+  explicit ReadTsTracker(size_t slot_num) noexcept
+      : slot_num_(slot_num), slots_(std::make_unique<Slot[]>(slot_num)) {}
+
+  /**
+   * @brief
+   * Register an active txn.
+   * @param txn_id
+   * @param get_ts called after slot is reserved to acquire read ts.
+   * @return TxnTs read ts of txn
+   */
+  template <typename GetTs>
+  TxnTs Register(TxnId txn_id, GetTs get_ts) noexcept {
+    auto &slot = AcquireSlot_(txn_id);
+    // slot must be visible before ts is acquired, pairs with the fence
+    // in GetMinReadTs.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto ts = get_ts();
+    slot.ts.store(ts, std::memory_order_release);
+    return ts;
+  }
+
+  void Unregister(TxnId txn_id, TxnTs read_ts) noexcept {
+    // slots holding the same ts are interchangeable,
+    // so releasing any of them is fine.
+    auto start = GetSlotIndex_(txn_id);
+    for (size_t i = 0; i < slot_num_; i++) {
+      auto &slot = slots_[(start + i) % slot_num_];
+      auto expected = read_ts;
+      if (slot.ts.compare_exchange_strong(expected, kFreeSlot,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+
+  /**
+   * @brief
+   * Get minimum read ts of active txns.
+   * @param bound returned when there is no smaller read ts.
+   * @return TxnTs
+   */
+  TxnTs GetMinReadTs(TxnTs bound) const noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto min_ts = bound;
+    for (size_t i = 0; i < slot_num_; i++) {
+      auto ts = slots_[i].ts.load(std::memory_order_acquire);
+      // txn might get a read ts less than bound, wait for it.
+      while (ts == kRegistering) {
+        bthread_yield();
+        ts = slots_[i].ts.load(std::memory_order_acquire);
+      }
+      if (ts != kFreeSlot) {
+        min_ts = std::min(min_ts, ts);
+      }
+    }
+    return min_ts;
+  }
+
+private:
+  size_t GetSlotIndex_(TxnId txn_id) const noexcept {
+    return absl::Hash<TxnId>()(txn_id) % slot_num_;
+  }
+
+  Slot &AcquireSlot_(TxnId txn_id) noexcept {
+    auto start = GetSlotIndex_(txn_id);
+    while (true) {
+      for (size_t i = 0; i < slot_num_; i++) {
+        auto &slot = slots_[(start + i) % slot_num_];
+        auto expected = kFreeSlot;
+        if (slot.ts.load(std::memory_order_relaxed) == kFreeSlot &&
+            slot.ts.compare_exchange_strong(expected, kRegistering,
+                                            std::memory_order_relaxed)) {
+          return slot;
+        }
+      }
+      bthread_yield();
+    }
+  }
+
+  const size_t slot_num_;
+  std::unique_ptr<Slot[]> slots_;
+};
+
+} // namespace txn
+} // namespace arcanedb
@@ -16,6 +16,8 @@
 #include "common/status.h"
 #include "common/type.h"
 #include "util/linkbuf.h"
+#include <atomic>
+#include <map>
 #include <optional>
 #include <set>
 
@@ -35,14 +37,31 @@ public:
     ArcanedbLockGuard<ArcanedbLock> guard(mu_);
     ts_set_.insert(ts);
     max_ts_ = std::max(max_ts_, ts);
+    UpdateCache_();
   }
 
   void CommitTs(TxnTs ts) noexcept {
     ArcanedbLockGuard<ArcanedbLock> guard(mu_);
     ts_set_.erase(ts);
+    UpdateCache_();
     // ARCANEDB_INFO("commit ts {}", ts);
   }
 
+  /**
+   * @brief
+   * Lock-free version of GetSnapshotTs, the minimum uncommitted ts and the
+   * maximum ts are published separately, the minimum uncommitted ts is
+   * published first.
+   * @return TxnTs kMaxTxnTs when there is no concurrent txn.
+   */
+  TxnTs GetMinActiveTs() const noexcept {
+    return min_active_ts_.load(std::memory_order_acquire);
+  }
+
+  TxnTs GetMaxTs() const noexcept {
+    return cached_max_ts_.load(std::memory_order_acquire);
+  }
+
   std::pair<bool, TxnTs> GetSnapshotTs() const noexcept {
     ArcanedbLockGuard<ArcanedbLock> guard(mu_);
     // if there is no concurrent txn,
@@ -60,34 +79,43 @@ public:
 
 private:
   // mutable ArcanedbLock mu_{"SnapshotManager"};
+  // require guarded by mu_
+  void UpdateCache_() noexcept {
+    min_active_ts_.store(ts_set_.empty() ? kMaxTxnTs : *ts_set_.begin(),
+                         std::memory_order_release);
+    cached_max_ts_.store(max_ts_, std::memory_order_release);
+  }
+
   mutable ArcanedbLock mu_;
   std::set<TxnTs> ts_set_;
   TxnTs max_ts_{};
+  // read by ShardedSnapshotManager without holding mu_.
+  std::atomic<TxnTs> min_active_ts_{kMaxTxnTs};
+  std::atomic<TxnTs> cached_max_ts_{};
 };
 
 class ShardedSnapshotManager {
 public:
   explicit ShardedSnapshotManager(size_t shard_num) : shards_(shard_num) {}
 
-  void RegisterTs(TxnTs ts) noexcept { GetShard_(ts)->RegisterTs(ts); }
+  void RegisterTs(TxnTs ts) noexcept {
+    GetShard_(ts)->RegisterTs(ts);
+    // bumped after ts is visible in shard, see AdvanceSnapshotTs_.
+    register_seq_.fetch_add(1, std::memory_order_acq_rel);
+  }
 
-  void CommitTs(TxnTs ts) noexcept { GetShard_(ts)->CommitTs(ts); }
+  void CommitTs(TxnTs ts) noexcept {
+    GetShard_(ts)->CommitTs(ts);
+    AdvanceSnapshotTs_();
+  }
 
+  /**
+   * @brief
+   * Get cached snapshot ts, which is advanced by commits.
+   * @return TxnTs
+   */
   TxnTs GetSnapshotTs() const noexcept {
-    // TODO(sheep): cache result
-    TxnTs min_ts = kMaxTxnTs;
-    bool has_concurrent = false;
-    TxnTs max_ts = 0;
-    for (const auto &shard : shards_) {
-      auto [has_concurrent_txn, ts] = shard.GetSnapshotTs();
-      if (has_concurrent_txn) {
-        has_concurrent = true;
-        min_ts = std::min(min_ts, ts);
-      } else {
-        max_ts = std::max(ts, max_ts);
-      }
-    }
-    return has_concurrent ? min_ts : max_ts;
+    return snapshot_ts_.load(std::memory_order_acquire);
   }
 
   void TEST_PrintSnapshotTs() noexcept {
@@ -109,13 +137,58 @@ private:
     return &shards_[absl::Hash<TxnTs>()(ts) % shards_.size()];
   }
 
+  void AdvanceSnapshotTs_() noexcept {
+    // scan shards without lock, readers only read the cached result.
+    // ts registered to a shard after it's scanned is missed, while greater
+    // ts registered afterwards might be found in shards scanned later, so
+    // scan is retried once any ts is registered meanwhile. ts are
+    // registered in order, so the ts missed by a stable scan is greater
+    // than every ts found.
+    TxnTs min_ts;
+    TxnTs max_ts;
+    while (true) {
+      auto register_seq = register_seq_.load(std::memory_order_acquire);
+      min_ts = kMaxTxnTs;
+      max_ts = 0;
+      for (const auto &shard : shards_) {
+        // max ts is published after min active ts, load it first so that
+        // ts found in max ts is found in min active ts as well.
+        max_ts = std::max(max_ts, shard.GetMaxTs());
+        min_ts = std::min(min_ts, shard.GetMinActiveTs());
+      }
+      if (register_seq_.load(std::memory_order_acquire) == register_seq) {
+        break;
+      }
+    }
+    TxnTs snapshot_ts = min_ts == kMaxTxnTs ? max_ts : min_ts - 1;
+    // concurrent committers might observe older states,
+    // only move the snapshot forward.
+    auto current = snapshot_ts_.load(std::memory_order_relaxed);
+    while (current < snapshot_ts &&
+           !snapshot_ts_.compare_exchange_weak(current, snapshot_ts,
+                                               std::memory_order_acq_rel)) {
+    }
+  }
+
   std::vector<SnapshotManager> shards_;
+  std::atomic<TxnTs> snapshot_ts_{};
+  std::atomic<uint64_t> register_seq_{0};
 };
 
+/**
+ * @brief
+ * Track committed ts by link buf, snapshot ts is the tail of link buf.
+ * Committers advance the tail and publish snapshot ts, so that readers
+ * only need to load the cached result, unless the tail lags behind.
+ * Ts that is out of the window of link buf, i.e. a long running txn holds
+ * the tail, is kept in overflow set instead of blocking the committer,
+ * and will be moved into link buf once the tail catches up.
+ */
 class LinkBufSnapshotManager {
 public:
-  LinkBufSnapshotManager() noexcept
-      : link_buf_(common::Config::kLinkBufSnapshotManagerSize) {
+  LinkBufSnapshotManager(
+      size_t capacity = common::Config::kLinkBufSnapshotManagerSize) noexcept
+      : link_buf_(capacity) {
     // valid ts starts from 1.
     // so we add link manually here.
     link_buf_.add_link(0, 1);
@@ -123,16 +196,85 @@ public:
     CHECK(link_buf_.tail() == 1);
   }
 
-  void CommitTs(TxnTs ts) noexcept { link_buf_.add_link(ts, ts + 1); }
+  void CommitTs(TxnTs ts) noexcept { CommitRange(ts, ts + 1); }
+
+  /**
+   * @brief
+   * Commit all ts in [begin, end).
+   * @param begin
+   * @param end
+   */
+  void CommitRange(TxnTs begin, TxnTs end) noexcept {
+    if (likely(link_buf_.has_space(begin))) {
+      link_buf_.add_link(begin, end);
+    } else {
+      ArcanedbLockGuard<ArcanedbLock> guard(overflow_mu_);
+      overflow_.emplace(begin, end);
+      overflow_cnt_.fetch_add(1, std::memory_order_release);
+    }
+    AdvanceTail_();
+  }
 
   TxnTs GetSnapshotTs() noexcept {
-    // TODO(sheep): cache the result
-    link_buf_.advance_tail();
-    return link_buf_.tail() - 1;
+    // committer gives up advancing the tail when it's locked by another
+    // one, which might have missed the link added meanwhile. readers pick
+    // it up so that snapshot won't stay stale until the next commit.
+    if (unlikely(link_buf_.has_link_at_tail())) {
+      AdvanceTail_();
+    }
+    return snapshot_ts_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief
+   * Add link of [begin, end) without advancing the tail, i.e. simulate
+   * the committer racing with others.
+   */
+  void TEST_AddLink(TxnTs begin, TxnTs end) noexcept {
+    link_buf_.add_link(begin, end);
+  }
+
+  size_t TEST_GetOverflowCount() const noexcept {
+    return overflow_cnt_.load(std::memory_order_relaxed);
   }
 
 private:
+  void AdvanceTail_() noexcept {
+    // advance_tail is lock-free and could be called concurrently.
+    // keep advancing since links might be added while the tail is locked.
+    while (link_buf_.advance_tail()) {
+    }
+    if (unlikely(overflow_cnt_.load(std::memory_order_acquire) != 0)) {
+      DrainOverflow_();
+    }
+    auto snapshot_ts = link_buf_.tail() - 1;
+    // only move the snapshot forward, since committers might publish
+    // out of order.
+    auto current = snapshot_ts_.load(std::memory_order_relaxed);
+    while (current < snapshot_ts &&
+           !snapshot_ts_.compare_exchange_weak(current, snapshot_ts,
+                                               std::memory_order_acq_rel)) {
+    }
+  }
+
+  void DrainOverflow_() noexcept {
+    ArcanedbLockGuard<ArcanedbLock> guard(overflow_mu_);
+    while (!overflow_.empty() &&
+           link_buf_.has_space(overflow_.begin()->first)) {
+      auto [begin, end] = *overflow_.begin();
+      overflow_.erase(overflow_.begin());
+      overflow_cnt_.fetch_sub(1, std::memory_order_relaxed);
+      link_buf_.add_link(begin, end);
+      link_buf_.advance_tail();
+    }
+  }
+
   util::Link_buf<TxnTs> link_buf_;
+  std::atomic<TxnTs> snapshot_ts_{};
+  ArcanedbLock overflow_mu_;
+  // begin -> end of committed ranges.
+  std::map<TxnTs, TxnTs> overflow_;
+  std::atomic<size_t> overflow_cnt_{};
 };
 
 } // namespace txn
@@ -11,8 +11,13 @@
 
 #pragma once
 
+#include "absl/base/internal/spinlock.h"
+#include "common/config.h"
 #include "common/type.h"
 #include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
 
 namespace arcanedb {
 namespace txn {
@@ -22,14 +27,64 @@ namespace txn {
  * TSO start from 1.
  */
 class Tso {
+  struct alignas(64) Lease {
+    absl::base_internal::SpinLock lock;
+    TxnTs next{};
+    TxnTs end{};
+  };
+
 public:
+  Tso() noexcept : leases_(common::Config::kTsoLeaseShardNum) {}
+
   TxnTs RequestTs() noexcept {
     return ts_.fetch_add(1, std::memory_order_relaxed);
   }
 
+  /**
+   * @brief
+   * Request ts from the lease of current worker, which is a block of ts
+   * claimed from global counter, so that workers won't contend on it.
+   * Ts is unique, but it's not ordered with ts requested concurrently by
+   * others, ts from RequestTs will be greater than it once it returns.
+   * @param lower_bound returned ts is greater than lower_bound, it should
+   * not be greater than any ts that has been requested, e.g. snapshot ts.
+   * leased ts that are not greater than lower_bound are discarded.
+   * @param on_claim called with [begin, end) when a new block is claimed.
+   * @return TxnTs
+   */
+  template <typename OnClaim>
+  TxnTs RequestLeasedTs(TxnTs lower_bound, OnClaim on_claim) noexcept {
+    auto &lease = leases_[std::hash<std::thread::id>()(
+                              std::this_thread::get_id()) %
+                          leases_.size()];
+    absl::base_internal::SpinLockHolder guard(&lease.lock);
+    if (lease.next <= lower_bound || lease.next >= lease.end) {
+      lease.next = ts_.fetch_add(common::Config::kTsoLeaseSize,
+                                 std::memory_order_relaxed);
+      lease.end = lease.next + common::Config::kTsoLeaseSize;
+      on_claim(lease.next, lease.end);
+    }
+    return lease.next++;
+  }
+
+  /**
+   * @brief
+   * Make sure ts requested later is not less than ts.
+   * @param ts
+   * @return TxnTs the next ts before advancing.
+   */
+  TxnTs AdvanceTo(TxnTs ts) noexcept {
+    auto current = ts_.load(std::memory_order_relaxed);
+    while (current < ts &&
+           !ts_.compare_exchange_weak(current, ts, std::memory_order_relaxed)) {
+    }
+    return current;
+  }
+
 private:
   std::atomic<TxnTs> ts_{1};
+  std::vector<Lease> leases_;
 };
 
 } // namespace txn
-} // namespace arcanedb
\ No newline at end of file
+} // namespace arcanedb
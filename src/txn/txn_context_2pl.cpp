@@ -20,7 +20,8 @@ Status TxnContext2PL::SetRow(const std::string &sub_table_key,
                              const property::Row &row,
                              const Options &opts) noexcept {
   auto sub_table = GetSubTable_(sub_table_key, opts);
-  auto s = AcquireLock_(sub_table_key, row.GetSortKeys().as_slice());
+  auto s = AcquireLock_(sub_table_key, row.GetSortKeys().as_slice(),
+                        common::LockType::WLock);
   if (unlikely(!s.ok())) {
     return s;
   }
@@ -32,7 +33,8 @@ Status TxnContext2PL::DeleteRow(const std::string &sub_table_key,
                                 property::SortKeysRef sort_key,
                                 const Options &opts) noexcept {
   auto sub_table = GetSubTable_(sub_table_key, opts);
-  auto s = AcquireLock_(sub_table_key, sort_key.as_slice());
+  auto s = AcquireLock_(sub_table_key, sort_key.as_slice(),
+                        common::LockType::WLock);
   if (unlikely(!s.ok())) {
     return s;
   }
@@ -46,8 +48,13 @@ Status TxnContext2PL::GetRow(const std::string &sub_table_key,
                              btree::RowView *view) noexcept {
   auto sub_table = GetSubTable_(sub_table_key, opts);
   if (txn_type_ == TxnType::ReadWriteTxn) {
-    // acquire lock
-    auto s = AcquireLock_(sub_table_key, sort_key.as_slice());
+    // key that will be written is locked exclusively up front, since
+    // writes are applied in place without undo, and txn must not abort on
+    // lock upgrade conflict.
+    // TODO(sheep): always use shared lock once undo is supported.
+    auto s = AcquireLock_(sub_table_key, sort_key.as_slice(),
+                          opts.read_for_update ? common::LockType::WLock
+                                               : common::LockType::RLock);
     if (unlikely(!s.ok())) {
       return s;
     }
@@ -56,19 +63,32 @@ Status TxnContext2PL::GetRow(const std::string &sub_table_key,
 }
 
 Status TxnContext2PL::AcquireLock_(const std::string &sub_table_key,
-                                   std::string_view sort_key) noexcept {
+                                   std::string_view sort_key,
+                                   common::LockType type) noexcept {
   // concat the subtable key and sortkey here.
   // user's subtable key and sortkey couldn't contains #
   // since it is used as delimiter here.
   std::string lock_key = sub_table_key;
   lock_key.append("#");
   lock_key.append(sort_key);
-  if (!lock_set_.count(lock_key)) {
-    auto s = lock_table_->Lock(lock_key, txn_id_);
-    lock_set_.insert(std::move(lock_key));
+  auto it = lock_set_.find(lock_key);
+  if (it != lock_set_.end() &&
+      (it->second == common::LockType::WLock ||
+       type == common::LockType::RLock)) {
+    return Status::Ok();
+  }
+  // upgrade returns Abort when another txn is upgrading the same key,
+  // nothing is written to the key then.
+  auto s = lock_table_->Lock(lock_key, txn_id_, type);
+  if (unlikely(!s.ok())) {
     return s;
   }
-  return Status::Ok();
+  if (it != lock_set_.end()) {
+    it->second = type;
+  } else {
+    lock_set_.emplace(std::move(lock_key), type);
+  }
+  return s;
 }
 
 btree::SubTable *TxnContext2PL::GetSubTable_(const std::string &sub_table_key,
@@ -92,7 +112,7 @@ Status TxnContext2PL::CommitOrAbort(const Options &opts) noexcept {
   }
   // TODO(sheep): wait WAL
   // release all lock
-  for (const auto &lock : lock_set_) {
+  for (const auto &[lock, type] : lock_set_) {
     lock_table_->Unlock(lock, txn_id_);
   }
   snapshot_manager_->CommitTs(txn_ts_);
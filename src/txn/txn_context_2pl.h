@@ -61,7 +61,8 @@ public:
 
   /**
    * @brief
-   *
+   * Read write txn takes shared lock for reads, and exclusive lock when
+   * opts.read_for_update is set.
    * @param sub_table_key
    * @param sort_key
    * @param opts
@@ -102,7 +103,8 @@ private:
                                 const Options &opts) noexcept;
 
   Status AcquireLock_(const std::string &sub_table_key,
-                      std::string_view sort_key) noexcept;
+                      std::string_view sort_key,
+                      common::LockType type) noexcept;
 
   TxnId txn_id_;
   /**
@@ -114,7 +116,8 @@ private:
   TxnType txn_type_;
   LinkBufSnapshotManager *snapshot_manager_;
   common::ShardedLockTable *lock_table_;
-  absl::flat_hash_set<std::string> lock_set_;
+  // lock key -> mode held by txn.
+  absl::flat_hash_map<std::string, common::LockType> lock_set_;
   absl::flat_hash_map<std::string_view, std::unique_ptr<btree::SubTable>>
       tables_;
 };
@@ -15,14 +15,24 @@
 #include "btree/write_info.h"
 #include "txn/txn_manager_occ.h"
 #include "txn_type.h"
+#include "util/backoff.h"
 #include "util/monitor.h"
 #include "util/port.h"
 #include "wal/occ_log_writer.h"
+#include <algorithm>
+#include <cstring>
 #include <optional>
+#include <type_traits>
 
 namespace arcanedb {
 namespace txn {
 
+TxnContextOCC::~TxnContextOCC() noexcept {
+  if (txn_manager_ != nullptr) {
+    txn_manager_->FinishTxn(txn_id_, read_ts_);
+  }
+}
+
 Status TxnContextOCC::SetRow(const std::string &sub_table_key,
                              const property::Row &row,
                              const Options &opts) noexcept {
@@ -30,11 +40,18 @@ Status TxnContextOCC::SetRow(const std::string &sub_table_key,
   if (unlikely(!s.ok())) {
     return s;
   }
-  auto owner = std::make_unique<std::string>(row.as_slice());
-  property::Row new_row(owner->data());
   // new write will overwrite old writes
-  write_set_[{sub_table_key, new_row.GetSortKeys()}] = new_row;
-  row_owners_.insert(std::move(owner));
+  auto it = write_set_.find({sub_table_key, row.GetSortKeys()});
+  auto bytes = arena_->CopyString(row.as_slice());
+  property::Row new_row(bytes.data());
+  if (it != write_set_.end()) {
+    it->second = new_row;
+    return Status::Ok();
+  }
+  // sort key of the new row is owned by arena as well.
+  write_set_.emplace(SetKey{arena_->CopyString(sub_table_key),
+                            new_row.GetSortKeys()},
+                     new_row);
   return Status::Ok();
 }
 
@@ -45,9 +62,12 @@ Status TxnContextOCC::DeleteRow(const std::string &sub_table_key,
   if (unlikely(!s.ok())) {
     return s;
   }
-  auto owner = std::make_unique<std::string>(sort_key.as_slice());
-  write_set_[{sub_table_key, property::SortKeysRef(*owner)}] = std::nullopt;
-  row_owners_.insert(std::move(owner));
+  auto it = write_set_.find({sub_table_key, sort_key});
+  if (it != write_set_.end()) {
+    it->second = std::nullopt;
+    return Status::Ok();
+  }
+  write_set_.emplace(MakeSetKey_(sub_table_key, sort_key), std::nullopt);
   return Status::Ok();
 }
 
@@ -76,15 +96,24 @@ Status TxnContextOCC::GetRow(const std::string &sub_table_key,
   // read set will only record the ts we read on real table
   // instead of write cache.
   auto s = sub_table->GetRow(sort_key, read_ts_, opts, view);
-  if (s.IsNotFound()) {
-    // TODO(sheep): check consistency here
-    // should check the consistency with previous read.
-    // and abort early.
-    read_set_[{sub_table_key, sort_key.deref()}] = std::nullopt;
+  // remember the read ts
+  std::optional<TxnTs> read_ts;
+  if (!s.IsNotFound()) {
+    read_ts = view->at(0).GetTs();
+  }
+  auto read_it = read_set_.find({sub_table_key, sort_key});
+  if (read_it != read_set_.end()) {
+    if (opts.occ_early_validation && read_it->second != read_ts) {
+      // read is not repeatable, validation will fail anyway.
+      ARCANEDB_INFO("Txn id: {} read ts: {}, Repeat read validation failed.",
+                    txn_id_, read_ts_);
+      doomed_ = true;
+      return Status::Abort();
+    }
+    read_it->second = read_ts;
     return s;
   }
-  // remember the read ts
-  read_set_[{sub_table_key, sort_key.deref()}] = view->at(0).GetTs();
+  read_set_.emplace(MakeSetKey_(sub_table_key, sort_key), read_ts);
   return s;
 }
 
@@ -93,12 +122,84 @@ void TxnContextOCC::RangeFilter(const std::string &sub_table_key,
                                 const BtreeScanOpts &scan_opts,
                                 btree::RangeScanRowView *rows_view) noexcept {
   if (txn_type_ != TxnType::ReadOnlyTxn) {
-    UNREACHABLE();
+    RangeFilterRw_(sub_table_key, opts, filter, scan_opts, rows_view);
+    return;
   }
   auto sub_table = GetSubTable_(sub_table_key, opts);
   sub_table->RangeFilter(opts, filter, scan_opts, rows_view);
 }
 
+void TxnContextOCC::RangeFilterRw_(
+    const std::string &sub_table_key, const Options &opts,
+    const Filter &filter, const BtreeScanOpts &scan_opts,
+    btree::RangeScanRowView *rows_view) noexcept {
+  // whole sub table is scanned and validated, bounded filter must be
+  // recorded in scan set so that phantoms outside of it are ignored.
+  static_assert(std::is_empty_v<Filter>,
+                "Filter is not supported by read write txn");
+  // scanned rows are unique by sort key, so scan_opts.remove_duplicate
+  // holds already.
+  auto sub_table = GetSubTable_(sub_table_key, opts);
+  btree::RowView view;
+  auto s = sub_table->RangeScan(read_ts_, opts, &view);
+  if (unlikely(!s.ok())) {
+    // partial scan couldn't be validated.
+    ARCANEDB_INFO("Txn id: {} read ts: {}, Failed to scan {}", txn_id_,
+                  read_ts_, s.ToString());
+    doomed_ = true;
+    return;
+  }
+  // remember the scan
+  ScanSetEntry entry{arena_->CopyString(sub_table_key), scanned_rows_.size(),
+                     0};
+  for (const auto &row : view) {
+    scanned_rows_.emplace_back(
+        property::SortKeysRef(
+            arena_->CopyString(row.GetSortKeys().as_slice())),
+        row.GetTs());
+  }
+  entry.end = scanned_rows_.size();
+  scan_set_.push_back(entry);
+
+  // merge own writes, both sides are ordered by sort key.
+  using WriteRef =
+      std::pair<property::SortKeysRef, const std::optional<property::Row> *>;
+  std::vector<WriteRef> writes;
+  for (const auto &[k, v] : write_set_) {
+    if (k.first == sub_table_key) {
+      writes.emplace_back(k.second, &v);
+    }
+  }
+  std::sort(writes.begin(), writes.end(),
+            [](const WriteRef &lhs, const WriteRef &rhs) {
+              return lhs.first < rhs.first;
+            });
+  rows_view->reserve(view.size() + writes.size());
+  auto row_it = view.begin();
+  auto write_it = writes.begin();
+  while (row_it != view.end() || write_it != writes.end()) {
+    if (write_it == writes.end() ||
+        (row_it != view.end() && row_it->GetSortKeys() < write_it->first)) {
+      rows_view->PushBackRef(btree::RowRef(*row_it));
+      ++row_it;
+      continue;
+    }
+    if (row_it != view.end() && row_it->GetSortKeys() == write_it->first) {
+      // shadowed by own write
+      ++row_it;
+    }
+    // TODO(sheep): amend interface here.
+    // row is passed out without ownership
+    if (write_it->second->has_value()) {
+      rows_view->PushBackRef(btree::RowRef(write_it->second->value()));
+    }
+    ++write_it;
+  }
+  for (const auto &owner : view.GetContainer()) {
+    rows_view->AddOwnerPointer(owner);
+  }
+}
+
 btree::RowIterator
 TxnContextOCC::GetRowIterator(const std::string &sub_table_key,
                               const Options &opts) noexcept {
@@ -106,7 +207,7 @@ TxnContextOCC::GetRowIterator(const std::string &sub_table_key,
     UNREACHABLE();
   }
   auto sub_table = GetSubTable_(sub_table_key, opts);
-  return sub_table->GetRowIterator();
+  return sub_table->GetRowIterator(opts);
 }
 
 Status TxnContextOCC::CommitOrAbort(const Options &opts) noexcept {
@@ -118,10 +219,22 @@ Status TxnContextOCC::CommitOrAbort(const Options &opts) noexcept {
       lock_manager_type_ == LockManagerType::kInlined;
   commit_opts.owner_ts = read_ts_;
   commit_opts.txn_id = txn_id_;
+  if (!commit_opts.gc_watermark.has_value()) {
+    // compaction triggered by intents could collect stale versions.
+    commit_opts.gc_watermark = txn_manager_->GetGcWatermark();
+  }
+
+  auto defer = absl::MakeCleanup([&]() { ReleaseLock_(commit_opts); });
+  if (doomed_ || (commit_opts.occ_early_validation &&
+                  !PreValidateRead_(commit_opts))) {
+    // nothing is written yet, neither intents nor logs.
+    ARCANEDB_INFO("Txn id: {} read ts: {}, Txn is aborted before commit.",
+                  txn_id_, read_ts_);
+    return Status::Abort();
+  }
 
   Begin_(commit_opts.log_store);
 
-  auto defer = absl::MakeCleanup([&]() { ReleaseLock_(commit_opts); });
   // commit protocol:
   // 1. write all intents
   // 2. acquire commit ts
@@ -143,6 +256,8 @@ Status TxnContextOCC::CommitOrAbort(const Options &opts) noexcept {
     // write abort log
     Abort_(commit_opts.log_store);
     AbortIntents_(commit_opts);
+    // release commit ts, otherwise snapshot ts will be stuck.
+    txn_manager_->Commit(this);
     return Status::Abort();
   }
 
@@ -178,24 +293,26 @@ void TxnContextOCC::WaitForCommit_(log_store::LogStore *log_store) noexcept {
       timer.GetElapsed());
 }
 
-void TxnContextOCC::UndoWriteIntents_(
-    const std::vector<std::pair<std::string_view, property::SortKeysRef>>
-        &undo_list,
-    const Options &opts) noexcept {
+void TxnContextOCC::UndoWriteIntents_(size_t written_cnt,
+                                      const Options &opts) noexcept {
   // abort the intents.
   // don't need to remember lsn since aborted txn don't need to reply to user
   btree::WriteInfo info;
   // write abort log
   Abort_(opts.log_store);
-  for (const auto &entry : undo_list) {
-    auto sub_table = GetSubTable_(entry.first, opts);
-    sub_table->SetTs(entry.second, kAbortedTxnTs, opts, &info);
+  // iteration order of write set is stable since it's not modified.
+  for (const auto &[k, v] : write_set_) {
+    if (written_cnt-- == 0) {
+      break;
+    }
+    auto sub_table = GetSubTable_(k.first, opts);
+    SetTs_(sub_table, k.second, kAbortedTxnTs, opts, &info);
   }
 }
 
 Status TxnContextOCC::WriteIntents_(const Options &opts) noexcept {
   // iterate write sets
-  std::vector<std::pair<std::string_view, property::SortKeysRef>> undo_list;
+  size_t written_cnt = 0;
   for (const auto &[k, v] : write_set_) {
     btree::WriteInfo info;
     auto sub_table = GetSubTable_(k.first, opts);
@@ -209,36 +326,94 @@ Status TxnContextOCC::WriteIntents_(const Options &opts) noexcept {
     lsn_ = std::max(lsn_, info.lsn);
 
     if (!s.ok()) {
-      UndoWriteIntents_(undo_list, opts);
+      UndoWriteIntents_(written_cnt, opts);
       return s;
     }
-    undo_list.push_back({k.first, k.second});
+    written_cnt++;
   }
   return Status::Ok();
 }
 
 bool TxnContextOCC::ValidateRead_(const Options &opts) noexcept {
+  // intents of others are written already, waiting for them would
+  // deadlock with txns that are validating our intents.
+  Options validate_opts = opts;
+  validate_opts.no_wait_lock = true;
   for (const auto &[k, v] : read_set_) {
     // since read set will only record the ts we read on real table
     // instead of write cache.
     // so we can only skip the intent that is written by ourself.
-    auto sub_table = GetSubTable_(k.first, opts);
+    if (!CheckReadVersion_(k, v, commit_ts_, validate_opts)) {
+      return false;
+    }
+  }
+  return ValidateScan_(commit_ts_, validate_opts);
+}
+
+bool TxnContextOCC::ValidateScan_(TxnTs read_ts,
+                                  const Options &opts) noexcept {
+  for (const auto &entry : scan_set_) {
+    auto sub_table = GetSubTable_(entry.sub_table_key, opts);
     btree::RowView view;
-    auto s = sub_table->GetRow(k.second.as_ref(), commit_ts_, opts, &view);
-    if (v.has_value()) {
-      if (!s.ok()) {
-        ARCANEDB_INFO("Expect value, get {}", s.ok());
-        return false;
-      }
-      if (view.at(0).GetTs() != v.value()) {
-        ARCANEDB_INFO("Expect ts {}, get {}", v.value(), view.at(0).GetTs());
-        return false;
-      }
-    } else {
-      if (!s.IsNotFound()) {
-        ARCANEDB_INFO("Expect not found, get {}", s.ok());
+    auto s = sub_table->RangeScan(read_ts, opts, &view);
+    if (!s.ok()) {
+      ARCANEDB_INFO("Failed to validate scan {}", s.ToString());
+      return false;
+    }
+    if (view.size() != entry.end - entry.begin) {
+      ARCANEDB_INFO("Expect {} rows in scan, get {}", entry.end - entry.begin,
+                    view.size());
+      return false;
+    }
+    auto expected = scanned_rows_.begin() + entry.begin;
+    for (const auto &row : view) {
+      if (row.GetSortKeys() != expected->first ||
+          row.GetTs() != expected->second) {
+        ARCANEDB_INFO("Expect ts {} in scan, get {}", expected->second,
+                      row.GetTs());
         return false;
       }
+      ++expected;
+    }
+  }
+  return true;
+}
+
+bool TxnContextOCC::PreValidateRead_(const Options &opts) noexcept {
+  // commit ts is not acquired yet, but it will be greater than all
+  // committed versions, so the newest committed version is checked.
+  // intents are skipped since we don't know whether they will commit.
+  Options read_opts = opts;
+  read_opts.ignore_lock = true;
+  for (const auto &[k, v] : read_set_) {
+    if (!CheckReadVersion_(k, v, kMaxTxnTs, read_opts)) {
+      return false;
+    }
+  }
+  return ValidateScan_(kMaxTxnTs, read_opts);
+}
+
+bool TxnContextOCC::CheckReadVersion_(const SetKey &key,
+                                      std::optional<TxnTs> expected_ts,
+                                      TxnTs read_ts,
+                                      const Options &opts) noexcept {
+  auto sub_table = GetSubTable_(key.first, opts);
+  btree::RowView view;
+  auto s = sub_table->GetRow(key.second, read_ts, opts, &view);
+  if (expected_ts.has_value()) {
+    if (!s.ok()) {
+      ARCANEDB_INFO("Expect value, get {}", s.ok());
+      return false;
+    }
+    if (view.at(0).GetTs() != expected_ts.value()) {
+      ARCANEDB_INFO("Expect ts {}, get {}", expected_ts.value(),
+                    view.at(0).GetTs());
+      return false;
+    }
+  } else {
+    if (!s.IsNotFound()) {
+      ARCANEDB_INFO("Expect not found, get {}", s.ok());
+      return false;
     }
   }
   return true;
@@ -248,7 +423,7 @@ void TxnContextOCC::CommitIntents_(const Options &opts) noexcept {
   for (const auto &[k, v] : write_set_) {
     btree::WriteInfo info;
     auto sub_table = GetSubTable_(k.first, opts);
-    sub_table->SetTs(k.second, commit_ts_, opts, &info);
+    SetTs_(sub_table, k.second, commit_ts_, opts, &info);
     lsn_ = std::max(lsn_, info.lsn);
   }
 }
@@ -258,7 +433,23 @@ void TxnContextOCC::AbortIntents_(const Options &opts) noexcept {
   btree::WriteInfo info;
   for (const auto &[k, v] : write_set_) {
     auto sub_table = GetSubTable_(k.first, opts);
-    sub_table->SetTs(k.second, kAbortedTxnTs, opts, &info);
+    SetTs_(sub_table, k.second, kAbortedTxnTs, opts, &info);
+  }
+}
+
+void TxnContextOCC::SetTs_(btree::SubTable *sub_table,
+                           property::SortKeysRef sort_key, TxnTs target_ts,
+                           const Options &opts,
+                           btree::WriteInfo *info) noexcept {
+  util::BackOff bo;
+  while (true) {
+    auto s = sub_table->SetTs(sort_key, target_ts, opts, info);
+    if (likely(s.ok())) {
+      return;
+    }
+    ARCANEDB_WARN("Failed to set ts of intent, txn: {}, status: {}", txn_id_,
+                  s.ToString());
+    bo.Sleep(20 * util::MicroSec, 10 * util::MillSec);
   }
 }
 
@@ -299,21 +490,26 @@ Status TxnContextOCC::AcquireLock_(const std::string &sub_table_key,
   // concat the subtable key and sortkey here.
   // user's subtable key and sortkey couldn't contains #
   // since it is used as delimiter here.
-  std::string lock_key = sub_table_key;
-  lock_key.append("#");
-  lock_key.append(sort_key);
+  // lock key is built in arena directly, bytes are wasted
+  // if lock is already held, which should be rare.
+  size_t lock_key_size = sub_table_key.size() + 1 + sort_key.size();
+  auto buf = static_cast<char *>(arena_->Allocate(lock_key_size, 1));
+  memcpy(buf, sub_table_key.data(), sub_table_key.size());
+  buf[sub_table_key.size()] = '#';
+  memcpy(buf + sub_table_key.size() + 1, sort_key.data(), sort_key.size());
+  std::string_view lock_key(buf, lock_key_size);
   if (!lock_set_.count(lock_key)) {
+    // wait-die by read ts, so that deadlock is resolved immediately
+    // instead of hanging.
     Status s;
     switch (lock_manager_type_) {
     case LockManagerType::kCentralized: {
-      s = lock_table_->Lock(lock_key, txn_id_);
-      lock_set_.insert(std::move(lock_key));
+      s = lock_table_->LockWaitDie(lock_key, txn_id_, read_ts_);
       break;
     }
     case LockManagerType::kDecentralized: {
       auto sub_table = GetSubTable_(sub_table_key, opts);
-      s = sub_table->GetLockTable().Lock(lock_key, txn_id_);
-      lock_set_.insert(std::move(lock_key));
+      s = sub_table->GetLockTable().LockWaitDie(lock_key, txn_id_, read_ts_);
       break;
     }
     case LockManagerType::kInlined: {
@@ -322,6 +518,12 @@ Status TxnContextOCC::AcquireLock_(const std::string &sub_table_key,
     default:
       UNREACHABLE();
     }
+    if (s.ok()) {
+      lock_set_.insert(lock_key);
+    } else {
+      // writes are buffered, so txn could be aborted cleanly.
+      doomed_ = true;
+    }
     return s;
   }
   return Status::Ok();
@@ -14,6 +14,7 @@
 #include "btree/sub_table.h"
 #include "common/lock_table.h"
 #include "txn/txn_context.h"
+#include "util/arena.h"
 
 namespace arcanedb {
 namespace txn {
@@ -32,9 +33,18 @@ public:
                 LockManagerType lock_manager_type) noexcept
       : txn_id_(txn_id), read_ts_(txn_ts), txn_type_(txn_type),
         lock_table_(lock_table), txn_manager_(txn_manager),
+        arena_(util::GetPooledArena()),
+        lock_set_(0, LockSet::hasher(), LockSet::key_equal(),
+                  LockSet::allocator_type(arena_.get())),
+        write_set_(0, SetKeyHash(), std::equal_to<SetKey>(),
+                   decltype(write_set_)::allocator_type(arena_.get())),
+        read_set_(0, SetKeyHash(), std::equal_to<SetKey>(),
+                  decltype(read_set_)::allocator_type(arena_.get())),
+        scan_set_(decltype(scan_set_)::allocator_type(arena_.get())),
+        scanned_rows_(decltype(scanned_rows_)::allocator_type(arena_.get())),
         lock_manager_type_(lock_manager_type) {}
 
-  ~TxnContextOCC() noexcept override = default;
+  ~TxnContextOCC() noexcept override;
 
   /**
    * @brief
@@ -104,10 +114,33 @@ private:
 
   bool ValidateRead_(const Options &opts) noexcept;
 
+  /**
+   * @brief
+   * Validate read set against newest committed versions before writing
+   * intents. Failure indicates ValidateRead_ will fail as well.
+   * @param opts
+   * @return true when read set might still be valid.
+   */
+  bool PreValidateRead_(const Options &opts) noexcept;
+
   void CommitIntents_(const Options &opts) noexcept;
 
   void AbortIntents_(const Options &opts) noexcept;
 
+  /**
+   * @brief
+   * Set ts of intent, retry until succeed since intent left behind would
+   * block the row forever.
+   * @param sub_table
+   * @param sort_key
+   * @param target_ts
+   * @param opts
+   * @param info
+   */
+  void SetTs_(btree::SubTable *sub_table, property::SortKeysRef sort_key,
+              TxnTs target_ts, const Options &opts,
+              btree::WriteInfo *info) noexcept;
+
   void ReleaseLock_(const Options &opts) noexcept;
 
   void Begin_(log_store::LogStore *log_store) noexcept;
@@ -118,29 +151,93 @@ private:
 
   void WaitForCommit_(log_store::LogStore *log_store) noexcept;
 
-  void UndoWriteIntents_(
-      const std::vector<std::pair<std::string_view, property::SortKeysRef>>
-          &undo_list,
-      const Options &opts) noexcept;
+  /**
+   * @brief
+   * Abort the first written_cnt intents of write set.
+   * @param written_cnt
+   * @param opts
+   */
+  void UndoWriteIntents_(size_t written_cnt, const Options &opts) noexcept;
+
+  // sub table key and sort key are both owned by arena.
+  using SetKey = std::pair<std::string_view, property::SortKeysRef>;
 
-  struct WriteSetHash {
-    size_t operator()(const std::pair<std::string, property::SortKeysRef>
-                          &value) const noexcept {
+  struct SetKeyHash {
+    size_t operator()(const SetKey &value) const noexcept {
       // using xor to simplicity.
       // Might need to use absl::combine
-      return absl::Hash<std::string>()(value.first) ^
+      return absl::Hash<std::string_view>()(value.first) ^
              property::SortKeysRefHash()(value.second);
     }
   };
 
-  struct ReadSetHash {
-    size_t operator()(const std::pair<std::string, property::SortKeys> &value)
-        const noexcept {
-      return absl::Hash<std::string>()(value.first) ^
-             property::SortKeysHash()(value.second);
-    }
+  template <typename K, typename V>
+  using ArenaMap =
+      absl::flat_hash_map<K, V, SetKeyHash, std::equal_to<K>,
+                          util::ArenaAllocator<std::pair<const K, V>>>;
+
+  struct ScanSetEntry {
+    std::string_view sub_table_key;
+    // scanned rows are [begin, end) of scanned_rows_.
+    size_t begin;
+    size_t end;
   };
 
+  template <typename T>
+  using ArenaVector = std::vector<T, util::ArenaAllocator<T>>;
+
+  using LockSet =
+      absl::flat_hash_set<std::string_view, absl::Hash<std::string_view>,
+                          std::equal_to<std::string_view>,
+                          util::ArenaAllocator<std::string_view>>;
+
+  /**
+   * @brief
+   * Check that version of key observed at read_ts is still expected_ts.
+   * @param key
+   * @param expected_ts nullopt indicates key was not found.
+   * @param read_ts
+   * @param opts
+   * @return true when read is still valid.
+   */
+  bool CheckReadVersion_(const SetKey &key, std::optional<TxnTs> expected_ts,
+                         TxnTs read_ts, const Options &opts) noexcept;
+
+  /**
+   * @brief
+   * Re-scan every range in scan set with read_ts, validation fails
+   * if any row is inserted, deleted or updated since it's scanned,
+   * i.e. phantom is detected as well.
+   * @param read_ts
+   * @param opts
+   * @return true when scan set is still valid. false is returned as well
+   * when a row is locked by others and opts.no_wait_lock is set.
+   */
+  bool ValidateScan_(TxnTs read_ts, const Options &opts) noexcept;
+
+  /**
+   * @brief
+   * Snapshot scan for read write txn, rows scanned are recorded in
+   * scan set, and merged with write set.
+   * Txn is doomed when scan failed.
+   */
+  void RangeFilterRw_(const std::string &sub_table_key, const Options &opts,
+                      const Filter &filter, const BtreeScanOpts &scan_opts,
+                      btree::RangeScanRowView *rows_view) noexcept;
+
+  /**
+   * @brief
+   * Copy sub table key and sort key into arena.
+   * @param sub_table_key
+   * @param sort_key
+   * @return SetKey
+   */
+  SetKey MakeSetKey_(std::string_view sub_table_key,
+                     property::SortKeysRef sort_key) noexcept {
+    return {arena_->CopyString(sub_table_key),
+            property::SortKeysRef(arena_->CopyString(sort_key.as_slice()))};
+  }
+
   // note that we are relying on the fact that
   // every rw txn has different read ts.
   TxnId txn_id_;
@@ -149,22 +246,27 @@ private:
   TxnType txn_type_;
   common::ShardedLockTable *lock_table_;
   const TxnManagerOCC *txn_manager_;
-  absl::flat_hash_set<std::string> lock_set_;
   absl::flat_hash_map<std::string_view, std::unique_ptr<btree::SubTable>>
       tables_;
-  // TODO(sheep): use arena to optimize memory allocation
-  absl::flat_hash_map<std::pair<std::string, property::SortKeysRef>,
-                      std::optional<property::Row>, WriteSetHash>
-      write_set_;
+  // owns row bytes, keys and entries of the sets below, so it must be
+  // destroyed after them. arena is recycled through object pool, so that
+  // short txns barely touch the heap.
+  util::PooledArena arena_;
+  LockSet lock_set_;
+  ArenaMap<SetKey, std::optional<property::Row>> write_set_;
   // sort_key -> TxnTs
-  absl::flat_hash_map<std::pair<std::string, property::SortKeys>,
-                      std::optional<TxnTs>, ReadSetHash>
-      read_set_;
-  absl::flat_hash_set<std::unique_ptr<std::string>> row_owners_;
+  ArenaMap<SetKey, std::optional<TxnTs>> read_set_;
+  ArenaVector<ScanSetEntry> scan_set_;
+  // sort key and ts of rows returned by scans.
+  ArenaVector<std::pair<property::SortKeysRef, TxnTs>> scanned_rows_;
 
   LockManagerType lock_manager_type_;
 
   log_store::LsnType lsn_{};
+
+  // set when early validation finds that read is not repeatable,
+  // or txn dies when acquiring lock.
+  bool doomed_{false};
 };
 
 } // namespace txn
@@ -13,11 +13,14 @@
 
 #include "common/config.h"
 #include "common/lock_table.h"
+#include "txn/read_ts_tracker.h"
 #include "txn/snapshot_manager.h"
 #include "txn/tso.h"
 #include "txn/txn_context_occ.h"
 #include "txn/txn_manager.h"
 #include "util/uuid.h"
+#include <atomic>
+#include <optional>
 
 namespace arcanedb {
 namespace txn {
@@ -26,12 +29,14 @@ class TxnManagerOCC : public TxnManager {
 public:
   TxnManagerOCC(LockManagerType type) noexcept
       : snapshot_manager_{}, lock_table_(common::Config::kLockTableShardNum),
+        read_ts_tracker_(common::Config::kReadTsTrackerSlotNum),
         lock_manager_type_(type) {}
 
   std::unique_ptr<TxnContext>
   BeginRoTxn(const Options &opts) const noexcept override {
     auto txn_id = util::GenerateUUID();
-    auto read_ts = snapshot_manager_.GetSnapshotTs();
+    auto read_ts = read_ts_tracker_.Register(
+        txn_id, [&]() { return snapshot_manager_.GetSnapshotTs(); });
     return std::make_unique<TxnContextOCC>(opts, txn_id, read_ts,
                                            TxnType::ReadOnlyTxn, &lock_table_,
                                            this, lock_manager_type_);
@@ -40,6 +45,8 @@ public:
   std::unique_ptr<TxnContext> BeginRoTxnWithTs(const Options &opts,
                                                TxnTs ts) const noexcept {
     auto txn_id = util::GenerateUUID();
+    // versions might have been collected if ts is less than gc watermark.
+    read_ts_tracker_.Register(txn_id, [&]() { return ts; });
     return std::make_unique<TxnContextOCC>(opts, txn_id, ts,
                                            TxnType::ReadOnlyTxn, &lock_table_,
                                            this, lock_manager_type_);
@@ -48,9 +55,18 @@ public:
   std::unique_ptr<TxnContext>
   BeginRwTxn(const Options &opts) const noexcept override {
     auto txn_id = util::GenerateUUID();
-    auto read_ts = tso_.RequestTs();
-    // commit this read ts immediately.
-    snapshot_manager_.CommitTs(read_ts);
+    auto read_ts = read_ts_tracker_.Register(txn_id, [&]() {
+      // read ts only needs to be unique, and greater than snapshot ts
+      // so that it could see all committed txns, see ReadTsTracker as well.
+      // commit ts is still requested from global counter, so that it's
+      // greater than read ts of all txns that might miss its intents.
+      return tso_.RequestLeasedTs(
+          snapshot_manager_.GetSnapshotTs(), [&](TxnTs begin, TxnTs end) {
+            // commit the whole block immediately, since nothing would be
+            // written with read ts.
+            snapshot_manager_.CommitRange(begin, end);
+          });
+    });
     return std::make_unique<TxnContextOCC>(opts, txn_id, read_ts,
                                            TxnType::ReadWriteTxn, &lock_table_,
                                            this, lock_manager_type_);
@@ -60,16 +76,81 @@ public:
 
   void Commit(TxnContext *txn_context) const noexcept {
     snapshot_manager_.CommitTs(txn_context->GetWriteTs());
+    // refresh watermark on commit path, so that compaction triggered by
+    // writers could collect stale versions without background sweeper.
+    auto commit_cnt = commit_cnt_.fetch_add(1, std::memory_order_relaxed);
+    if (unlikely(commit_cnt % common::Config::kGcWatermarkRefreshInterval ==
+                 0)) {
+      UpdateGcWatermark();
+    }
+  }
+
+  /**
+   * @brief
+   * Called after recovery before any txn begins, ts not greater than
+   * max_commit_ts are regarded as committed.
+   * @param max_commit_ts
+   */
+  void RecoverTs(TxnTs max_commit_ts) noexcept {
+    auto next_ts = tso_.AdvanceTo(max_commit_ts + 1);
+    if (next_ts <= max_commit_ts) {
+      snapshot_manager_.CommitRange(next_ts, max_commit_ts + 1);
+    }
   }
 
   LinkBufSnapshotManager *GetSnapshotManager() noexcept {
     return &snapshot_manager_;
   }
 
+  /**
+   * @brief
+   * Called when txn is finished, so that versions it reads could be
+   * collected.
+   * @param txn_id
+   * @param read_ts
+   */
+  void FinishTxn(TxnId txn_id, TxnTs read_ts) const noexcept {
+    read_ts_tracker_.Unregister(txn_id, read_ts);
+  }
+
+  /**
+   * @brief
+   * Calculate gc watermark, versions shadowed by a newer version whose
+   * ts is not greater than watermark are invisible to all txns,
+   * including the ones that will begin later.
+   * @return TxnTs
+   */
+  TxnTs UpdateGcWatermark() const noexcept {
+    // snapshot ts must be acquired before scanning active txns,
+    // see ReadTsTracker.
+    auto snapshot_ts = snapshot_manager_.GetSnapshotTs();
+    auto watermark = read_ts_tracker_.GetMinReadTs(snapshot_ts);
+    gc_watermark_.store(watermark, std::memory_order_relaxed);
+    return watermark;
+  }
+
+  /**
+   * @brief
+   * Get watermark calculated by last UpdateGcWatermark.
+   * @return std::optional<TxnTs> nullopt when it's never calculated.
+   */
+  std::optional<TxnTs> GetGcWatermark() const noexcept {
+    auto watermark = gc_watermark_.load(std::memory_order_relaxed);
+    if (watermark == kAbortedTxnTs) {
+      return std::nullopt;
+    }
+    return watermark;
+  }
+
 private:
   mutable LinkBufSnapshotManager snapshot_manager_;
   mutable common::ShardedLockTable lock_table_;
   mutable Tso tso_;
+  mutable ReadTsTracker read_ts_tracker_;
+  // watermark computed earlier is still valid, so concurrent updates
+  // don't need to be ordered.
+  mutable std::atomic<TxnTs> gc_watermark_{kAbortedTxnTs};
+  mutable std::atomic<size_t> commit_cnt_{0};
   const LockManagerType lock_manager_type_;
 };
 
@@ -0,0 +1,99 @@
+/**
+ * @file version_sweeper.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "txn/version_sweeper.h"
+#include "bthread/bthread.h"
+#include "btree/sub_table.h"
+#include "common/config.h"
+#include "txn/txn_manager_occ.h"
+#include "util/bthread_util.h"
+#include <algorithm>
+#include <vector>
+
+namespace arcanedb {
+namespace txn {
+
+void VersionSweeper::Start() noexcept {
+  bool stop = true;
+  if (!stop_.compare_exchange_strong(stop, false)) {
+    return;
+  }
+
+  wg_.Add(1);
+  util::LaunchAsync([this]() {
+    this->LoopWork_();
+    wg_.Done();
+  });
+}
+
+void VersionSweeper::Stop() noexcept {
+  bool stop = false;
+  if (!stop_.compare_exchange_strong(stop, true)) {
+    return;
+  }
+  wg_.Wait();
+}
+
+void VersionSweeper::AddSubTable(const std::string &sub_table_key,
+                                 TxnTs write_ts) noexcept {
+  std::lock_guard<bthread::Mutex> guard(mu_);
+  auto [iter, inserted] = sub_tables_.emplace(sub_table_key, write_ts);
+  if (!inserted) {
+    iter->second = std::max(iter->second, write_ts);
+  }
+}
+
+void VersionSweeper::RemoveSubTable(
+    const std::string &sub_table_key) noexcept {
+  std::lock_guard<bthread::Mutex> guard(mu_);
+  sub_tables_.erase(sub_table_key);
+}
+
+void VersionSweeper::SweepOnce() noexcept {
+  std::vector<std::pair<std::string, TxnTs>> sub_tables;
+  {
+    std::lock_guard<bthread::Mutex> guard(mu_);
+    sub_tables.assign(sub_tables_.begin(), sub_tables_.end());
+  }
+  Options opts = opts_;
+  auto watermark = txn_manager_->UpdateGcWatermark();
+  opts.gc_watermark = watermark;
+  for (const auto &[sub_table_key, write_ts] : sub_tables) {
+    std::unique_ptr<btree::SubTable> sub_table;
+    auto s = btree::SubTable::OpenSubTable(sub_table_key, opts, &sub_table);
+    if (s.ok()) {
+      s = sub_table->CollectGarbage(opts);
+    }
+    if (unlikely(!s.ok())) {
+      ARCANEDB_WARN("Failed to sweep sub table {}, status: {}", sub_table_key,
+                    s.ToString());
+      continue;
+    }
+    if (write_ts <= watermark) {
+      std::lock_guard<bthread::Mutex> guard(mu_);
+      // sub table written again during sweep is kept.
+      auto iter = sub_tables_.find(sub_table_key);
+      if (iter != sub_tables_.end() && iter->second == write_ts) {
+        sub_tables_.erase(iter);
+      }
+    }
+  }
+}
+
+void VersionSweeper::LoopWork_() noexcept {
+  while (!stop_.load(std::memory_order_relaxed)) {
+    SweepOnce();
+    bthread_usleep(common::Config::kVersionSweepInterval);
+  }
+}
+
+} // namespace txn
+} // namespace arcanedb
@@ -0,0 +1,78 @@
+/**
+ * @file version_sweeper.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-15
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include "bthread/mutex.h"
+#include "common/options.h"
+#include "common/type.h"
+#include "util/wait_group.h"
+#include <atomic>
+#include <map>
+#include <string>
+
+namespace arcanedb {
+namespace txn {
+
+class TxnManagerOCC;
+
+/**
+ * @brief
+ * Background worker that periodically refreshes gc watermark and
+ * removes stale versions from registered sub tables, so that memory
+ * of rows that are no longer updated could be reclaimed as well.
+ */
+class VersionSweeper {
+public:
+  VersionSweeper(TxnManagerOCC *txn_manager, const Options &opts) noexcept
+      : txn_manager_(txn_manager), opts_(opts) {}
+
+  ~VersionSweeper() noexcept { Stop(); }
+
+  void Start() noexcept;
+
+  void Stop() noexcept;
+
+  /**
+   * @brief
+   * Register sub table to be swept.
+   * @param sub_table_key
+   * @param write_ts sub table is dropped once it's swept with gc watermark
+   * not less than write_ts, i.e. all versions overwritten by writes before
+   * write_ts have been collected. kMaxTxnTs keeps it until it's removed.
+   */
+  void AddSubTable(const std::string &sub_table_key,
+                   TxnTs write_ts = kMaxTxnTs) noexcept;
+
+  void RemoveSubTable(const std::string &sub_table_key) noexcept;
+
+  /**
+   * @brief
+   * Sweep all sub tables once.
+   */
+  void SweepOnce() noexcept;
+
+private:
+  void LoopWork_() noexcept;
+
+  TxnManagerOCC *txn_manager_;
+  const Options opts_;
+
+  bthread::Mutex mu_;
+  // sub table key -> write ts, see AddSubTable.
+  std::map<std::string, TxnTs> sub_tables_;
+
+  util::WaitGroup wg_;
+  std::atomic_bool stop_{true};
+};
+
+} // namespace txn
+} // namespace arcanedb
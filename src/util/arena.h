@@ -0,0 +1,184 @@
+/**
+ * @file arena.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-19
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include "butil/object_pool.h"
+#include "common/config.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace arcanedb {
+namespace util {
+
+/**
+ * @brief
+ * Bump allocator, memory is released all at once when arena is reset
+ * or destroyed. Arena is not thread safe.
+ */
+class Arena {
+public:
+  explicit Arena(size_t block_size = common::Config::kArenaBlockSize) noexcept
+      : block_size_(block_size),
+        initial_block_(std::make_unique<char[]>(block_size)) {
+    Reset();
+  }
+
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  /**
+   * @brief
+   * Allocate memory with specified alignment.
+   * @param size
+   * @param align must be power of 2.
+   * @return void*
+   */
+  void *Allocate(size_t size,
+                 size_t align = alignof(std::max_align_t)) noexcept {
+    auto ptr = reinterpret_cast<uintptr_t>(ptr_);
+    size_t padding = (align - (ptr & (align - 1))) & (align - 1);
+    if (padding + size <= remain_) {
+      ptr_ += padding;
+      remain_ -= padding + size;
+      auto result = ptr_;
+      ptr_ += size;
+      return result;
+    }
+    return AllocateFallback_(size, align);
+  }
+
+  /**
+   * @brief
+   * Copy bytes into arena.
+   * @param value
+   * @return std::string_view view of the copied bytes.
+   */
+  std::string_view CopyString(std::string_view value) noexcept {
+    if (value.empty()) {
+      return {};
+    }
+    auto ptr = static_cast<char *>(Allocate(value.size(), 1));
+    memcpy(ptr, value.data(), value.size());
+    return std::string_view(ptr, value.size());
+  }
+
+  /**
+   * @brief
+   * Release all memory allocated from arena. initial block is kept so that
+   * recycled arena won't touch the heap for small workloads.
+   */
+  void Reset() noexcept {
+    blocks_.clear();
+    ptr_ = initial_block_.get();
+    remain_ = block_size_;
+    memory_usage_ = block_size_;
+  }
+
+  size_t MemoryUsage() const noexcept { return memory_usage_; }
+
+private:
+  void *AllocateFallback_(size_t size, size_t align) noexcept {
+    // large allocation gets its own block so that the rest of
+    // current block won't be wasted.
+    if (size + align > block_size_ / 4) {
+      return AlignUp_(NewBlock_(size + align), align);
+    }
+    ptr_ = NewBlock_(block_size_);
+    remain_ = block_size_;
+    return Allocate(size, align);
+  }
+
+  char *NewBlock_(size_t size) noexcept {
+    blocks_.push_back(std::make_unique<char[]>(size));
+    memory_usage_ += size;
+    return blocks_.back().get();
+  }
+
+  static char *AlignUp_(char *ptr, size_t align) noexcept {
+    auto value = reinterpret_cast<uintptr_t>(ptr);
+    return reinterpret_cast<char *>((value + align - 1) & ~(align - 1));
+  }
+
+  const size_t block_size_;
+  std::unique_ptr<char[]> initial_block_;
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  char *ptr_;
+  size_t remain_;
+  size_t memory_usage_;
+};
+
+/**
+ * @brief
+ * Return arena to object pool once it's done.
+ */
+struct ArenaRecycler {
+  void operator()(Arena *arena) const noexcept {
+    arena->Reset();
+    butil::return_object(arena);
+  }
+};
+
+using PooledArena = std::unique_ptr<Arena, ArenaRecycler>;
+
+/**
+ * @brief
+ * Get a recycled arena from object pool.
+ * @return PooledArena
+ */
+inline PooledArena GetPooledArena() noexcept {
+  return PooledArena(butil::get_object<Arena>());
+}
+
+/**
+ * @brief
+ * Std allocator adaptor, deallocation is no-op and memory is released
+ * together with arena.
+ * @tparam T
+ */
+template <typename T> class ArenaAllocator {
+public:
+  using value_type = T;
+
+  explicit ArenaAllocator(Arena *arena) noexcept : arena_(arena) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) noexcept
+      : arena_(other.GetArena()) {}
+
+  T *allocate(size_t n) noexcept {
+    return static_cast<T *>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *ptr, size_t n) noexcept {}
+
+  Arena *GetArena() const noexcept { return arena_; }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U> &other) const noexcept {
+    return arena_ == other.GetArena();
+  }
+
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U> &other) const noexcept {
+    return arena_ != other.GetArena();
+  }
+
+private:
+  Arena *arena_;
+};
+
+} // namespace util
+} // namespace arcanedb
@@ -0,0 +1,82 @@
+/**
+ * @file bloom_filter.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace arcanedb {
+namespace util {
+
+/**
+ * @brief
+ * In-memory bloom filter built over hashes of keys,
+ * probes are generated by double hashing like leveldb.
+ * Empty filter, i.e. the default constructed one, contains everything.
+ */
+class BloomFilter {
+public:
+  BloomFilter() = default;
+
+  BloomFilter(size_t key_cnt, size_t bits_per_key = 10) noexcept
+      : bits_((std::max<size_t>(key_cnt * bits_per_key, 64) + 63) / 64),
+        // 0.69 =~ ln(2), which minimizes false positive rate.
+        hash_cnt_(
+            std::clamp<size_t>(bits_per_key * 69 / 100, 1, kMaxHashCount)) {}
+
+  void Add(uint64_t hash) noexcept {
+    auto bit_cnt = bits_.size() * 64;
+    auto delta = Rotate_(hash);
+    for (size_t i = 0; i < hash_cnt_; i++) {
+      auto pos = hash % bit_cnt;
+      bits_[pos / 64] |= 1ull << (pos % 64);
+      hash += delta;
+    }
+  }
+
+  bool MayContain(uint64_t hash) const noexcept {
+    if (bits_.empty()) {
+      return true;
+    }
+    auto bit_cnt = bits_.size() * 64;
+    auto delta = Rotate_(hash);
+    for (size_t i = 0; i < hash_cnt_; i++) {
+      auto pos = hash % bit_cnt;
+      if ((bits_[pos / 64] & (1ull << (pos % 64))) == 0) {
+        return false;
+      }
+      hash += delta;
+    }
+    return true;
+  }
+
+  bool empty() const noexcept { return bits_.empty(); }
+
+  size_t GetCharge() const noexcept {
+    return bits_.capacity() * sizeof(uint64_t);
+  }
+
+private:
+  static constexpr size_t kMaxHashCount = 30;
+
+  static uint64_t Rotate_(uint64_t hash) noexcept {
+    return (hash >> 21) | (hash << 43);
+  }
+
+  std::vector<uint64_t> bits_;
+  size_t hash_cnt_{};
+};
+
+} // namespace util
+} // namespace arcanedb
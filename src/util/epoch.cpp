@@ -0,0 +1,122 @@
+/**
+ * @file epoch.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "util/epoch.h"
+#include "common/logger.h"
+#include "common/macros.h"
+#include <algorithm>
+
+namespace arcanedb {
+namespace util {
+
+class ThreadSlotHandle {
+public:
+  ~ThreadSlotHandle() noexcept {
+    if (slot != nullptr) {
+      EpochManager::GetInstance()->ReleaseSlot_(slot);
+    }
+  }
+
+  EpochManager::Slot *slot{};
+  size_t depth{};
+};
+
+static thread_local ThreadSlotHandle handle;
+
+void EpochManager::Enter() noexcept {
+  if (handle.depth++ > 0) {
+    return;
+  }
+  if (unlikely(handle.slot == nullptr)) {
+    handle.slot = AcquireSlot_();
+  }
+  // publish epoch before reading any shared pointer.
+  handle.slot->epoch.store(global_epoch_.load(std::memory_order_seq_cst),
+                           std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void EpochManager::Exit() noexcept {
+  assert(handle.depth > 0);
+  if (--handle.depth > 0) {
+    return;
+  }
+  handle.slot->epoch.store(kQuiescentEpoch, std::memory_order_release);
+}
+
+void EpochManager::Retire(std::shared_ptr<const void> ptr) noexcept {
+  // make sure unlinking is visible before reading epoch.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto epoch = global_epoch_.load(std::memory_order_seq_cst);
+  bool need_reclaim;
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    retired_.push_back(RetiredObject{.epoch = epoch, .ptr = std::move(ptr)});
+    need_reclaim = retired_.size() >= kReclaimThreshold;
+  }
+  if (need_reclaim) {
+    TryReclaim();
+  }
+}
+
+size_t EpochManager::TryReclaim() noexcept {
+  global_epoch_.fetch_add(1, std::memory_order_seq_cst);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  auto min_epoch = GetMinActiveEpoch_();
+  std::vector<RetiredObject> reclaimed;
+  {
+    std::lock_guard<std::mutex> guard(mu_);
+    auto it = std::partition(retired_.begin(), retired_.end(),
+                             [&](const RetiredObject &object) {
+                               return object.epoch >= min_epoch;
+                             });
+    reclaimed.insert(reclaimed.end(), std::make_move_iterator(it),
+                     std::make_move_iterator(retired_.end()));
+    retired_.erase(it, retired_.end());
+  }
+  // release objects outside the lock
+  return reclaimed.size();
+}
+
+uint64_t EpochManager::GetMinActiveEpoch_() const noexcept {
+  uint64_t min_epoch = kQuiescentEpoch;
+  auto slot_cnt = slot_cnt_.load(std::memory_order_seq_cst);
+  for (size_t i = 0; i < slot_cnt; i++) {
+    min_epoch = std::min(min_epoch,
+                         slots_[i].epoch.load(std::memory_order_seq_cst));
+  }
+  return min_epoch;
+}
+
+EpochManager::Slot *EpochManager::AcquireSlot_() noexcept {
+  for (size_t i = 0; i < kMaxSlotNum; i++) {
+    bool in_use = false;
+    if (slots_[i].in_use.load(std::memory_order_relaxed) ||
+        !slots_[i].in_use.compare_exchange_strong(in_use, true)) {
+      continue;
+    }
+    auto slot_cnt = slot_cnt_.load(std::memory_order_seq_cst);
+    while (slot_cnt < i + 1 &&
+           !slot_cnt_.compare_exchange_weak(slot_cnt, i + 1)) {
+    }
+    return &slots_[i];
+  }
+  FATAL("Failed to acquire epoch slot, too many threads");
+  UNREACHABLE();
+}
+
+void EpochManager::ReleaseSlot_(Slot *slot) noexcept {
+  slot->epoch.store(kQuiescentEpoch, std::memory_order_release);
+  slot->in_use.store(false, std::memory_order_release);
+}
+
+} // namespace util
+} // namespace arcanedb
@@ -0,0 +1,137 @@
+/**
+ * @file epoch.h
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief epoch based reclamation
+ * @version 0.1
+ * @date 2023-02-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#pragma once
+
+#include "butil/macros.h"
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace arcanedb {
+namespace util {
+
+/**
+ * @brief
+ * Epoch based reclamation.
+ * Readers enter a critical section by EpochGuard, and access shared objects
+ * through raw pointers without touching reference count.
+ * Writers unlink objects first, then retire them to EpochManager. retired
+ * objects are released once every reader that might observe them has left
+ * its critical section.
+ * Critical section must not block or yield, since epoch is recorded in a
+ * per-thread slot and bthread might be scheduled to another worker.
+ */
+class EpochManager {
+  static constexpr uint64_t kQuiescentEpoch =
+      std::numeric_limits<uint64_t>::max();
+
+public:
+  static constexpr size_t kMaxSlotNum = 1024;
+  static constexpr size_t kReclaimThreshold = 64;
+
+  // per-thread slot is bound to the global instance,
+  // so there should be only one EpochManager in process.
+  static EpochManager *GetInstance() noexcept {
+    static EpochManager manager;
+    return &manager;
+  }
+
+  /**
+   * @brief
+   * Enter critical section, could be nested.
+   */
+  void Enter() noexcept;
+
+  /**
+   * @brief
+   * Leave critical section.
+   */
+  void Exit() noexcept;
+
+  /**
+   * @brief
+   * Retire an object which has been unlinked from shared structure,
+   * it will be released after all current readers left.
+   * @param ptr
+   */
+  void Retire(std::shared_ptr<const void> ptr) noexcept;
+
+  /**
+   * @brief
+   * Advance epoch and release retired objects which are safe to reclaim.
+   * @return size_t number of reclaimed objects.
+   */
+  size_t TryReclaim() noexcept;
+
+  size_t TEST_GetRetiredCount() noexcept {
+    std::lock_guard<std::mutex> guard(mu_);
+    return retired_.size();
+  }
+
+  DISALLOW_COPY_AND_ASSIGN(EpochManager);
+
+private:
+  EpochManager() = default;
+
+  ~EpochManager() = default;
+
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> epoch{kQuiescentEpoch};
+    std::atomic<bool> in_use{false};
+  };
+
+  struct RetiredObject {
+    uint64_t epoch;
+    std::shared_ptr<const void> ptr;
+  };
+
+  friend class ThreadSlotHandle;
+
+  Slot *AcquireSlot_() noexcept;
+
+  void ReleaseSlot_(Slot *slot) noexcept;
+
+  // minimum epoch among active readers.
+  uint64_t GetMinActiveEpoch_() const noexcept;
+
+  std::atomic<uint64_t> global_epoch_{0};
+  Slot slots_[kMaxSlotNum];
+  // slots in [0, slot_cnt_) might be in use.
+  std::atomic<size_t> slot_cnt_{0};
+
+  std::mutex mu_;
+  std::vector<RetiredObject> retired_; // guarded by mu_
+};
+
+/**
+ * @brief
+ * RAII helper of epoch critical section.
+ */
+class EpochGuard {
+public:
+  EpochGuard() noexcept : manager_(EpochManager::GetInstance()) {
+    manager_->Enter();
+  }
+
+  ~EpochGuard() noexcept { manager_->Exit(); }
+
+  DISALLOW_COPY_AND_ASSIGN(EpochGuard);
+
+private:
+  EpochManager *manager_;
+};
+
+} // namespace util
+} // namespace arcanedb
@@ -155,6 +155,10 @@ public:
   @return true if and only if the pointer has been advanced */
   bool advance_tail();
 
+  /** @return true if and only if there is a link starting at the tail,
+  i.e. the tail could be advanced */
+  bool has_link_at_tail() const;
+
   /** @return capacity of the ring buffer */
   size_t capacity() const;
 
@@ -402,6 +406,13 @@ template <typename Position> inline bool Link_buf<Position>::advance_tail() {
   return advance_tail_until(stop_condition);
 }
 
+template <typename Position>
+inline bool Link_buf<Position>::has_link_at_tail() const {
+  auto position = m_tail.load(std::memory_order_acquire);
+  auto next = m_links[slot_index(position)].load(std::memory_order_acquire);
+  return next > position && next < position + m_capacity;
+}
+
 template <typename Position>
 inline size_t Link_buf<Position>::capacity() const {
   return m_capacity;
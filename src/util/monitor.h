@@ -28,8 +28,10 @@ namespace util {
   ARCANEDB_X(SealByIoThread)                                                   \
   ARCANEDB_X(IoLatency)                                                        \
   ARCANEDB_X(WaitCommitLatency)                                                \
+  ARCANEDB_X(LockWait)                                                         \
   ARCANEDB_X(WritePageCache)                                                   \
-  ARCANEDB_X(Fsync)
+  ARCANEDB_X(Fsync)                                                            \
+  ARCANEDB_X(LogFlushBytes)
 
 class Monitor {
 public:
@@ -18,27 +18,51 @@ namespace arcanedb {
 namespace util {
 
 // TODO: implement more efficient version by using butex
+/**
+ * @brief
+ * Notification is latched, i.e. it's not lost when nobody is waiting,
+ * and the next Wait returns immediately. Designed for single waiter.
+ */
 class SimpleWaiter {
 public:
   SimpleWaiter() = default;
 
   void Wait() noexcept {
     std::unique_lock<bthread::Mutex> lock(mu_);
-    cv_.wait(lock);
+    while (!notified_) {
+      cv_.wait(lock);
+    }
+    notified_ = false;
   }
 
   void Wait(int64_t timeout_us) noexcept {
     std::unique_lock<bthread::Mutex> lock(mu_);
-    cv_.wait_for(lock, timeout_us);
+    if (!notified_) {
+      cv_.wait_for(lock, timeout_us);
+    }
+    notified_ = false;
   }
 
-  void NotifyOne() noexcept { cv_.notify_one(); }
+  void NotifyOne() noexcept {
+    {
+      std::lock_guard<bthread::Mutex> guard(mu_);
+      notified_ = true;
+    }
+    cv_.notify_one();
+  }
 
-  void NotifyAll() noexcept { cv_.notify_all(); }
+  void NotifyAll() noexcept {
+    {
+      std::lock_guard<bthread::Mutex> guard(mu_);
+      notified_ = true;
+    }
+    cv_.notify_all();
+  }
 
 private:
   bthread::Mutex mu_;
   bthread::ConditionVariable cv_;
+  bool notified_{false}; // guarded by mu_
 };
 
 } // namespace util
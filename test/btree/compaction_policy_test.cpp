@@ -0,0 +1,46 @@
+/**
+ * @file compaction_policy_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-14
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "btree/page/compaction_policy.h"
+#include <gtest/gtest.h>
+
+namespace arcanedb {
+namespace btree {
+
+TEST(CompactionPolicyTest, TieredTest) {
+  TieredCompactionPolicy policy(4, 2);
+  EXPECT_FALSE(policy.NeedCompaction({.chain_length = 4, .read_cost = 0}));
+  EXPECT_TRUE(policy.NeedCompaction({.chain_length = 5, .read_cost = 0}));
+  DeltaChainStat stat{.chain_length = 5, .read_cost = 0};
+  // single row delta is always merged
+  EXPECT_TRUE(policy.ShouldMerge(stat, 1, 1));
+  EXPECT_TRUE(policy.ShouldMerge(stat, 10, 19));
+  EXPECT_FALSE(policy.ShouldMerge(stat, 10, 20));
+}
+
+TEST(CompactionPolicyTest, ReadHeatTest) {
+  TieredCompactionPolicy base(4, 2);
+  ReadHeatCompactionPolicy policy(&base, 100);
+  EXPECT_FALSE(policy.NeedCompaction({.chain_length = 2, .read_cost = 99}));
+  EXPECT_TRUE(policy.NeedCompaction({.chain_length = 2, .read_cost = 100}));
+  // consolidated chain doesn't need compaction
+  EXPECT_FALSE(policy.NeedCompaction({.chain_length = 1, .read_cost = 100}));
+  // fallback to base policy
+  EXPECT_TRUE(policy.NeedCompaction({.chain_length = 5, .read_cost = 0}));
+  EXPECT_FALSE(
+      policy.ShouldMerge({.chain_length = 5, .read_cost = 0}, 10, 20));
+  // hot chain is fully merged
+  EXPECT_TRUE(
+      policy.ShouldMerge({.chain_length = 5, .read_cost = 100}, 10, 20));
+}
+
+} // namespace btree
+} // namespace arcanedb
@@ -179,5 +179,90 @@ TEST(InternalPageTest, ConcurrentTest) {
   wg.Wait();
 }
 
+TEST(InternalPageTest, SerializationTest) {
+  InternalPage page;
+  Options opts;
+  std::vector<InternalRow> internal_rows;
+  internal_rows.push_back(InternalRow{
+      .sort_key = property::SortKeys(std::string_view()), .page_id = "a"});
+  internal_rows.push_back(
+      InternalRow{.sort_key = property::SortKeys({123, 456}), .page_id = "b"});
+  EXPECT_TRUE(
+      page.Split(opts, property::SortKeysRef(""), std::move(internal_rows))
+          .ok());
+  EXPECT_EQ(page.AllocateChildPageId("page"), "page#0");
+
+  auto bytes = page.GetPageSnapshot()->Serialize();
+  InternalPage new_page;
+  EXPECT_TRUE(new_page.Deserialize(bytes).ok());
+  EXPECT_TRUE(new_page.TEST_SortKeyAscending());
+  EXPECT_EQ(new_page.AllocateChildPageId("page"), "page#1");
+  {
+    InternalRowView view;
+    EXPECT_TRUE(
+        new_page.GetPageId(opts, property::SortKeys({12, 34}).as_ref(), &view)
+            .ok());
+    EXPECT_EQ(view.at(0), "a");
+  }
+  {
+    InternalRowView view;
+    EXPECT_TRUE(new_page
+                    .GetPageId(opts, property::SortKeys({123, 456}).as_ref(),
+                               &view)
+                    .ok());
+    EXPECT_EQ(view.at(0), "b");
+  }
+}
+
+TEST(InternalPageTest, MergeTest) {
+  InternalPage page;
+  Options opts;
+  std::vector<InternalRow> internal_rows;
+  internal_rows.push_back(InternalRow{
+      .sort_key = property::SortKeys(std::string_view()), .page_id = "a"});
+  internal_rows.push_back(
+      InternalRow{.sort_key = property::SortKeys({123, 456}), .page_id = "b"});
+  internal_rows.push_back(
+      InternalRow{.sort_key = property::SortKeys({456, 789}), .page_id = "c"});
+  EXPECT_TRUE(
+      page.Split(opts, property::SortKeysRef(""), std::move(internal_rows))
+          .ok());
+  {
+    std::optional<InternalRow> left;
+    std::optional<InternalRow> right;
+    EXPECT_TRUE(page.GetSiblingRows(opts, property::SortKeys({12, 34}).as_ref(),
+                                    &left, &right)
+                    .ok());
+    EXPECT_EQ(left->page_id, "a");
+    EXPECT_EQ(right->page_id, "b");
+    // last row is merged into its left sibling
+    EXPECT_TRUE(page.GetSiblingRows(opts,
+                                    property::SortKeys({666, 789}).as_ref(),
+                                    &left, &right)
+                    .ok());
+    EXPECT_EQ(left->page_id, "b");
+    EXPECT_EQ(right->page_id, "c");
+  }
+  // first row could not be removed
+  EXPECT_TRUE(page.Merge(opts, property::SortKeysRef("")).IsNotFound());
+  EXPECT_TRUE(
+      page.Merge(opts, property::SortKeys({123, 455}).as_ref()).IsNotFound());
+  EXPECT_TRUE(page.Merge(opts, property::SortKeys({123, 456}).as_ref()).ok());
+  EXPECT_TRUE(page.TEST_SortKeyAscending());
+  {
+    InternalRowView view;
+    EXPECT_TRUE(
+        page.GetPageId(opts, property::SortKeys({123, 456}).as_ref(), &view)
+            .ok());
+    EXPECT_EQ(view.at(0), "a");
+  }
+  EXPECT_TRUE(page.Merge(opts, property::SortKeys({456, 789}).as_ref()).ok());
+  std::optional<InternalRow> left;
+  std::optional<InternalRow> right;
+  EXPECT_TRUE(page.GetSiblingRows(opts, property::SortKeysRef(""), &left,
+                                  &right)
+                  .IsNotFound());
+}
+
 } // namespace btree
 } // namespace arcanedb
\ No newline at end of file
@@ -10,6 +10,7 @@
  */
 
 #include "btree/versioned_btree.h"
+#include "bthread/bthread.h"
 #include "page_store/kv_page_store/kv_page_store.h"
 #include "property/schema.h"
 #include "util/bthread_util.h"
@@ -224,5 +225,448 @@ TEST_F(VersionedBtreeTest, FlushPageTest) {
   }
 }
 
+TEST_F(VersionedBtreeTest, SplitTest) {
+  auto value_list = GenerateValueList(1000);
+  TxnTs ts = 1;
+  WriteInfo info;
+  // disable background merge triggered by delete
+  Options opts = opts_;
+  opts.page_merge_threshold = 0;
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return btree_->SetRow(row, ts, opts, &info);
+                }).ok());
+  }
+  // split leaf pages several times
+  for (int i = 0; i < 8; i++) {
+    auto &value = value_list[(i * 131) % value_list.size()];
+    auto sk = property::SortKeys({value.point_id, value.point_type});
+    EXPECT_TRUE(btree_->SplitLeafPage(opts, sk.as_ref()).ok());
+  }
+  for (const auto &value : value_list) {
+    SCOPED_TRACE("");
+    TestRead(value, ts, false);
+  }
+  // write after split
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return btree_->DeleteRow(row.GetSortKeys(), ts + 1, opts,
+                                           &info);
+                }).ok());
+  }
+  for (const auto &value : value_list) {
+    SCOPED_TRACE("");
+    TestRead(value, ts, false);
+    TestRead(value, ts + 1, true);
+  }
+}
+
+TEST_F(VersionedBtreeTest, RangeFilterAfterSplitTest) {
+  auto value_list = GenerateValueList(100);
+  TxnTs ts = 1;
+  WriteInfo info;
+  Options opts = opts_;
+  opts.force_compaction = true;
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return btree_->SetRow(row, ts, opts, &info);
+                }).ok());
+  }
+  for (int i = 0; i < 4; i++) {
+    auto &value = value_list[i * 25];
+    auto sk = property::SortKeys({value.point_id, value.point_type});
+    EXPECT_TRUE(btree_->SplitLeafPage(opts_, sk.as_ref()).ok());
+  }
+  RangeScanRowView views;
+  btree_->RangeFilter(opts_, {}, {}, &views);
+  EXPECT_EQ(views.size(), value_list.size());
+  for (int i = 0; i < views.size(); i++) {
+    property::ValueResult res;
+    EXPECT_TRUE(views.at(i).GetProp(0, &res, &schema_).ok());
+    EXPECT_EQ(std::get<int64_t>(res.value), value_list[i].point_id);
+  }
+  size_t cnt = 0;
+  for (auto it = btree_->GetRowIterator(opts_); it.Valid(); it.Next()) {
+    cnt += 1;
+  }
+  EXPECT_EQ(cnt, value_list.size());
+}
+
+TEST_F(VersionedBtreeTest, ConcurrentSplitTest) {
+  int worker_count = 50;
+  int epoch_cnt = 20;
+  util::WaitGroup wg(worker_count + 1);
+  std::atomic<bool> stop{false};
+  TxnTs ts = 1;
+  util::LaunchAsync([&]() {
+    int idx = 0;
+    while (!stop.load()) {
+      auto sk = property::SortKeys({int64_t(idx % worker_count), type_});
+      auto s = btree_->SplitLeafPage(opts_, sk.as_ref());
+      EXPECT_TRUE(s.ok() || s.IsNotFound());
+      idx += 7;
+      bthread_usleep(100);
+    }
+    wg.Done();
+  });
+  util::WaitGroup writer_wg(worker_count);
+  for (int i = 0; i < worker_count; i++) {
+    util::LaunchAsync([&, index = i]() {
+      ValueStruct value{
+          .point_id = index, .point_type = 0, .value = std::to_string(index)};
+      for (int j = 0; j < epoch_cnt; j++) {
+        WriteInfo info;
+        EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                      return btree_->SetRow(row, ts, opts_, &info);
+                    }).ok());
+        {
+          SCOPED_TRACE("");
+          TestRead(value, ts, false);
+        }
+      }
+      writer_wg.Done();
+      wg.Done();
+    });
+  }
+  writer_wg.Wait();
+  stop.store(true);
+  wg.Wait();
+}
+
+TEST_F(VersionedBtreeTest, SplitFlushTest) {
+  {
+    btree_.reset();
+    buffer_pool_.reset();
+    page_store::Options opts;
+    std::shared_ptr<page_store::PageStore> page_store;
+    const std::string store_name = "test_split_store";
+    EXPECT_TRUE(page_store::KvPageStore::Destory(store_name).ok());
+    EXPECT_TRUE(
+        page_store::KvPageStore::Open(store_name, opts, &page_store).ok());
+    buffer_pool_ = std::make_unique<cache::BufferPool>(std::move(page_store));
+    opts_.buffer_pool = buffer_pool_.get();
+    LoadBtree("test_page");
+  }
+  auto value_list = GenerateValueList(100);
+  TxnTs ts = 1;
+  WriteInfo info;
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return btree_->SetRow(row, ts, opts_, &info);
+                }).ok());
+  }
+  for (int i = 0; i < 4; i++) {
+    auto &value = value_list[i * 25];
+    auto sk = property::SortKeys({value.point_id, value.point_type});
+    EXPECT_TRUE(btree_->SplitLeafPage(opts_, sk.as_ref()).ok());
+  }
+  btree_.reset();
+  buffer_pool_->ForceFlushAllPages();
+  buffer_pool_->Prune();
+  EXPECT_EQ(buffer_pool_->TotalCharge(), 0);
+
+  LoadBtree("test_page");
+  for (const auto &value : value_list) {
+    SCOPED_TRACE("");
+    TestRead(value, ts, false);
+  }
+}
+
+/**
+ * @brief
+ * Page store which rejects writes issued by flusher, so that only pages
+ * persisted by SMO itself are visible.
+ */
+class NoFlusherPageStore : public page_store::PageStore {
+public:
+  explicit NoFlusherPageStore(std::shared_ptr<page_store::PageStore> store)
+      : store_(std::move(store)) {}
+
+  Status UpdateReplacement(const PageIdType &page_id,
+                           const page_store::WriteOptions &options,
+                           const std::string_view &data) noexcept override {
+    // flusher runs in bthread, while SMO is performed by test thread.
+    if (bthread_self() != 0) {
+      return Status::Err();
+    }
+    return store_->UpdateReplacement(page_id, options, data);
+  }
+
+  Status UpdateDelta(const PageIdType &page_id,
+                     const page_store::WriteOptions &options,
+                     const std::string_view &data) noexcept override {
+    return Status::Err();
+  }
+
+  Status DeletePage(const PageIdType &page_id,
+                    const page_store::WriteOptions &options) noexcept override {
+    return store_->DeletePage(page_id, options);
+  }
+
+  Status ReadPage(const PageIdType &page_id,
+                  const page_store::ReadOptions &options,
+                  std::vector<RawPage> *pages) noexcept override {
+    return store_->ReadPage(page_id, options, pages);
+  }
+
+private:
+  std::shared_ptr<page_store::PageStore> store_;
+};
+
+TEST_F(VersionedBtreeTest, SplitPersistTest) {
+  page_store::Options store_opts;
+  std::shared_ptr<page_store::PageStore> page_store;
+  const std::string store_name = "test_split_persist_store";
+  EXPECT_TRUE(page_store::KvPageStore::Destory(store_name).ok());
+  EXPECT_TRUE(
+      page_store::KvPageStore::Open(store_name, store_opts, &page_store).ok());
+  {
+    btree_.reset();
+    buffer_pool_ = std::make_unique<cache::BufferPool>(
+        std::make_shared<NoFlusherPageStore>(page_store));
+    opts_.buffer_pool = buffer_pool_.get();
+    LoadBtree("test_page");
+  }
+  auto value_list = GenerateValueList(100);
+  TxnTs ts = 1;
+  WriteInfo info;
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return btree_->SetRow(row, ts, opts_, &info);
+                }).ok());
+  }
+  for (int i = 0; i < 4; i++) {
+    auto &value = value_list[i * 25];
+    auto sk = property::SortKeys({value.point_id, value.point_type});
+    EXPECT_TRUE(btree_->SplitLeafPage(opts_, sk.as_ref()).ok());
+  }
+
+  // pages modified by SMO are persisted without waiting for flusher.
+  auto buffer_pool = std::make_unique<cache::BufferPool>(page_store);
+  cache::BufferPool::PageHolder root_page;
+  EXPECT_TRUE(buffer_pool->GetPage("test_page", &root_page).ok());
+  EXPECT_EQ(root_page->GetPageType(), PageType::InternalPage);
+  EXPECT_EQ(root_page->GetChildNum(), 5);
+  VersionedBtree btree(root_page);
+  Options opts = opts_;
+  opts.buffer_pool = buffer_pool.get();
+  RangeScanRowView views;
+  btree.RangeFilter(opts, {}, {}, &views);
+  EXPECT_EQ(views.size(), value_list.size());
+}
+
+TEST_F(VersionedBtreeTest, MaxLeafPageNumTest) {
+  auto value_list = GenerateValueList(100);
+  TxnTs ts = 1;
+  WriteInfo info;
+  Options opts = opts_;
+  opts.max_leaf_page_num = 2;
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return btree_->SetRow(row, ts, opts, &info);
+                }).ok());
+  }
+  auto sk = property::SortKeys({value_list[0].point_id, type_});
+  EXPECT_TRUE(btree_->SplitLeafPage(opts, sk.as_ref()).ok());
+  // internal page is never split.
+  EXPECT_TRUE(btree_->SplitLeafPage(opts, sk.as_ref()).IsNotFound());
+  for (const auto &value : value_list) {
+    SCOPED_TRACE("");
+    TestRead(value, ts, false);
+  }
+}
+
+TEST_F(VersionedBtreeTest, SizeTriggeredSplitTest) {
+  auto value_list = GenerateValueList(1000);
+  TxnTs ts = 1;
+  WriteInfo info;
+  Options opts = opts_;
+  opts.page_split_threshold = 4096;
+  opts.page_merge_threshold = 0;
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return btree_->SetRow(row, ts, opts, &info);
+                }).ok());
+  }
+  cache::BufferPool::PageHolder root_page;
+  EXPECT_TRUE(buffer_pool_->GetPage("test_page", &root_page).ok());
+  // wait for background split
+  while (root_page->IsInSMO()) {
+    bthread_usleep(1000);
+  }
+  EXPECT_EQ(root_page->GetPageType(), PageType::InternalPage);
+  for (const auto &value : value_list) {
+    SCOPED_TRACE("");
+    TestRead(value, ts, false);
+  }
+  RangeScanRowView views;
+  btree_->RangeFilter(opts_, {}, {}, &views);
+  EXPECT_EQ(views.size(), value_list.size());
+}
+
+TEST_F(VersionedBtreeTest, DestroyDuringSMOTest) {
+  auto value_list = GenerateValueList(1000);
+  TxnTs ts = 1;
+  WriteInfo info;
+  Options opts = opts_;
+  opts.page_split_threshold = 4096;
+  opts.page_merge_threshold = 0;
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return btree_->SetRow(row, ts, opts, &info);
+                }).ok());
+  }
+  // don't wait for background SMO, buffer pool waits for it instead.
+  btree_.reset();
+  buffer_pool_.reset();
+}
+
+TEST_F(VersionedBtreeTest, SMOWatermarkTest) {
+  auto value_list = GenerateValueList(1000);
+  TxnTs ts = 1;
+  WriteInfo info;
+  Options opts = opts_;
+  opts.page_split_threshold = 4096;
+  opts.page_merge_threshold = 0;
+  opts.max_leaf_page_num = 2;
+  cache::BufferPool::PageHolder root_page;
+  EXPECT_TRUE(buffer_pool_->GetPage("test_page", &root_page).ok());
+  auto write = [&](const ValueStruct &value) {
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return btree_->SetRow(row, ts, opts, &info);
+                }).ok());
+    while (root_page->IsInSMO()) {
+      bthread_usleep(100);
+    }
+  };
+  for (const auto &value : value_list) {
+    write(value);
+  }
+  EXPECT_EQ(root_page->GetChildNum(), 2);
+
+  // page that could not be split is not rescheduled until it's doubled.
+  write(value_list.back());
+  auto sk = property::SortKeys({value_list.back().point_id, type_});
+  InternalRowView view;
+  EXPECT_TRUE(root_page->GetPageId(opts, sk.as_ref(), &view).ok());
+  cache::BufferPool::PageHolder page;
+  EXPECT_TRUE(buffer_pool_->GetPage(view.at(0), &page).ok());
+  EXPECT_GT(page->GetSplitWatermark(), page->GetTotalCharge());
+  for (const auto &value : value_list) {
+    SCOPED_TRACE("");
+    TestRead(value, ts, false);
+  }
+}
+
+TEST_F(VersionedBtreeTest, MergeTest) {
+  auto value_list = GenerateValueList(100);
+  TxnTs ts = 1;
+  WriteInfo info;
+  Options opts = opts_;
+  opts.page_merge_threshold = 0;
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return btree_->SetRow(row, ts, opts, &info);
+                }).ok());
+  }
+  for (int i = 0; i < 4; i++) {
+    auto &value = value_list[i * 25];
+    auto sk = property::SortKeys({value.point_id, value.point_type});
+    EXPECT_TRUE(btree_->SplitLeafPage(opts, sk.as_ref()).ok());
+  }
+  // delete odd rows
+  for (int i = 1; i < value_list.size(); i += 2) {
+    EXPECT_TRUE(WriteHelper(value_list[i], [&](const property::Row &row) {
+                  return btree_->DeleteRow(row.GetSortKeys(), ts + 1, opts,
+                                           &info);
+                }).ok());
+  }
+  // merge every leaf page, and drop the tombstones
+  opts.gc_watermark = ts + 1;
+  auto sk = property::SortKeys(
+      {value_list[0].point_id, value_list[0].point_type});
+  while (btree_->MergeLeafPage(opts, sk.as_ref()).ok()) {
+  }
+  for (int i = 0; i < value_list.size(); i++) {
+    SCOPED_TRACE("");
+    TestRead(value_list[i], ts + 1, i % 2 == 1);
+  }
+  RangeScanRowView views;
+  btree_->RangeFilter(opts_, {}, {}, &views);
+  EXPECT_EQ(views.size(), value_list.size() / 2);
+  for (int i = 0; i < views.size(); i++) {
+    property::ValueResult res;
+    EXPECT_TRUE(views.at(i).GetProp(0, &res, &schema_).ok());
+    EXPECT_EQ(std::get<int64_t>(res.value), value_list[i * 2].point_id);
+  }
+  // write after merge
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return btree_->SetRow(row, ts + 2, opts, &info);
+                }).ok());
+  }
+  for (const auto &value : value_list) {
+    SCOPED_TRACE("");
+    TestRead(value, ts + 2, false);
+  }
+}
+
+TEST_F(VersionedBtreeTest, MergeStubTest) {
+  auto value_list = GenerateValueList(100);
+  TxnTs ts = 1;
+  WriteInfo info;
+  // disable background SMO, which should never be triggered on stub.
+  Options opts = opts_;
+  opts.page_split_threshold = 0;
+  opts.page_merge_threshold = 0;
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return btree_->SetRow(row, ts, opts, &info);
+                }).ok());
+  }
+  auto right_sk = property::SortKeys(
+      {value_list[50].point_id, value_list[50].point_type});
+  EXPECT_TRUE(btree_->SplitLeafPage(opts, right_sk.as_ref()).ok());
+  cache::BufferPool::PageHolder root_page;
+  EXPECT_TRUE(buffer_pool_->GetPage("test_page", &root_page).ok());
+  InternalRowView view;
+  EXPECT_TRUE(root_page->GetPageId(opts, right_sk.as_ref(), &view).ok());
+  cache::BufferPool::PageHolder right_page;
+  EXPECT_TRUE(buffer_pool_->GetPage(view.at(0), &right_page).ok());
+  auto left_sk = property::SortKeys(
+      {value_list[0].point_id, value_list[0].point_type});
+  view.clear();
+  EXPECT_TRUE(root_page->GetPageId(opts, left_sk.as_ref(), &view).ok());
+  std::string left_page_id(view.at(0));
+
+  EXPECT_TRUE(btree_->MergeLeafPage(opts, left_sk.as_ref()).ok());
+  // rows of right page are released, only the stub is left.
+  EXPECT_TRUE(right_page->IsMerged());
+  EXPECT_EQ(right_page->GetTotalCharge(), sizeof(VersionedBwTreePage));
+  PageIdType right_page_id;
+  EXPECT_EQ(right_page->GetDeltaChain(&right_page_id), nullptr);
+
+  // operations routed to stub are redirected to left page.
+  VersionedBtree stale_btree(right_page);
+  for (const auto &value : value_list) {
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return stale_btree.DeleteRow(row.GetSortKeys(), ts + 1,
+                                               opts, &info);
+                }).ok());
+  }
+  for (const auto &value : value_list) {
+    SCOPED_TRACE("");
+    TestRead(value, ts, false);
+    TestRead(value, ts + 1, true);
+  }
+
+  // persisted stub still redirects to left page.
+  auto binary = right_page->GetPageSnapshot()->Serialize();
+  VersionedBtreePage new_page(right_page->GetPageKey());
+  EXPECT_TRUE(new_page.Deserialize(binary).ok());
+  EXPECT_TRUE(new_page.IsMerged());
+  EXPECT_EQ(new_page.GetRightPageId(), left_page_id);
+}
+
 } // namespace btree
 } // namespace arcanedb
\ No newline at end of file
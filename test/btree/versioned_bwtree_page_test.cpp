@@ -12,9 +12,12 @@
 #include "btree/page/versioned_bwtree_page.h"
 #include "bvar/bvar.h"
 #include "common/config.h"
+#include "log_store/log_store.h"
 #include "util/bthread_util.h"
 #include "util/wait_group.h"
 #include <gtest/gtest.h>
+#include <mutex>
+#include <set>
 
 namespace arcanedb {
 namespace btree {
@@ -143,6 +146,7 @@ TEST_F(VersionedBwTreePageTest, CompactionTest) {
     });
     EXPECT_TRUE(s.ok());
   }
+  page_->WaitForBackgroundCompaction();
   EXPECT_LE(page_->TEST_GetDeltaLength(),
             common::Config::kBwTreeDeltaChainLength);
   // test read
@@ -237,6 +241,7 @@ TEST_F(VersionedBwTreePageTest, ConcurrentCompactionTest) {
     });
   }
   wg.Wait();
+  page_->WaitForBackgroundCompaction();
   EXPECT_LE(page_->TEST_GetDeltaLength(),
             common::Config::kBwTreeDeltaChainLength);
   ARCANEDB_INFO("read avg latency: {}, max latency: {}", read_latency.latency(),
@@ -424,6 +429,33 @@ TEST_F(VersionedBwTreePageTest, SetWhileCheckingLockTest) {
   EXPECT_EQ(view.at(0).GetTs(), ts);
 }
 
+TEST_F(VersionedBwTreePageTest, ConcurrentCheckingLockTest) {
+  int worker_count = 100;
+  util::WaitGroup wg(worker_count);
+  Options opts;
+  opts.check_intent_locked = true;
+  std::atomic<int> succeed_cnt{0};
+  ValueStruct value{.point_id = 0, .point_type = 0, .value = "hello"};
+  for (int i = 0; i < worker_count; i++) {
+    util::LaunchAsync([&]() {
+      WriteInfo info;
+      auto s = WriteHelper(value, [&](const property::Row &row) {
+        return page_->SetRow(row, MarkLocked(1), opts, &info);
+      });
+      if (s.ok()) {
+        succeed_cnt.fetch_add(1);
+      } else {
+        EXPECT_TRUE(s.IsTxnConflict());
+      }
+      wg.Done();
+    });
+  }
+  wg.Wait();
+  // only one writer could acquire the intent lock,
+  // even if writers are committed in the same batch.
+  EXPECT_EQ(succeed_cnt.load(), 1);
+}
+
 TEST_F(VersionedBwTreePageTest, SerializeTest) {
   auto value_list = GenerateValueList(2000);
   WriteInfo info;
@@ -478,6 +510,79 @@ TEST_F(VersionedBwTreePageTest, RangeFilterTest) {
   }
 }
 
+TEST_F(VersionedBwTreePageTest, RangeScanTest) {
+  auto value_list = GenerateValueList(100);
+  WriteInfo info;
+  for (int i = value_list.size() - 1; i >= 0; i--) {
+    auto s = WriteHelper(value_list[i], [&](const property::Row &row) {
+      return page_->SetRow(row, 1, opts_, &info);
+    });
+    EXPECT_TRUE(s.ok());
+  }
+  for (int i = 0; i < value_list.size(); i += 2) {
+    auto sk = property::SortKeys(
+        {value_list[i].point_id, value_list[i].point_type});
+    EXPECT_TRUE(page_->DeleteRow(sk.as_ref(), 2, opts_, &info).ok());
+  }
+  auto new_value = value_list[1];
+  new_value.value = "new";
+  EXPECT_TRUE(WriteHelper(new_value, [&](const property::Row &row) {
+                return page_->SetRow(row, 3, opts_, &info);
+              }).ok());
+  {
+    // deleted rows are visible to old snapshot.
+    RowView view;
+    page_->RangeScan(1, opts_, &view);
+    ASSERT_EQ(view.size(), value_list.size());
+    for (int i = 0; i < value_list.size(); i++) {
+      TestRead(view.at(i), value_list[i]);
+      EXPECT_EQ(view.at(i).GetTs(), 1);
+    }
+  }
+  {
+    RowView view;
+    page_->RangeScan(2, opts_, &view);
+    ASSERT_EQ(view.size(), value_list.size() / 2);
+    for (int i = 0; i < view.size(); i++) {
+      TestRead(view.at(i), value_list[i * 2 + 1]);
+    }
+  }
+  {
+    RowView view;
+    page_->RangeScan(3, opts_, &view);
+    ASSERT_EQ(view.size(), value_list.size() / 2);
+    TestRead(view.at(0), new_value);
+    EXPECT_EQ(view.at(0).GetTs(), 3);
+  }
+}
+
+TEST_F(VersionedBwTreePageTest, NoWaitLockTest) {
+  Options opts;
+  TxnTs ts = 1;
+  ValueStruct value{.point_id = 0, .point_type = 0, .value = "hello"};
+  WriteInfo info;
+  EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                return page_->SetRow(row, MarkLocked(ts), opts, &info);
+              }).ok());
+  auto sk = property::SortKeys({value.point_id, value.point_type});
+  opts.no_wait_lock = true;
+  {
+    RowView view;
+    EXPECT_TRUE(page_->GetRow(sk.as_ref(), ts, opts, &view).IsRowLocked());
+  }
+  {
+    RowView view;
+    EXPECT_TRUE(page_->RangeScan(ts, opts, &view).IsRowLocked());
+    EXPECT_EQ(view.size(), 0);
+  }
+  // owner doesn't conflict with its own intent.
+  opts.owner_ts = ts;
+  {
+    RowView view;
+    EXPECT_TRUE(page_->RangeScan(ts, opts, &view).ok());
+  }
+}
+
 TEST_F(VersionedBwTreePageTest, ForceCompactionTest) {
   auto value_list = GenerateValueList(100);
   Options opts;
@@ -500,6 +605,216 @@ TEST_F(VersionedBwTreePageTest, ForceCompactionTest) {
   }
 }
 
+TEST_F(VersionedBwTreePageTest, ReadHeatCompactionTest) {
+  TieredCompactionPolicy base_policy;
+  ReadHeatCompactionPolicy policy(&base_policy, 100);
+  Options opts;
+  opts.compaction_policy = &policy;
+  auto value_list = GenerateValueList(4);
+  auto write = [&](const ValueStruct &value) {
+    WriteInfo info;
+    auto s = WriteHelper(value, [&](const property::Row &row) {
+      return page_->SetRow(row, 1, opts, &info);
+    });
+    EXPECT_TRUE(s.ok());
+  };
+  for (int i = 0; i < 3; i++) {
+    write(value_list[i]);
+  }
+  // chain is cold and short, nothing happens.
+  auto stat = page_->GetCompactionStat();
+  EXPECT_EQ(stat.chain_length, 3);
+  EXPECT_EQ(stat.compaction_cnt, 0);
+  // read the oldest row, which traverses the whole chain.
+  auto sk = property::SortKeys({value_list[0].point_id, type_});
+  for (int i = 0; i < 50; i++) {
+    RowView view;
+    EXPECT_TRUE(page_->GetRow(sk.as_ref(), 1, opts, &view).ok());
+  }
+  EXPECT_EQ(page_->GetCompactionStat().read_cost, 100);
+  // chain is consolidated by next write.
+  write(value_list[3]);
+  page_->WaitForBackgroundCompaction();
+  stat = page_->GetCompactionStat();
+  EXPECT_EQ(stat.chain_length, 1);
+  EXPECT_EQ(stat.compaction_cnt, 1);
+  EXPECT_EQ(stat.read_cost, 0);
+  EXPECT_GT(stat.compaction_bytes, 0);
+  // reading consolidated chain costs nothing.
+  RowView view;
+  EXPECT_TRUE(page_->GetRow(sk.as_ref(), 1, opts, &view).ok());
+  EXPECT_EQ(page_->GetCompactionStat().read_cost, 0);
+}
+
+TEST_F(VersionedBwTreePageTest, PrependDuringCompactionTest) {
+  // blocks background compaction before it installs the compacted chain.
+  class BlockingPolicy : public TieredCompactionPolicy {
+  public:
+    BlockingPolicy() noexcept : TieredCompactionPolicy(4) {}
+
+    bool ShouldMerge(const DeltaChainStat &stat, size_t merged_rows,
+                     size_t next_rows) const noexcept override {
+      entered = true;
+      while (blocked) {
+        bthread_usleep(100);
+      }
+      return TieredCompactionPolicy::ShouldMerge(stat, merged_rows,
+                                                 next_rows);
+    }
+
+    mutable std::atomic_bool entered{false};
+    mutable std::atomic_bool blocked{true};
+  };
+  BlockingPolicy policy;
+  Options opts;
+  opts.compaction_policy = &policy;
+  auto value_list = GenerateValueList(20);
+  auto write = [&](const ValueStruct &value) {
+    WriteInfo info;
+    auto s = WriteHelper(value, [&](const property::Row &row) {
+      return page_->SetRow(row, 1, opts, &info);
+    });
+    EXPECT_TRUE(s.ok());
+  };
+  for (int i = 0; i < 5; i++) {
+    write(value_list[i]);
+  }
+  while (!policy.entered) {
+    bthread_usleep(100);
+  }
+  // prepend while compaction is in flight, installing compacted chain
+  // must fail and retry.
+  for (int i = 5; i < value_list.size(); i++) {
+    write(value_list[i]);
+  }
+  policy.blocked = false;
+  page_->WaitForBackgroundCompaction();
+  EXPECT_LE(page_->TEST_GetDeltaLength(), 4);
+  for (const auto &value : value_list) {
+    auto sk = property::SortKeys({value.point_id, value.point_type});
+    RowView view;
+    EXPECT_TRUE(page_->GetRow(sk.as_ref(), 1, opts_, &view).ok());
+    TestRead(view.at(0), value);
+  }
+}
+
+// counts appended records, lsn is the number of records.
+class CountingLogStore : public log_store::LogStore {
+public:
+  void AppendLogRecord(const LogRecordContainer &log_records,
+                       LogResultContainer *result) noexcept override {
+    // slow append, so that writers are queued and batched together.
+    bthread_usleep(100);
+    std::lock_guard<std::mutex> guard(mu_);
+    for (size_t i = 0; i < log_records.size(); i++) {
+      lsn_ += 1;
+      result->push_back(
+          log_store::LsnRange{.start_lsn = lsn_ - 1, .end_lsn = lsn_});
+    }
+  }
+
+  log_store::LsnType GetPersistentLsn() noexcept override {
+    std::lock_guard<std::mutex> guard(mu_);
+    return lsn_;
+  }
+
+  void WaitForPersist(log_store::LsnType lsn) noexcept override {}
+
+  void Truncate(log_store::LsnType lsn) noexcept override {}
+
+  Status GetLogReader(
+      std::unique_ptr<log_store::LogReader> *log_reader) noexcept override {
+    return Status::Ok();
+  }
+
+private:
+  std::mutex mu_;
+  log_store::LsnType lsn_{};
+};
+
+TEST_F(VersionedBwTreePageTest, GroupCommitLogStoreTest) {
+  CountingLogStore stores[2];
+  int worker_count = 8;
+  int write_cnt = 50;
+  std::mutex mu;
+  std::set<log_store::LsnType> lsn_sets[2];
+  util::WaitGroup wg(worker_count);
+  for (int i = 0; i < worker_count; i++) {
+    util::LaunchAsync([&, index = i]() {
+      // followers in the same batch write to different stores.
+      Options opts;
+      opts.log_store = &stores[index % 2];
+      for (int j = 0; j < write_cnt; j++) {
+        WriteInfo info;
+        ValueStruct value{
+            .point_id = index, .point_type = 0, .value = std::to_string(j)};
+        EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                      return page_->SetRow(row, j + 1, opts, &info);
+                    }).ok());
+        std::lock_guard<std::mutex> guard(mu);
+        // lsn is assigned by its own store.
+        EXPECT_TRUE(lsn_sets[index % 2].insert(info.lsn).second);
+      }
+      wg.Done();
+    });
+  }
+  wg.Wait();
+  for (int i = 0; i < 2; i++) {
+    EXPECT_EQ(stores[i].GetPersistentLsn(), worker_count / 2 * write_cnt);
+    EXPECT_EQ(*lsn_sets[i].rbegin(), worker_count / 2 * write_cnt);
+  }
+}
+
+TEST_F(VersionedBwTreePageTest, CollectGarbageTest) {
+  Options opts;
+  opts.force_compaction = true;
+  WriteInfo info;
+  std::vector<ValueStruct> value_list;
+  for (int i = 0; i < 100; i++) {
+    value_list.push_back(ValueStruct{
+        .point_id = 0, .point_type = 0, .value = std::to_string(i)});
+    auto s = WriteHelper(value_list.back(), [&](const property::Row &row) {
+      return page_->SetRow(row, i + 1, opts, &info);
+    });
+    EXPECT_TRUE(s.ok());
+  }
+  ValueStruct deleted{.point_id = 1, .point_type = 0, .value = ""};
+  auto deleted_sk = property::SortKeys({deleted.point_id, deleted.point_type});
+  EXPECT_TRUE(WriteHelper(deleted, [&](const property::Row &row) {
+                return page_->SetRow(row, 1, opts, &info);
+              }).ok());
+  EXPECT_TRUE(page_->DeleteRow(deleted_sk.as_ref(), 2, opts, &info).ok());
+  auto charge = page_->GetTotalCharge();
+
+  // nothing happens without watermark.
+  page_->CollectGarbage(opts);
+  EXPECT_EQ(page_->GetTotalCharge(), charge);
+
+  opts.gc_watermark = 90;
+  page_->CollectGarbage(opts);
+  EXPECT_EQ(page_->TEST_GetDeltaLength(), 1);
+  EXPECT_LT(page_->GetTotalCharge(), charge);
+  auto sk = property::SortKeys({value_list[0].point_id, type_});
+  for (int i = 0; i < 100; i++) {
+    RowView view;
+    auto s = page_->GetRow(sk.as_ref(), i + 1, opts_, &view);
+    if (i + 1 < 90) {
+      EXPECT_TRUE(s.IsNotFound()) << i << s.ToString();
+      continue;
+    }
+    ASSERT_TRUE(s.ok()) << i << s.ToString();
+    TestRead(view.at(0), value_list[i]);
+  }
+  // tombstone is removed as well.
+  RowView view;
+  EXPECT_TRUE(page_->GetRow(deleted_sk.as_ref(), 1, opts_, &view).IsNotFound());
+
+  // garbage has been collected, chain won't be rewritten again.
+  auto compaction_cnt = page_->GetCompactionStat().compaction_cnt;
+  page_->CollectGarbage(opts);
+  EXPECT_EQ(page_->GetCompactionStat().compaction_cnt, compaction_cnt);
+}
+
 TEST_F(VersionedBwTreePageTest, RowIteratorTest) {
   Options opts;
   opts.disable_compaction = true;
@@ -521,5 +836,51 @@ TEST_F(VersionedBwTreePageTest, RowIteratorTest) {
   EXPECT_FALSE(iterator.Valid());
 }
 
+TEST_F(VersionedBwTreePageTest, ConcurrentWriteWithSplitTest) {
+  int worker_count = 100;
+  int row_per_worker = 10;
+  auto right_page = std::make_unique<VersionedBwTreePage>("right_page");
+  util::WaitGroup wg(worker_count + 1);
+  for (int i = 0; i < worker_count; i++) {
+    util::LaunchAsync([&, index = i]() {
+      for (int j = 0; j < row_per_worker; j++) {
+        ValueStruct value{.point_id = index * row_per_worker + j,
+                          .point_type = 0,
+                          .value = "hello"};
+        auto s = WriteHelper(value, [&](const property::Row &row) {
+          WriteInfo info;
+          auto s = page_->SetRow(row, 1, opts_, &info);
+          if (s.IsPageIdNotMatch()) {
+            s = right_page->SetRow(row, 1, opts_, &info);
+          }
+          return s;
+        });
+        EXPECT_TRUE(s.ok());
+      }
+      wg.Done();
+    });
+  }
+  util::LaunchAsync([&]() {
+    property::SortKeys split_key{std::string_view()};
+    // wait until there are enough rows
+    while (!page_->Split(right_page.get(), &split_key).ok()) {
+      bthread_usleep(100);
+    }
+    wg.Done();
+  });
+  wg.Wait();
+  // every row should be found either in current page or right page.
+  for (int i = 0; i < worker_count * row_per_worker; i++) {
+    auto sk = property::SortKeys({static_cast<int64_t>(i), type_});
+    RowView view;
+    auto s = page_->GetRow(sk.as_ref(), 1, opts_, &view);
+    if (s.IsPageIdNotMatch()) {
+      EXPECT_EQ(page_->GetRightPageId(), "right_page");
+      s = right_page->GetRow(sk.as_ref(), 1, opts_, &view);
+    }
+    EXPECT_TRUE(s.ok());
+  }
+}
+
 } // namespace btree
 } // namespace arcanedb
\ No newline at end of file
@@ -183,6 +183,65 @@ TEST_F(VersionedDeltaNodeTest, PointReadTest) {
   }
 }
 
+TEST_F(VersionedDeltaNodeTest, KeyPrefixSearchTest) {
+  VersionedDeltaNodeBuilder builder;
+  std::vector<std::shared_ptr<VersionedDeltaNode>> deltas;
+  TxnTs ts = 1;
+  for (int i = 0; i < 1000; i++) {
+    ValueStruct value{
+        .point_id = i * 3, .point_type = i % 2, .value = std::to_string(i)};
+    auto node = MakeDelta(value, false, ts);
+    deltas.push_back(node);
+    builder.AddDeltaNode(node.get());
+  }
+  auto compacted = builder.GenerateDeltaNode();
+  for (int i = -10; i < 3010; i++) {
+    for (int type = 0; type < 2; type++) {
+      ValueStruct value{.point_id = i,
+                        .point_type = type,
+                        .value = std::to_string(i / 3)};
+      auto sk = property::SortKeys({value.point_id, value.point_type});
+      RowView view;
+      auto s = compacted->GetRow(sk.as_ref(), ts, opts_, &view);
+      if (i >= 0 && i < 3000 && i % 3 == 0 && (i / 3) % 2 == type) {
+        ASSERT_TRUE(s.ok()) << i << s.ToString();
+        TestRead(&view, value);
+      } else {
+        EXPECT_TRUE(s.IsNotFound()) << i << s.ToString();
+      }
+    }
+  }
+}
+
+TEST_F(VersionedDeltaNodeTest, FilterTest) {
+  VersionedDeltaNodeBuilder builder;
+  auto value_list = GenerateValueList(100);
+  std::vector<std::shared_ptr<VersionedDeltaNode>> deltas;
+  for (const auto &value : value_list) {
+    auto node = MakeDelta(value, false, 1);
+    // single row node contains everything.
+    auto sk = property::SortKeys({value.point_id + 1000, value.point_type});
+    std::optional<uint64_t> hash;
+    EXPECT_TRUE(node->MayContain(sk.as_ref(), &hash));
+    deltas.push_back(node);
+    builder.AddDeltaNode(node.get());
+  }
+  auto compacted = builder.GenerateDeltaNode();
+  for (const auto &value : value_list) {
+    auto sk = property::SortKeys({value.point_id, value.point_type});
+    std::optional<uint64_t> hash;
+    EXPECT_TRUE(compacted->MayContain(sk.as_ref(), &hash));
+    EXPECT_TRUE(hash.has_value());
+  }
+  int false_positive = 0;
+  for (int i = 1000; i < 2000; i++) {
+    auto sk = property::SortKeys({static_cast<int64_t>(i), type_});
+    std::optional<uint64_t> hash;
+    false_positive += compacted->MayContain(sk.as_ref(), &hash);
+  }
+  EXPECT_LT(false_positive, 50);
+}
+
 TEST_F(VersionedDeltaNodeTest, LockTest) {
   TxnTs ts = 1;
   ts = MarkLocked(ts);
@@ -245,5 +304,35 @@ TEST_F(VersionedDeltaNodeTest, LockOwnerTest) {
   TestRead(&view, value);
 }
 
+TEST_F(VersionedDeltaNodeTest, RemoveStaleVersionsTest) {
+  VersionedDeltaNodeBuilder builder;
+  std::vector<ValueStruct> value_list(100);
+  std::vector<std::shared_ptr<VersionedDeltaNode>> deltas;
+  for (int i = 99; i >= 0; i--) {
+    value_list[i] =
+        ValueStruct{.point_id = 0, .point_type = 0, .value = std::to_string(i)};
+    auto node = MakeDelta(value_list[i], false, i + 1);
+    deltas.push_back(node);
+    builder.AddDeltaNode(node.get());
+  }
+  TxnTs watermark = 50;
+  EXPECT_TRUE(builder.GenerateDeltaNode()->HasGarbage(watermark));
+  builder.RemoveStaleVersions(watermark);
+  auto compacted = builder.GenerateDeltaNode();
+  EXPECT_FALSE(compacted->HasGarbage(watermark));
+  auto sk =
+      property::SortKeys({value_list[0].point_id, value_list[0].point_type});
+  for (int i = 0; i < 100; i++) {
+    RowView view;
+    auto s = compacted->GetRow(sk.as_ref(), i + 1, opts_, &view);
+    if (i + 1 < watermark) {
+      EXPECT_TRUE(s.IsNotFound()) << i << s.ToString();
+      continue;
+    }
+    ASSERT_TRUE(s.ok()) << i << s.ToString();
+    TestRead(&view, value_list[i]);
+  }
+}
+
 } // namespace btree
 } // namespace arcanedb
\ No newline at end of file
@@ -89,6 +89,96 @@ TEST_F(WeightedGraphDBTest, EdgeTest) {
   }
 }
 
+TEST_F(WeightedGraphDBTest, RecoveryTest) {
+  std::string db_name = "test_recovery_db";
+  WeightedGraphDB::Destroy(db_name);
+  WeightedGraphOptions graph_opts;
+  graph_opts.enable_wal = true;
+  graph_opts.enable_flush = true;
+  graph_opts.only_single_edge_txn = false;
+  // keep memory footprint of log partitions small.
+  graph_opts.log_options.segment_num = 2;
+  graph_opts.log_options.segment_size = 1 << 20;
+  Options opts;
+  opts.sync_commit = true;
+  // split out edges of vertex 0.
+  opts.page_split_threshold = 4096;
+  std::unique_ptr<WeightedGraphDB> db;
+  EXPECT_TRUE(WeightedGraphDB::Open(db_name, &db, graph_opts).ok());
+  for (int i = 0; i < 100; i++) {
+    auto txn = db->BeginRwTxn(opts);
+    EXPECT_TRUE(txn->InsertVertex(i, std::to_string(i)).ok());
+    EXPECT_TRUE(txn->Commit().IsCommit());
+  }
+  for (int i = 0; i < 100; i += 2) {
+    auto txn = db->BeginRwTxn(opts);
+    EXPECT_TRUE(txn->DeleteVertex(i).ok());
+    EXPECT_TRUE(txn->Commit().IsCommit());
+  }
+  auto edge_value = [](int dst) { return std::string(16, 'a' + dst % 26); };
+  for (int i = 0; i < 200; i++) {
+    auto txn = db->BeginRwTxn(opts);
+    EXPECT_TRUE(txn->InsertEdge(0, i, edge_value(i)).ok());
+    EXPECT_TRUE(txn->Commit().IsCommit());
+  }
+  auto check = [&]() {
+    for (int i = 0; i < 100; i++) {
+      auto txn = db->BeginRoTxn(opts);
+      std::string value;
+      if (i % 2 == 0) {
+        EXPECT_TRUE(txn->GetVertex(i, &value).IsNotFound());
+      } else {
+        EXPECT_TRUE(txn->GetVertex(i, &value).ok());
+        EXPECT_EQ(value, std::to_string(i));
+      }
+      EXPECT_TRUE(txn->Commit().IsCommit());
+    }
+    for (int i = 0; i < 200; i++) {
+      auto txn = db->BeginRoTxn(opts);
+      std::string value;
+      EXPECT_TRUE(txn->GetEdge(0, i, &value).ok());
+      EXPECT_EQ(value, edge_value(i));
+      EXPECT_TRUE(txn->Commit().IsCommit());
+    }
+  };
+  auto version_count = [&](int vertex) {
+    cache::BufferPool::PageHolder page;
+    auto s = db->TEST_GetBufferPool()->GetPage(
+        WeightedGraphDB::VertexEncoding(vertex), &page);
+    EXPECT_TRUE(s.ok());
+    size_t count = 0;
+    for (auto iter = page->GetRowIterator(); iter.Valid(); iter.Next()) {
+      count += 1;
+    }
+    return count;
+  };
+  check();
+  // reopen and replay log, versions persisted in pages are not replayed
+  // again.
+  for (int round = 0; round < 2; round++) {
+    db->TEST_GetBufferPool()->ForceFlushAllPages();
+    db.reset();
+    EXPECT_TRUE(WeightedGraphDB::Open(db_name, &db, graph_opts).ok());
+    check();
+    EXPECT_EQ(version_count(1), 1);
+  }
+  // new txns are ordered after recovered ones.
+  {
+    auto txn = db->BeginRwTxn(opts);
+    EXPECT_TRUE(txn->InsertVertex(0, "new").ok());
+    EXPECT_TRUE(txn->Commit().IsCommit());
+  }
+  {
+    auto txn = db->BeginRoTxn(opts);
+    std::string value;
+    EXPECT_TRUE(txn->GetVertex(0, &value).ok());
+    EXPECT_EQ(value, "new");
+    EXPECT_TRUE(txn->Commit().IsCommit());
+  }
+  db.reset();
+  WeightedGraphDB::Destroy(db_name);
+}
+
 TEST_F(WeightedGraphDBTest, ConcurrentTest) {
   // 10 worker insert vertex
   // 10 worker insert edge
@@ -132,6 +222,42 @@ TEST_F(WeightedGraphDBTest, ConcurrentTest) {
   wg.Wait();
 }
 
+TEST_F(WeightedGraphDBTest, VersionSweeperTest) {
+  Options opts;
+  // stale versions are only collected by sweeper.
+  opts.disable_compaction = true;
+  {
+    auto txn = db_->BeginRwTxn(opts);
+    EXPECT_TRUE(txn->InsertVertex(1, "0").ok());
+    EXPECT_TRUE(txn->Commit().IsCommit());
+  }
+  auto charge = [&]() {
+    cache::BufferPool::PageHolder page;
+    EXPECT_TRUE(db_->TEST_GetBufferPool()
+                    ->GetPage(WeightedGraphDB::VertexEncoding(1), &page)
+                    .ok());
+    return page->GetTotalCharge();
+  };
+  // old versions are pinned by active reader.
+  auto reader = db_->BeginRoTxn(opts);
+  for (int i = 1; i <= 100; i++) {
+    auto txn = db_->BeginRwTxn(opts);
+    EXPECT_TRUE(txn->InsertVertex(1, std::to_string(i)).ok());
+    EXPECT_TRUE(txn->Commit().IsCommit());
+  }
+  std::string value;
+  EXPECT_TRUE(reader->GetVertex(1, &value).ok());
+  EXPECT_EQ(value, "0");
+  auto pinned_charge = charge();
+  reader.reset();
+
+  db_->TEST_GetVersionSweeper()->SweepOnce();
+  EXPECT_LT(charge(), pinned_charge);
+  reader = db_->BeginRoTxn(opts);
+  EXPECT_TRUE(reader->GetVertex(1, &value).ok());
+  EXPECT_EQ(value, "100");
+}
+
 TEST_F(WeightedGraphDBTest, EdgeIteratorTest) {
   for (int i = 0; i < 10; i++) {
     for (int j = 0; j < 10; j++) {
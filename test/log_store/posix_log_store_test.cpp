@@ -17,7 +17,10 @@
 #include "util/bthread_util.h"
 #include "util/time.h"
 #include "util/wait_group.h"
+#include <cstdio>
 #include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace arcanedb {
 namespace log_store {
@@ -63,13 +66,16 @@ TEST(PosixLogStoreTest, LogSegmentControlBitTest) {
   EXPECT_EQ(LogSegment::GetWriterNum_(control_bit), 0);
 }
 
-std::shared_ptr<LogStore> GenerateLogStore(size_t segment_size = 4096) {
+std::shared_ptr<LogStore> GenerateLogStore(
+    size_t segment_size = 4096,
+    size_t log_file_size = common::Config::kLogFileDefaultSize) {
   auto log_store_name = "test_log_store";
   std::shared_ptr<LogStore> store;
   Options options;
   auto s = PosixLogStore::Destory(log_store_name);
   EXPECT_EQ(s, Status::Ok());
   options.segment_size = segment_size;
+  options.log_file_size = log_file_size;
   s = PosixLogStore::Open(log_store_name, options, &store);
   EXPECT_EQ(s, Status::Ok());
   return store;
@@ -200,5 +206,249 @@ TEST(PosixLogStoreTest, ConcurrentAppendLogTest) {
   EXPECT_EQ(log_reader->HasNext(), false);
 }
 
+TEST(PosixLogStoreTest, TruncateTest) {
+  // rotate log file after each io.
+  auto store = GenerateLogStore(32, 1);
+  std::vector<std::string> owner = {std::string(15, 'a'), std::string(15, 'b'),
+                                    std::string(15, 'c')};
+  std::vector<LsnType> end_lsn;
+  for (int i = 0; i < 3; i++) {
+    LogStore::LogRecordContainer log_records(1);
+    log_records[0] = owner[i];
+    LogStore::LogResultContainer result;
+    store->AppendLogRecord(log_records, &result);
+    end_lsn.push_back(result.back().end_lsn);
+    WaitLsn(store, end_lsn.back());
+  }
+
+  auto check_reader = [&](int start) {
+    auto log_reader = GetLogReader(store);
+    for (int i = start; i < 3; i++) {
+      EXPECT_TRUE(log_reader->HasNext());
+      std::string bytes;
+      log_reader->GetNextLogRecord(&bytes);
+      EXPECT_EQ(bytes, owner[i]);
+    }
+    EXPECT_EQ(log_reader->HasNext(), false);
+  };
+  // records are read across files.
+  check_reader(0);
+  // file is kept until all records in it could be truncated.
+  store->Truncate(end_lsn[0] - 1);
+  check_reader(0);
+  store->Truncate(end_lsn[0]);
+  check_reader(1);
+  store->Truncate(kMaxLsn);
+  check_reader(3);
+
+  // log file being written is kept.
+  LogStore::LogRecordContainer log_records = {"arcanedb"};
+  LogStore::LogResultContainer result;
+  store->AppendLogRecord(log_records, &result);
+  WaitLsn(store, result.back().end_lsn);
+  auto log_reader = GetLogReader(store);
+  EXPECT_TRUE(log_reader->HasNext());
+  std::string bytes;
+  log_reader->GetNextLogRecord(&bytes);
+  EXPECT_EQ(bytes, log_records[0]);
+  EXPECT_EQ(log_reader->HasNext(), false);
+}
+
+TEST(PosixLogStoreTest, GroupCommitTest) {
+  auto log_store_name = "test_log_store";
+  std::shared_ptr<LogStore> store;
+  Options options;
+  EXPECT_EQ(PosixLogStore::Destory(log_store_name), Status::Ok());
+  // logs nobody waits for are delayed until bytes threshold is reached.
+  options.max_flush_interval = 10 * util::Second;
+  options.flush_bytes_threshold = 64;
+  EXPECT_EQ(PosixLogStore::Open(log_store_name, options, &store),
+            Status::Ok());
+  LogStore::LogRecordContainer log_records = {"arcanedb"};
+  LogStore::LogResultContainer result;
+  store->AppendLogRecord(log_records, &result);
+  bthread_usleep(20 * util::MillSec);
+  EXPECT_LT(store->GetPersistentLsn(), result.back().end_lsn);
+
+  // waiter triggers sealing.
+  store->WaitForPersist(result.back().end_lsn);
+  EXPECT_GE(store->GetPersistentLsn(), result.back().end_lsn);
+
+  // bytes threshold triggers sealing.
+  std::string large(64, 'a');
+  LsnType lsn = 0;
+  for (int i = 0; i < 10; i++) {
+    store->AppendLogRecord({large}, &result);
+    lsn = result.back().end_lsn;
+  }
+  WaitLsn(store, lsn);
+
+  auto log_reader = GetLogReader(store);
+  for (int i = 0; i < 11; i++) {
+    EXPECT_TRUE(log_reader->HasNext());
+    std::string bytes;
+    log_reader->GetNextLogRecord(&bytes);
+    EXPECT_EQ(bytes, i == 0 ? log_records[0] : large);
+  }
+  EXPECT_EQ(log_reader->HasNext(), false);
+}
+
+TEST(PosixLogStoreTest, CorruptedLogTest) {
+  auto store = GenerateLogStore();
+  LogStore::LogRecordContainer log_records = {"123", "456", "789"};
+  LogStore::LogResultContainer result;
+  store->AppendLogRecord(log_records, &result);
+  WaitLsn(store, result.back().end_lsn);
+
+  auto read_all = [&]() {
+    std::vector<std::string> records;
+    auto log_reader = GetLogReader(store);
+    while (log_reader->HasNext()) {
+      std::string bytes;
+      log_reader->GetNextLogRecord(&bytes);
+      records.push_back(std::move(bytes));
+    }
+    return records;
+  };
+  EXPECT_EQ(read_all().size(), 3);
+
+  // torn write of last record.
+  std::string filename = "test_log_store/LOG_0";
+  EXPECT_EQ(::truncate(filename.c_str(), result[2].end_lsn - 1), 0);
+  EXPECT_EQ(read_all(), std::vector<std::string>({"123", "456"}));
+
+  // corrupt data of second record.
+  auto file = fopen(filename.c_str(), "r+b");
+  ASSERT_NE(file, nullptr);
+  fseek(file, result[1].start_lsn + LogRecord::kHeaderSize, SEEK_SET);
+  fputc('x', file);
+  fclose(file);
+  EXPECT_EQ(read_all(), std::vector<std::string>({"123"}));
+}
+
+TEST(PosixLogStoreTest, ReopenTest) {
+  auto log_store_name = "test_log_store";
+  auto store = GenerateLogStore();
+  LogStore::LogRecordContainer log_records = {"123", "456", "789"};
+  LogStore::LogResultContainer result;
+  store->AppendLogRecord(log_records, &result);
+  WaitLsn(store, result.back().end_lsn);
+  store.reset();
+
+  // torn write of last record is cut off when reopening.
+  EXPECT_EQ(::truncate("test_log_store/LOG_0", result[2].end_lsn - 1), 0);
+  Options options;
+  EXPECT_EQ(PosixLogStore::Open(log_store_name, options, &store),
+            Status::Ok());
+  auto next_lsn = result[1].end_lsn;
+  EXPECT_EQ(store->GetPersistentLsn(), next_lsn);
+  store->AppendLogRecord({"abc"}, &result);
+  EXPECT_EQ(result[0].start_lsn, next_lsn);
+  WaitLsn(store, result.back().end_lsn);
+
+  // existing records are followed by new ones.
+  std::vector<std::string> records;
+  auto log_reader = GetLogReader(store);
+  while (log_reader->HasNext()) {
+    std::string bytes;
+    log_reader->GetNextLogRecord(&bytes);
+    records.push_back(std::move(bytes));
+  }
+  EXPECT_EQ(records, std::vector<std::string>({"123", "456", "abc"}));
+}
+
+TEST(PosixLogStoreTest, CorruptedReopenTest) {
+  auto log_store_name = "test_log_store";
+  // rotate log file after each io.
+  auto store = GenerateLogStore(32, 1);
+  std::vector<std::string> owner = {std::string(15, 'a'), std::string(15, 'b'),
+                                    std::string(15, 'c')};
+  std::vector<LsnType> end_lsn;
+  for (int i = 0; i < 3; i++) {
+    LogStore::LogResultContainer result;
+    store->AppendLogRecord({owner[i]}, &result);
+    end_lsn.push_back(result.back().end_lsn);
+    WaitLsn(store, end_lsn.back());
+  }
+  store.reset();
+
+  auto overwrite = [](const std::string &filename, size_t offset, char c) {
+    auto file = fopen(filename.c_str(), "r+b");
+    ASSERT_NE(file, nullptr);
+    fseek(file, offset, SEEK_SET);
+    fputc(c, file);
+    fclose(file);
+  };
+  auto file_size = [](const std::string &filename) {
+    struct stat file_stat;
+    EXPECT_EQ(::stat(filename.c_str(), &file_stat), 0);
+    return file_stat.st_size;
+  };
+  Options options;
+  options.segment_size = 32;
+  options.log_file_size = 1;
+
+  // corruption before the tail fails open, and nothing is removed.
+  auto middle_file = "test_log_store/LOG_" + std::to_string(end_lsn[0]);
+  overwrite(middle_file, LogRecord::kHeaderSize, 'x');
+  EXPECT_EQ(PosixLogStore::Open(log_store_name, options, &store),
+            Status::Err());
+  EXPECT_EQ(file_size("test_log_store/LOG_0"), end_lsn[0]);
+  EXPECT_EQ(file_size(middle_file), end_lsn[1] - end_lsn[0]);
+
+  // zeros in the last file are torn tail.
+  overwrite(middle_file, LogRecord::kHeaderSize, 'b');
+  auto last_file = "test_log_store/LOG_" + std::to_string(end_lsn[2]);
+  overwrite(last_file, 64, 0);
+  EXPECT_EQ(PosixLogStore::Open(log_store_name, options, &store),
+            Status::Ok());
+  EXPECT_EQ(store->GetPersistentLsn(), end_lsn[2]);
+  EXPECT_EQ(file_size(last_file), 0);
+  auto log_reader = GetLogReader(store);
+  for (int i = 0; i < 3; i++) {
+    EXPECT_TRUE(log_reader->HasNext());
+    std::string bytes;
+    log_reader->GetNextLogRecord(&bytes);
+    EXPECT_EQ(bytes, owner[i]);
+  }
+  EXPECT_EQ(log_reader->HasNext(), false);
+}
+
+TEST(PosixLogStoreTest, CompressionTest) {
+  auto log_store_name = "test_log_store";
+  std::shared_ptr<LogStore> store;
+  Options options;
+  EXPECT_EQ(PosixLogStore::Destory(log_store_name), Status::Ok());
+  options.segment_size = 1024;
+  options.compression = CompressionType::kSnappyCompression;
+  EXPECT_EQ(PosixLogStore::Open(log_store_name, options, &store),
+            Status::Ok());
+  std::vector<std::string> owner;
+  LsnType lsn = 0;
+  for (int i = 0; i < 100; i++) {
+    owner.push_back(std::string(100, 'a' + i % 26));
+    LogStore::LogRecordContainer log_records = {owner.back()};
+    LogStore::LogResultContainer result;
+    store->AppendLogRecord(log_records, &result);
+    lsn = result.back().end_lsn;
+  }
+  WaitLsn(store, lsn);
+
+  // repeated bytes are compressed.
+  struct stat file_stat;
+  ASSERT_EQ(::stat("test_log_store/LOG_0", &file_stat), 0);
+  EXPECT_LT(file_stat.st_size, lsn);
+
+  // decompressed transparently.
+  auto log_reader = GetLogReader(store);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_TRUE(log_reader->HasNext());
+    std::string bytes;
+    log_reader->GetNextLogRecord(&bytes);
+    EXPECT_EQ(bytes, owner[i]);
+  }
+  EXPECT_EQ(log_reader->HasNext(), false);
+}
+
 } // namespace log_store
 } // namespace arcanedb
\ No newline at end of file
@@ -11,6 +11,7 @@
 
 #include "common/lock_table.h"
 #include "util/bthread_util.h"
+#include <atomic>
 #include <gtest/gtest.h>
 
 namespace arcanedb {
@@ -49,5 +50,119 @@ TEST(LockTableTest, TimeoutTest) {
       table.LockFor(sk1.as_ref().as_slice(), txn2, 10 * util::MillSec).IsOk());
 }
 
+TEST(LockTableTest, WaitDieTest) {
+  LockTable table;
+  auto sk1 = property::SortKeys({1, 2, 3});
+  auto sk2 = property::SortKeys({4, 5, 6});
+  TxnId txn1 = 0;
+  TxnId txn2 = 1;
+  // txn1 is older than txn2.
+  EXPECT_TRUE(table.LockWaitDie(sk1.as_ref().as_slice(), txn1, 1).ok());
+  EXPECT_TRUE(table.LockWaitDie(sk2.as_ref().as_slice(), txn2, 2).ok());
+  auto future = util::LaunchAsync([&]() {
+    // older txn waits for younger one.
+    util::Timer timer;
+    EXPECT_TRUE(table.LockWaitDie(sk2.as_ref().as_slice(), txn1, 1).ok());
+    EXPECT_GT(timer.GetElapsed(), 5 * util::MillSec);
+  });
+  bthread_usleep(10 * util::MillSec);
+  // younger txn dies instead of forming deadlock.
+  EXPECT_TRUE(table.LockWaitDie(sk1.as_ref().as_slice(), txn2, 2).IsAbort());
+  EXPECT_TRUE(table.Unlock(sk2.as_ref().as_slice(), txn2).ok());
+  future->Wait();
+  EXPECT_TRUE(table.Unlock(sk1.as_ref().as_slice(), txn1).ok());
+  EXPECT_TRUE(table.Unlock(sk2.as_ref().as_slice(), txn1).ok());
+  EXPECT_TRUE(table.LockWaitDie(sk1.as_ref().as_slice(), txn2, 2).ok());
+}
+
+TEST(LockTableTest, SharedLockTest) {
+  LockTable table;
+  auto sk1 = property::SortKeys({1, 2, 3});
+  TxnId txn1 = 0;
+  TxnId txn2 = 1;
+  TxnId txn3 = 2;
+  TxnId txn4 = 3;
+  // readers won't block each other.
+  EXPECT_TRUE(table.Lock(sk1.as_ref().as_slice(), txn1, LockType::RLock).ok());
+  EXPECT_TRUE(table.Lock(sk1.as_ref().as_slice(), txn2, LockType::RLock).ok());
+  std::atomic_bool writer_granted{false};
+  auto writer = util::LaunchAsync([&]() {
+    EXPECT_TRUE(table.Lock(sk1.as_ref().as_slice(), txn3).ok());
+    writer_granted = true;
+    bthread_usleep(10 * util::MillSec);
+    EXPECT_TRUE(table.Unlock(sk1.as_ref().as_slice(), txn3).ok());
+  });
+  bthread_usleep(10 * util::MillSec);
+  // reader arrived after writer is queued behind it.
+  auto reader = util::LaunchAsync([&]() {
+    EXPECT_TRUE(
+        table.Lock(sk1.as_ref().as_slice(), txn4, LockType::RLock).ok());
+    EXPECT_TRUE(writer_granted);
+    EXPECT_TRUE(table.Unlock(sk1.as_ref().as_slice(), txn4).ok());
+  });
+  bthread_usleep(10 * util::MillSec);
+  EXPECT_FALSE(writer_granted);
+  EXPECT_TRUE(table.Unlock(sk1.as_ref().as_slice(), txn1).ok());
+  EXPECT_TRUE(table.Unlock(sk1.as_ref().as_slice(), txn2).ok());
+  writer->Wait();
+  reader->Wait();
+}
+
+TEST(LockTableTest, UpgradeTest) {
+  LockTable table;
+  auto sk1 = property::SortKeys({1, 2, 3});
+  TxnId txn1 = 0;
+  TxnId txn2 = 1;
+  TxnId txn3 = 2;
+  // sole reader upgrades immediately.
+  EXPECT_TRUE(table.Lock(sk1.as_ref().as_slice(), txn1, LockType::RLock).ok());
+  EXPECT_TRUE(table.Lock(sk1.as_ref().as_slice(), txn1, LockType::WLock).ok());
+  EXPECT_TRUE(table.Unlock(sk1.as_ref().as_slice(), txn1).ok());
+
+  EXPECT_TRUE(table.Lock(sk1.as_ref().as_slice(), txn1, LockType::RLock).ok());
+  EXPECT_TRUE(table.Lock(sk1.as_ref().as_slice(), txn2, LockType::RLock).ok());
+  std::atomic_bool writer_granted{false};
+  auto writer = util::LaunchAsync([&]() {
+    // queued before upgrader.
+    EXPECT_TRUE(table.Lock(sk1.as_ref().as_slice(), txn3).ok());
+    writer_granted = true;
+    EXPECT_TRUE(table.Unlock(sk1.as_ref().as_slice(), txn3).ok());
+  });
+  bthread_usleep(10 * util::MillSec);
+  auto upgrader = util::LaunchAsync([&]() {
+    // upgrade waits for txn2, and is granted before writer.
+    EXPECT_TRUE(
+        table.Lock(sk1.as_ref().as_slice(), txn1, LockType::WLock).ok());
+    EXPECT_FALSE(writer_granted);
+    EXPECT_TRUE(table.Unlock(sk1.as_ref().as_slice(), txn1).ok());
+  });
+  bthread_usleep(10 * util::MillSec);
+  // concurrent upgrade would deadlock.
+  EXPECT_TRUE(
+      table.Lock(sk1.as_ref().as_slice(), txn2, LockType::WLock).IsAbort());
+  EXPECT_TRUE(table.Unlock(sk1.as_ref().as_slice(), txn2).ok());
+  upgrader->Wait();
+  writer->Wait();
+}
+
+TEST(LockTableTest, RelockTest) {
+  LockTable table;
+  auto sk1 = property::SortKeys({1, 2, 3});
+  TxnId txn1 = 0;
+  TxnId txn2 = 1;
+  EXPECT_TRUE(table.Lock(sk1.as_ref().as_slice(), txn1).ok());
+  // exclusive lock covers both modes.
+  EXPECT_TRUE(table.Lock(sk1.as_ref().as_slice(), txn1).ok());
+  EXPECT_TRUE(table.Lock(sk1.as_ref().as_slice(), txn1, LockType::RLock).ok());
+  EXPECT_TRUE(table.Unlock(sk1.as_ref().as_slice(), txn1).ok());
+
+  EXPECT_TRUE(table.Lock(sk1.as_ref().as_slice(), txn1, LockType::RLock).ok());
+  EXPECT_TRUE(table.Lock(sk1.as_ref().as_slice(), txn1, LockType::RLock).ok());
+  EXPECT_TRUE(table.Unlock(sk1.as_ref().as_slice(), txn1).ok());
+  // lock is released by single unlock.
+  EXPECT_TRUE(table.LockFor(sk1.as_ref().as_slice(), txn2, 0).ok());
+  EXPECT_TRUE(table.Unlock(sk1.as_ref().as_slice(), txn2).ok());
+}
+
 } // namespace common
 } // namespace arcanedb
\ No newline at end of file
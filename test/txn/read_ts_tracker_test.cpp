@@ -0,0 +1,74 @@
+/**
+ * @file read_ts_tracker_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-19
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "txn/read_ts_tracker.h"
+#include "util/bthread_util.h"
+#include "util/wait_group.h"
+#include <gtest/gtest.h>
+
+namespace arcanedb {
+namespace txn {
+
+TEST(ReadTsTrackerTest, BasicTest) {
+  ReadTsTracker tracker(4);
+  EXPECT_EQ(tracker.GetMinReadTs(100), 100);
+  EXPECT_EQ(tracker.Register(0, []() { return 10; }), 10);
+  EXPECT_EQ(tracker.Register(1, []() { return 5; }), 5);
+  // same ts could be registered by different txns.
+  EXPECT_EQ(tracker.Register(2, []() { return 5; }), 5);
+  EXPECT_EQ(tracker.GetMinReadTs(100), 5);
+  EXPECT_EQ(tracker.GetMinReadTs(3), 3);
+  tracker.Unregister(1, 5);
+  EXPECT_EQ(tracker.GetMinReadTs(100), 5);
+  tracker.Unregister(2, 5);
+  EXPECT_EQ(tracker.GetMinReadTs(100), 10);
+  tracker.Unregister(0, 10);
+  EXPECT_EQ(tracker.GetMinReadTs(100), 100);
+}
+
+TEST(ReadTsTrackerTest, ConcurrentTest) {
+  // fewer slots than workers, so that some of them wait for free slots.
+  ReadTsTracker tracker(8);
+  std::atomic<TxnTs> snapshot_ts{1};
+  int worker_cnt = 16;
+  int txn_per_worker = 1000;
+  util::WaitGroup wg(worker_cnt);
+  std::atomic_bool stop{false};
+  auto checker = util::LaunchAsync([&]() {
+    while (!stop.load()) {
+      // bound must be acquired before scanning.
+      auto bound = snapshot_ts.load();
+      auto watermark = tracker.GetMinReadTs(bound);
+      EXPECT_LE(watermark, bound);
+    }
+  });
+  for (int i = 0; i < worker_cnt; i++) {
+    util::LaunchAsync([&, index = i]() {
+      for (int j = 0; j < txn_per_worker; j++) {
+        TxnId txn_id = index * txn_per_worker + j;
+        auto read_ts = tracker.Register(txn_id, [&]() {
+          return snapshot_ts.fetch_add(1);
+        });
+        // versions visible to active txn are never collected.
+        EXPECT_LE(tracker.GetMinReadTs(snapshot_ts.load()), read_ts);
+        tracker.Unregister(txn_id, read_ts);
+      }
+      wg.Done();
+    });
+  }
+  wg.Wait();
+  stop = true;
+  checker->Wait();
+  EXPECT_EQ(tracker.GetMinReadTs(snapshot_ts.load()), snapshot_ts.load());
+}
+
+} // namespace txn
+} // namespace arcanedb
@@ -0,0 +1,125 @@
+/**
+ * @file snapshot_manager_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-17
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "txn/snapshot_manager.h"
+#include "bthread/bthread.h"
+#include "txn/tso.h"
+#include "util/bthread_util.h"
+#include "util/wait_group.h"
+#include <gtest/gtest.h>
+
+namespace arcanedb {
+namespace txn {
+
+TEST(ShardedSnapshotManagerTest, BasicTest) {
+  ShardedSnapshotManager manager(4);
+  EXPECT_EQ(manager.GetSnapshotTs(), 0);
+  for (TxnTs ts = 1; ts <= 10; ts++) {
+    manager.RegisterTs(ts);
+  }
+  // snapshot is blocked by the oldest uncommitted ts.
+  for (TxnTs ts = 10; ts >= 2; ts--) {
+    manager.CommitTs(ts);
+    EXPECT_EQ(manager.GetSnapshotTs(), 0);
+  }
+  manager.CommitTs(1);
+  EXPECT_EQ(manager.GetSnapshotTs(), 10);
+  manager.RegisterTs(11);
+  manager.RegisterTs(12);
+  manager.CommitTs(12);
+  EXPECT_EQ(manager.GetSnapshotTs(), 10);
+  manager.CommitTs(11);
+  EXPECT_EQ(manager.GetSnapshotTs(), 12);
+}
+
+TEST(ShardedSnapshotManagerTest, ConcurrentTest) {
+  ShardedSnapshotManager manager(4);
+  Tso tso;
+  int worker_cnt = 16;
+  int commit_per_worker = 1000;
+  util::WaitGroup wg(worker_cnt);
+  std::atomic<TxnTs> max_ts{0};
+  for (int i = 0; i < worker_cnt; i++) {
+    util::LaunchAsync([&]() {
+      TxnTs last_snapshot = 0;
+      for (int j = 0; j < commit_per_worker; j++) {
+        TxnTs ts;
+        {
+          // register in ts order, like txns acquiring commit ts.
+          static ArcanedbLock mu;
+          ArcanedbLockGuard<ArcanedbLock> guard(mu);
+          ts = tso.RequestTs();
+          manager.RegisterTs(ts);
+        }
+        // uncommitted ts is never visible.
+        auto snapshot_ts = manager.GetSnapshotTs();
+        EXPECT_LT(snapshot_ts, ts);
+        EXPECT_GE(snapshot_ts, last_snapshot);
+        last_snapshot = snapshot_ts;
+        manager.CommitTs(ts);
+      }
+      wg.Done();
+    });
+  }
+  wg.Wait();
+  EXPECT_EQ(manager.GetSnapshotTs(), worker_cnt * commit_per_worker);
+}
+
+TEST(LinkBufSnapshotManagerTest, OverflowTest) {
+  LinkBufSnapshotManager manager(16);
+  EXPECT_EQ(manager.GetSnapshotTs(), 0);
+  // ts 1 is held by a long running txn.
+  for (TxnTs ts = 2; ts <= 100; ts++) {
+    manager.CommitTs(ts);
+    EXPECT_EQ(manager.GetSnapshotTs(), 0);
+  }
+  EXPECT_GT(manager.TEST_GetOverflowCount(), 0);
+  manager.CommitTs(1);
+  EXPECT_EQ(manager.GetSnapshotTs(), 100);
+  EXPECT_EQ(manager.TEST_GetOverflowCount(), 0);
+}
+
+TEST(LinkBufSnapshotManagerTest, LaggingTailTest) {
+  LinkBufSnapshotManager manager(16);
+  manager.CommitTs(1);
+  EXPECT_EQ(manager.GetSnapshotTs(), 1);
+  // committer of ts 2 gives up advancing the tail.
+  manager.TEST_AddLink(2, 3);
+  EXPECT_EQ(manager.GetSnapshotTs(), 2);
+}
+
+TEST(LinkBufSnapshotManagerTest, ConcurrentTest) {
+  LinkBufSnapshotManager manager(64);
+  Tso tso;
+  int worker_cnt = 16;
+  int commit_per_worker = 1000;
+  util::WaitGroup wg(worker_cnt);
+  for (int i = 0; i < worker_cnt; i++) {
+    util::LaunchAsync([&]() {
+      for (int j = 0; j < commit_per_worker; j++) {
+        auto ts = tso.RequestTs();
+        EXPECT_LT(manager.GetSnapshotTs(), ts);
+        if (j % 100 == 0) {
+          // let others race ahead.
+          bthread_usleep(100);
+        }
+        manager.CommitTs(ts);
+      }
+      wg.Done();
+    });
+  }
+  wg.Wait();
+  EXPECT_EQ(manager.GetSnapshotTs(), worker_cnt * commit_per_worker);
+  EXPECT_EQ(manager.TEST_GetOverflowCount(), 0);
+}
+
+} // namespace txn
+} // namespace arcanedb
@@ -0,0 +1,65 @@
+/**
+ * @file tso_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "txn/tso.h"
+#include "util/bthread_util.h"
+#include "util/wait_group.h"
+#include <gtest/gtest.h>
+#include <mutex>
+#include <set>
+
+namespace arcanedb {
+namespace txn {
+
+TEST(TsoTest, LeasedTsTest) {
+  Tso tso;
+  std::mutex mu;
+  std::set<TxnTs> ts_set;
+  size_t claimed = 0;
+  int worker_cnt = 16;
+  int ts_per_worker = 1000;
+  util::WaitGroup wg(worker_cnt);
+  for (int i = 0; i < worker_cnt; i++) {
+    util::LaunchAsync([&]() {
+      for (int j = 0; j < ts_per_worker; j++) {
+        auto ts = tso.RequestLeasedTs(0, [&](TxnTs begin, TxnTs end) {
+          std::lock_guard<std::mutex> guard(mu);
+          claimed += end - begin;
+        });
+        std::lock_guard<std::mutex> guard(mu);
+        // leased ts is unique.
+        EXPECT_TRUE(ts_set.insert(ts).second);
+      }
+      wg.Done();
+    });
+  }
+  wg.Wait();
+  EXPECT_EQ(ts_set.size(), worker_cnt * ts_per_worker);
+  // global ts is greater than all leased ts.
+  EXPECT_EQ(tso.RequestTs(), claimed + 1);
+  EXPECT_GT(tso.RequestTs(), *ts_set.rbegin());
+}
+
+TEST(TsoTest, LowerBoundTest) {
+  Tso tso;
+  TxnTs begin = 0;
+  auto on_claim = [&](TxnTs b, TxnTs e) { begin = b; };
+  EXPECT_EQ(tso.RequestLeasedTs(0, on_claim), 1);
+  EXPECT_EQ(tso.RequestLeasedTs(0, on_claim), 2);
+  auto ts = tso.RequestTs();
+  // rest of the lease is discarded.
+  auto leased_ts = tso.RequestLeasedTs(ts, on_claim);
+  EXPECT_GT(leased_ts, ts);
+  EXPECT_EQ(leased_ts, begin);
+}
+
+} // namespace txn
+} // namespace arcanedb
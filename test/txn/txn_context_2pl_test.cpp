@@ -205,6 +205,58 @@ TEST_F(TxnContext2PLTest, BasicTest) {
   }
 }
 
+TEST_F(TxnContext2PLTest, SharedReadTest) {
+  auto value = ValueStruct{.point_id = 0, .point_type = 0, .value = "0"};
+  {
+    auto context = txn_manager_->BeginRwTxn(opts_);
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return context->SetRow(table_key_, row, opts_);
+                }).ok());
+    context->CommitOrAbort(opts_);
+  }
+  // readers don't block each other.
+  auto reader1 = txn_manager_->BeginRwTxn(opts_);
+  auto reader2 = txn_manager_->BeginRwTxn(opts_);
+  TestRead(reader1.get(), table_key_, value, false);
+  TestRead(reader2.get(), table_key_, value, false);
+  reader1->CommitOrAbort(opts_);
+  reader2->CommitOrAbort(opts_);
+
+  // writer waits for reader.
+  auto reader = txn_manager_->BeginRwTxn(opts_);
+  TestRead(reader.get(), table_key_, value, false);
+  std::atomic<bool> written{false};
+  auto new_value = value;
+  new_value.value = "1";
+  Options update_opts = opts_;
+  update_opts.read_for_update = true;
+  auto future = util::LaunchAsync([&]() {
+    auto context = txn_manager_->BeginRwTxn(update_opts);
+    btree::RowView view;
+    auto sk = property::SortKeys({value.point_id, value.point_type});
+    EXPECT_TRUE(
+        context->GetRow(table_key_, sk.as_ref(), update_opts, &view).ok());
+    EXPECT_TRUE(WriteHelper(new_value, [&](const property::Row &row) {
+                  return context->SetRow(table_key_, row, update_opts);
+                }).ok());
+    written.store(true);
+    context->CommitOrAbort(update_opts);
+  });
+  bthread_usleep(10 * 1000);
+  EXPECT_FALSE(written.load());
+  reader->CommitOrAbort(opts_);
+  future->Wait();
+  EXPECT_TRUE(written.load());
+
+  // shared lock is upgraded when the only holder writes.
+  auto context = txn_manager_->BeginRwTxn(opts_);
+  TestRead(context.get(), table_key_, new_value, false);
+  EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                return context->SetRow(table_key_, row, opts_);
+              }).ok());
+  context->CommitOrAbort(opts_);
+}
+
 TEST_F(TxnContext2PLTest, ConcurrentTest) {
   std::vector<std::string> table_list;
   for (int i = 0; i < 10; i++) {
@@ -13,6 +13,7 @@
 #include "txn/occ_recovery.h"
 #include "txn/txn_context_occ.h"
 #include "txn/txn_manager_occ.h"
+#include "txn/version_sweeper.h"
 #include "util/bthread_util.h"
 #include <gtest/gtest.h>
 #include <memory>
@@ -237,6 +238,58 @@ TEST_P(TxnContextOCCTest, BasicTest) {
   }
 }
 
+TEST_P(TxnContextOCCTest, VersionSweeperTest) {
+  VersionSweeper sweeper(txn_manager_.get(), opts_);
+  sweeper.AddSubTable(table_key_);
+  auto write = [&](const ValueStruct &value) {
+    auto context = txn_manager_->BeginRwTxn(opts_);
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return context->SetRow(table_key_, row, opts_);
+                }).ok());
+    EXPECT_TRUE(context->CommitOrAbort(opts_).IsCommit());
+  };
+  auto old_value = ValueStruct{.point_id = 0, .point_type = 0, .value = "0"};
+  write(old_value);
+  // old version is pinned by active reader.
+  auto reader = txn_manager_->BeginRoTxn(opts_);
+  auto new_value = old_value;
+  for (int i = 1; i <= 10; i++) {
+    new_value.value = std::to_string(i);
+    write(new_value);
+  }
+  sweeper.SweepOnce();
+  ASSERT_TRUE(txn_manager_->GetGcWatermark().has_value());
+  EXPECT_LE(*txn_manager_->GetGcWatermark(), reader->GetReadTs());
+  TestRead(reader.get(), table_key_, old_value, false);
+  auto dump = DumpHelper(table_key_);
+  auto reader_ts = reader->GetReadTs();
+  reader.reset();
+
+  sweeper.SweepOnce();
+  EXPECT_GT(*txn_manager_->GetGcWatermark(), reader_ts);
+  EXPECT_LT(DumpHelper(table_key_).size(), dump.size());
+  reader = txn_manager_->BeginRoTxn(opts_);
+  TestRead(reader.get(), table_key_, new_value, false);
+}
+
+TEST_P(TxnContextOCCTest, GcWatermarkRefreshTest) {
+  EXPECT_FALSE(txn_manager_->GetGcWatermark().has_value());
+  // watermark is refreshed by committers without sweeper.
+  for (size_t i = 0; i < common::Config::kGcWatermarkRefreshInterval + 1;
+       i++) {
+    auto value =
+        ValueStruct{.point_id = 0, .point_type = 0, .value = std::to_string(i)};
+    auto context = txn_manager_->BeginRwTxn(opts_);
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return context->SetRow(table_key_, row, opts_);
+                }).ok());
+    EXPECT_TRUE(context->CommitOrAbort(opts_).IsCommit());
+  }
+  ASSERT_TRUE(txn_manager_->GetGcWatermark().has_value());
+  auto reader = txn_manager_->BeginRoTxn(opts_);
+  EXPECT_LE(*txn_manager_->GetGcWatermark(), reader->GetReadTs());
+}
+
 TEST_P(TxnContextOCCTest, AbortTest) {
   auto value = ValueStruct{.point_id = 0, .point_type = 0, .value = "hello"};
   {
@@ -273,6 +326,147 @@ TEST_P(TxnContextOCCTest, AbortTest) {
   { EXPECT_TRUE(txn1->CommitOrAbort(opts_).IsAbort()); }
 }
 
+TEST_P(TxnContextOCCTest, EarlyValidationTest) {
+  auto value = ValueStruct{.point_id = 0, .point_type = 0, .value = "hello"};
+  {
+    auto context = txn_manager_->BeginRwTxn(opts_);
+    EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                  return context->SetRow(table_key_, row, opts_);
+                }).ok());
+    EXPECT_TRUE(context->CommitOrAbort(opts_).IsCommit());
+  }
+  auto opts = opts_;
+  opts.occ_early_validation = true;
+  auto sk = property::SortKeys({value.point_id, value.point_type});
+  auto txn1 = txn_manager_->BeginRwTxn(opts);
+  {
+    btree::RowView view;
+    EXPECT_TRUE(txn1->GetRow(table_key_, sk.as_ref(), opts, &view).ok());
+    auto other_value =
+        ValueStruct{.point_id = 1, .point_type = 0, .value = "hello"};
+    EXPECT_TRUE(WriteHelper(other_value, [&](const property::Row &row) {
+                  return txn1->SetRow(table_key_, row, opts);
+                }).ok());
+  }
+  {
+    auto txn2 = txn_manager_->BeginRwTxn(opts);
+    auto new_value =
+        ValueStruct{.point_id = 0, .point_type = 0, .value = "world"};
+    EXPECT_TRUE(WriteHelper(new_value, [&](const property::Row &row) {
+                  return txn2->SetRow(table_key_, row, opts);
+                }).ok());
+    EXPECT_TRUE(txn2->CommitOrAbort(opts).IsCommit());
+  }
+  auto dump = DumpHelper(table_key_);
+  // txn1 is aborted before writing any intent.
+  EXPECT_TRUE(txn1->CommitOrAbort(opts).IsAbort());
+  EXPECT_EQ(DumpHelper(table_key_), dump);
+  // read is still repeatable for txn that passed validation.
+  auto txn3 = txn_manager_->BeginRwTxn(opts);
+  for (int i = 0; i < 2; i++) {
+    btree::RowView view;
+    EXPECT_TRUE(txn3->GetRow(table_key_, sk.as_ref(), opts, &view).ok());
+  }
+  EXPECT_TRUE(txn3->CommitOrAbort(opts).IsCommit());
+}
+
+TEST_P(TxnContextOCCTest, RangeScanTest) {
+  auto value_list = GenerateValueList(10);
+  {
+    auto context = txn_manager_->BeginRwTxn(opts_);
+    for (const auto &value : value_list) {
+      EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                    return context->SetRow(table_key_, row, opts_);
+                  }).ok());
+    }
+    EXPECT_TRUE(context->CommitOrAbort(opts_).IsCommit());
+  }
+  auto scan = [&](TxnContext *context, size_t expected_size) {
+    btree::RangeScanRowView view;
+    context->RangeFilter(table_key_, opts_, {}, {}, &view);
+    EXPECT_EQ(view.size(), expected_size);
+    return view;
+  };
+  auto new_value =
+      ValueStruct{.point_id = 10, .point_type = 0, .value = "10"};
+  {
+    // read your own writes
+    auto context = txn_manager_->BeginRwTxn(opts_);
+    scan(context.get(), value_list.size());
+    EXPECT_TRUE(WriteHelper(value_list[0], [&](const property::Row &row) {
+                  return context->DeleteRow(table_key_, row.GetSortKeys(),
+                                            opts_);
+                }).ok());
+    EXPECT_TRUE(WriteHelper(new_value, [&](const property::Row &row) {
+                  return context->SetRow(table_key_, row, opts_);
+                }).ok());
+    auto view = scan(context.get(), value_list.size());
+    for (int i = 0; i < view.size(); i++) {
+      auto sk = property::SortKeys(
+          {static_cast<int64_t>(i + 1), static_cast<int32_t>(0)});
+      EXPECT_EQ(view.at(i).GetSortKeys(), sk.as_ref());
+    }
+    EXPECT_TRUE(context->CommitOrAbort(opts_).IsCommit());
+  }
+  {
+    // phantom is detected.
+    auto txn1 = txn_manager_->BeginRwTxn(opts_);
+    scan(txn1.get(), value_list.size());
+    {
+      auto txn2 = txn_manager_->BeginRwTxn(opts_);
+      EXPECT_TRUE(WriteHelper(value_list[0], [&](const property::Row &row) {
+                    return txn2->SetRow(table_key_, row, opts_);
+                  }).ok());
+      EXPECT_TRUE(txn2->CommitOrAbort(opts_).IsCommit());
+    }
+    // snapshot is not affected.
+    scan(txn1.get(), value_list.size());
+    EXPECT_TRUE(WriteHelper(new_value, [&](const property::Row &row) {
+                  return txn1->SetRow(table_key_, row, opts_);
+                }).ok());
+    EXPECT_TRUE(txn1->CommitOrAbort(opts_).IsAbort());
+  }
+  {
+    // scan without conflict.
+    auto txn1 = txn_manager_->BeginRwTxn(opts_);
+    scan(txn1.get(), value_list.size() + 1);
+    EXPECT_TRUE(WriteHelper(new_value, [&](const property::Row &row) {
+                  return txn1->DeleteRow(table_key_, row.GetSortKeys(),
+                                         opts_);
+                }).ok());
+    EXPECT_TRUE(txn1->CommitOrAbort(opts_).IsCommit());
+    auto reader = txn_manager_->BeginRwTxn(opts_);
+    scan(reader.get(), value_list.size());
+  }
+}
+
+TEST_P(TxnContextOCCTest, ConcurrentScanTest) {
+  // scanners validate each other's intents, validation must abort
+  // instead of waiting for them.
+  int worker_count = 16;
+  int epoch_cnt = 100;
+  util::WaitGroup wg(worker_count);
+  for (int i = 0; i < worker_count; i++) {
+    util::LaunchAsync([&, index = i]() {
+      for (int k = 0; k < epoch_cnt; k++) {
+        auto context = txn_manager_->BeginRwTxn(opts_);
+        btree::RangeScanRowView view;
+        context->RangeFilter(table_key_, opts_, {}, {}, &view);
+        ValueStruct value{
+            .point_id = index, .point_type = 0, .value = std::to_string(k)};
+        EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                      return context->SetRow(table_key_, row, opts_);
+                    }).ok());
+        auto s = context->CommitOrAbort(opts_);
+        EXPECT_TRUE(s.IsCommit() || s.IsAbort());
+      }
+      wg.Done();
+    });
+  }
+  wg.Wait();
+  TestTsAsending(table_key_);
+}
+
 TEST_P(TxnContextOCCTest, AbortIntentTest) {
   auto values = GenerateValueList(10);
   {
@@ -353,15 +547,19 @@ TEST_P(TxnContextOCCTest, ConcurrentTest) {
               .point_id = 0, .point_type = 0, .value = std::to_string(k)};
           ValueStruct value2{
               .point_id = 1, .point_type = 0, .value = std::to_string(k)};
-          EXPECT_TRUE(WriteHelper(value1, [&](const property::Row &row) {
-                        return context->SetRow(table_list[table_index], row,
-                                               opts_);
-                      }).ok());
-          EXPECT_TRUE(WriteHelper(value2, [&](const property::Row &row) {
-                        return context->SetRow(table_list[table_index], row,
-                                               opts_);
-                      }).ok());
-          context->CommitOrAbort(opts_);
+          // younger txn dies when it conflicts with older lock holder.
+          auto s1 = WriteHelper(value1, [&](const property::Row &row) {
+            return context->SetRow(table_list[table_index], row, opts_);
+          });
+          EXPECT_TRUE(s1.ok() || s1.IsAbort()) << s1.ToString();
+          auto s2 = WriteHelper(value2, [&](const property::Row &row) {
+            return context->SetRow(table_list[table_index], row, opts_);
+          });
+          EXPECT_TRUE(s2.ok() || s2.IsAbort()) << s2.ToString();
+          auto s = context->CommitOrAbort(opts_);
+          if (!s1.ok() || !s2.ok()) {
+            EXPECT_TRUE(s.IsAbort());
+          }
         }
         wg.Done();
       });
@@ -391,8 +589,8 @@ TEST_P(TxnContextOCCTest, ConcurrentTest) {
   }
 }
 
-std::shared_ptr<log_store::LogStore> GenerateLogStore() {
-  auto log_store_name = "txn_context_occ_log_store";
+std::shared_ptr<log_store::LogStore> GenerateLogStore(
+    const std::string &log_store_name = "txn_context_occ_log_store") {
   std::shared_ptr<log_store::LogStore> store;
   log_store::Options options;
   auto s = log_store::PosixLogStore::Destory(log_store_name);
@@ -426,15 +624,19 @@ TEST_P(TxnContextOCCTest, ConcurrentTestWithLog) {
               .point_id = 0, .point_type = 0, .value = std::to_string(k)};
           ValueStruct value2{
               .point_id = 1, .point_type = 0, .value = std::to_string(k)};
-          EXPECT_TRUE(WriteHelper(value1, [&](const property::Row &row) {
-                        return context->SetRow(table_list[table_index], row,
-                                               opts);
-                      }).ok());
-          EXPECT_TRUE(WriteHelper(value2, [&](const property::Row &row) {
-                        return context->SetRow(table_list[table_index], row,
-                                               opts);
-                      }).ok());
-          context->CommitOrAbort(opts);
+          // younger txn dies when it conflicts with older lock holder.
+          auto s1 = WriteHelper(value1, [&](const property::Row &row) {
+            return context->SetRow(table_list[table_index], row, opts);
+          });
+          EXPECT_TRUE(s1.ok() || s1.IsAbort()) << s1.ToString();
+          auto s2 = WriteHelper(value2, [&](const property::Row &row) {
+            return context->SetRow(table_list[table_index], row, opts);
+          });
+          EXPECT_TRUE(s2.ok() || s2.IsAbort()) << s2.ToString();
+          auto s = context->CommitOrAbort(opts);
+          if (!s1.ok() || !s2.ok()) {
+            EXPECT_TRUE(s.IsAbort());
+          }
         }
         wg.Done();
       });
@@ -545,5 +747,52 @@ TEST_P(TxnContextOCCTest, BasicRecoveryTest) {
   }
 }
 
+TEST_P(TxnContextOCCTest, MultiPartitionRecoveryTest) {
+  auto value_list = GenerateValueList(10);
+  std::vector<std::shared_ptr<log_store::LogStore>> log_stores;
+  for (int i = 0; i < 2; i++) {
+    log_stores.push_back(
+        GenerateLogStore("txn_context_occ_log_partition" + std::to_string(i)));
+  }
+  // same rows are updated through different partitions.
+  int round = 4;
+  std::vector<TxnTs> ts_list;
+  for (int i = 0; i < round; i++) {
+    Options opts = opts_;
+    opts.log_store = log_stores[i % log_stores.size()].get();
+    opts.sync_commit = true;
+    auto context = txn_manager_->BeginRwTxn(opts);
+    for (auto value : value_list) {
+      value.value = std::to_string(i);
+      EXPECT_TRUE(WriteHelper(value, [&](const property::Row &row) {
+                    return context->SetRow(table_key_, row, opts);
+                  }).ok());
+    }
+    EXPECT_TRUE(context->CommitOrAbort(opts).IsCommit());
+    ts_list.push_back(context->GetWriteTs());
+  }
+  // recover
+  {
+    Restart();
+    std::vector<std::unique_ptr<log_store::LogReader>> log_readers;
+    std::vector<log_store::LogReader *> readers;
+    for (const auto &log_store : log_stores) {
+      log_readers.emplace_back();
+      EXPECT_TRUE(log_store->GetLogReader(&log_readers.back()).ok());
+      readers.push_back(log_readers.back().get());
+    }
+    OccRecovery recovery(bpm_.get(), readers);
+    recovery.Recover();
+  }
+  for (int i = 0; i < round; i++) {
+    auto context = txn_manager_->BeginRoTxnWithTs(opts_, ts_list[i]);
+    for (auto value : value_list) {
+      value.value = std::to_string(i);
+      TestRead(context.get(), table_key_, value, false);
+    }
+  }
+  TestTsAsending(table_key_);
+}
+
 } // namespace txn
-} // namespace arcanedb
\ No newline at end of file
+} // namespace arcanedb
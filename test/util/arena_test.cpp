@@ -0,0 +1,63 @@
+/**
+ * @file arena_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-19
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "util/arena.h"
+#include "absl/container/flat_hash_map.h"
+#include <gtest/gtest.h>
+
+namespace arcanedb {
+namespace util {
+
+TEST(ArenaTest, BasicTest) {
+  Arena arena(1024);
+  auto view = arena.CopyString("hello");
+  EXPECT_EQ(view, "hello");
+  auto ptr = arena.Allocate(sizeof(uint64_t), alignof(uint64_t));
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignof(uint64_t), 0);
+  EXPECT_EQ(arena.MemoryUsage(), 1024);
+  // small allocations are served from new block.
+  for (int i = 0; i < 100; i++) {
+    arena.Allocate(64);
+  }
+  EXPECT_GT(arena.MemoryUsage(), 1024);
+  // large allocation gets its own block.
+  auto large = static_cast<char *>(arena.Allocate(4096, 64));
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(large) % 64, 0);
+  memset(large, 0, 4096);
+  EXPECT_EQ(view, "hello");
+  arena.Reset();
+  EXPECT_EQ(arena.MemoryUsage(), 1024);
+}
+
+TEST(ArenaTest, AllocatorTest) {
+  Arena arena;
+  using Allocator = ArenaAllocator<std::pair<const int, std::string_view>>;
+  absl::flat_hash_map<int, std::string_view, absl::Hash<int>,
+                      std::equal_to<int>, Allocator>
+      map(0, absl::Hash<int>(), std::equal_to<int>(), Allocator(&arena));
+  for (int i = 0; i < 1000; i++) {
+    map[i] = arena.CopyString(std::to_string(i));
+  }
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_EQ(map[i], std::to_string(i));
+  }
+}
+
+TEST(ArenaTest, PooledArenaTest) {
+  auto arena = GetPooledArena();
+  arena->CopyString("arcane");
+  arena.reset();
+  arena = GetPooledArena();
+  EXPECT_EQ(arena->MemoryUsage(), common::Config::kArenaBlockSize);
+}
+
+} // namespace util
+} // namespace arcanedb
@@ -0,0 +1,40 @@
+/**
+ * @file bloom_filter_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-16
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "util/bloom_filter.h"
+#include "absl/hash/hash.h"
+#include <gtest/gtest.h>
+
+namespace arcanedb {
+namespace util {
+
+TEST(BloomFilterTest, BasicTest) {
+  BloomFilter empty_filter;
+  EXPECT_TRUE(empty_filter.MayContain(absl::Hash<int>()(0)));
+
+  int key_cnt = 1000;
+  BloomFilter filter(key_cnt);
+  for (int i = 0; i < key_cnt; i++) {
+    filter.Add(absl::Hash<int>()(i));
+  }
+  for (int i = 0; i < key_cnt; i++) {
+    EXPECT_TRUE(filter.MayContain(absl::Hash<int>()(i)));
+  }
+  int false_positive = 0;
+  for (int i = key_cnt; i < key_cnt * 11; i++) {
+    false_positive += filter.MayContain(absl::Hash<int>()(i));
+  }
+  // false positive rate of 10 bits per key is about 1%.
+  EXPECT_LT(false_positive, key_cnt * 10 / 50);
+}
+
+} // namespace util
+} // namespace arcanedb
@@ -0,0 +1,76 @@
+/**
+ * @file epoch_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-02-12
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "util/epoch.h"
+#include "util/bthread_util.h"
+#include "util/wait_group.h"
+#include <gtest/gtest.h>
+
+namespace arcanedb {
+namespace util {
+
+TEST(EpochTest, BasicTest) {
+  auto manager = EpochManager::GetInstance();
+  manager->TryReclaim();
+  EXPECT_EQ(manager->TEST_GetRetiredCount(), 0);
+  auto ptr = std::make_shared<int>(1);
+  std::weak_ptr<int> weak = ptr;
+  {
+    EpochGuard guard;
+    // nested guard
+    { EpochGuard inner_guard; }
+    manager->Retire(std::move(ptr));
+    // object is protected by current reader
+    EXPECT_EQ(manager->TryReclaim(), 0);
+    EXPECT_FALSE(weak.expired());
+  }
+  EXPECT_EQ(manager->TryReclaim(), 1);
+  EXPECT_TRUE(weak.expired());
+}
+
+TEST(EpochTest, ConcurrentTest) {
+  struct Node {
+    explicit Node(int v) noexcept : value(v) {}
+    ~Node() noexcept { value = -1; }
+    int value;
+  };
+  std::shared_ptr<Node> owner = std::make_shared<Node>(0);
+  std::atomic<Node *> head{owner.get()};
+  std::atomic<bool> stop{false};
+  int reader_cnt = 16;
+  WaitGroup wg(reader_cnt + 1);
+  for (int i = 0; i < reader_cnt; i++) {
+    LaunchAsync([&]() {
+      while (!stop.load()) {
+        EpochGuard guard;
+        auto node = head.load(std::memory_order_acquire);
+        EXPECT_GE(node->value, 0);
+      }
+      wg.Done();
+    });
+  }
+  LaunchAsync([&]() {
+    for (int i = 1; i <= 10000; i++) {
+      auto old_owner = std::move(owner);
+      owner = std::make_shared<Node>(i);
+      head.store(owner.get(), std::memory_order_release);
+      EpochManager::GetInstance()->Retire(std::move(old_owner));
+    }
+    stop.store(true);
+    wg.Done();
+  });
+  wg.Wait();
+  EpochManager::GetInstance()->TryReclaim();
+  EXPECT_EQ(EpochManager::GetInstance()->TEST_GetRetiredCount(), 0);
+}
+
+} // namespace util
+} // namespace arcanedb
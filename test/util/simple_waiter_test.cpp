@@ -0,0 +1,33 @@
+/**
+ * @file simple_waiter_test.cpp
+ * @author sheep (ysj1173886760@gmail.com)
+ * @brief
+ * @version 0.1
+ * @date 2023-03-28
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "util/simple_waiter.h"
+#include "util/time.h"
+#include <gtest/gtest.h>
+
+namespace arcanedb {
+namespace util {
+
+TEST(SimpleWaiterTest, LatchedNotifyTest) {
+  SimpleWaiter waiter;
+  // notification before waiting is not lost.
+  waiter.NotifyAll();
+  Timer timer;
+  waiter.Wait(10 * Second);
+  EXPECT_LT(timer.GetElapsed(), Second);
+  // latch is consumed by last wait.
+  timer.Reset();
+  waiter.Wait(10 * MillSec);
+  EXPECT_GE(timer.GetElapsed(), 5 * MillSec);
+}
+
+} // namespace util
+} // namespace arcanedb